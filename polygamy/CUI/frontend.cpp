@@ -2,6 +2,7 @@
 
 #include "shared.h"   // Precompiled header; obligatory
 #include "game.h"     // Base class for game definitions and minimax code
+#include "timing.h"   // For TimeManager
 
 // FIXME: the "static int force_initialization" trick isn't working any more,
 // so this hack is necessary to force all the games to be included:
@@ -23,13 +24,7 @@ static bool all_games_registered =
 #endif
 
 #ifndef DEFAULT_ANALYSIS_TIME
-    #define DEFAULT_ANALYSIS_TIME 5  // Default analysis time if unspecified by user
-#endif
-
-
-#if USE_GAMENODE_HEAP
-    HANDLE g_gamenode_heap = 0;
-    unsigned __int64 g_allocations = 0;
+    #define DEFAULT_ANALYSIS_TIME 5  // Default analysis time in seconds if unspecified by user
 #endif
 
 
@@ -44,8 +39,11 @@ static void show_state(GameState* pGameState)
 }
 
 
-static void play(GameState* pGameState, PlayerCode human_player, int search_depth, int maximum_analysis_time, int value_functions[2])
+static void play(GameState* pGameState, PlayerCode human_player, int search_depth, int maximum_analysis_ms, int game_ms, int value_functions[2], bool ponder)
 {
+    // Each player's time for the whole game, if limited
+    TimeManager clocks[2] = {TimeManager(game_ms), TimeManager(game_ms)};
+
     show_state(pGameState);
 
     int current_move = 0;
@@ -66,7 +64,9 @@ static void play(GameState* pGameState, PlayerCode human_player, int search_dept
         {
             printf("%s move? ", player_up_name);
             char input_string[20];
+            if (ponder) pGameState->start_pondering(search_depth);  // Think while the human does
             gets_s(input_string);
+            if (ponder) pGameState->stop_pondering();
             int command = toupper(input_string[0]);
 
             if (command == 'Q')
@@ -85,7 +85,7 @@ static void play(GameState* pGameState, PlayerCode human_player, int search_dept
             if (command == 'S')
             {
                 printf("Getting a computer suggestion for %s...\n", player_up_name);
-                Value value = pGameState->analyze(search_depth, maximum_analysis_time, &move);
+                Value value = pGameState->analyze(search_depth, maximum_analysis_ms, &move);
                 if (!move)
                 {
                     printf("No valid moves left.\n");
@@ -120,8 +120,8 @@ static void play(GameState* pGameState, PlayerCode human_player, int search_dept
             }
             if (command == 'M')  // Change maximum search time
             {
-                maximum_analysis_time = atoi(input_string + 1);
-                printf("Set maximum search time to %d seconds.\n", maximum_analysis_time);
+                maximum_analysis_ms = max(1, int(atof(input_string + 1) * 1000));
+                printf("Set maximum search time to %.3f seconds.\n", maximum_analysis_ms / 1000.0);
                 continue;
             }
             #if ZERO_WINDOW_SEARCHES
@@ -129,8 +129,8 @@ static void play(GameState* pGameState, PlayerCode human_player, int search_dept
                 {
                     int target_value = atoi(input_string + 1);
                     printf("Attempting a zero-window search for value %d...\n", target_value);
-                    Value value = pGameState->analyze(search_depth, maximum_analysis_time, &move, target_value, target_value);
-                    printf("analyze(depth %d, max time %d, window value %d) returned value %d\n", search_depth, maximum_analysis_time, target_value, value);
+                    Value value = pGameState->analyze(search_depth, maximum_analysis_ms, &move, target_value, target_value);
+                    printf("analyze(depth %d, max time %dms, window value %d) returned value %d\n", search_depth, maximum_analysis_ms, target_value, value);
                     continue;
                 }
             #endif
@@ -138,7 +138,12 @@ static void play(GameState* pGameState, PlayerCode human_player, int search_dept
                 if (command == 'W')  // Analyze position looking for the best win
                 {
                     printf("Searching for the most devastating win possible for %s...\n", player_up_name);
-                    Value value = pGameState->maximize_victory(&move);
+                    Value value = pGameState->maximize_victory(maximum_analysis_ms, &move);
+                    if (!move)
+                    {
+                        printf("No room left in the game tree to search.\n");
+                        continue;
+                    }
                     ASSERT(pGameState->valid_move(move));
                     pGameState->write_move(move, sizeof move_string, move_string);
                     printf("%s move: %s (estimated value %d)\n", player_up_name, move_string, value);
@@ -162,10 +167,27 @@ static void play(GameState* pGameState, PlayerCode human_player, int search_dept
         }
         else  // Computer move
         {
-            Value value = pGameState->analyze(search_depth, maximum_analysis_time, &move);
+            TimeManager& player_clock = clocks[pGameState->player_up()];
+            int analysis_ms = game_ms ? player_clock.move_budget(pGameState->expected_moves_left()) : maximum_analysis_ms;
+
+            DELAY_CHECKPOINT();
+            Value value = pGameState->analyze(search_depth, analysis_ms, &move);
+            player_clock.record_move(int(DELAY_MEASURED()));
+
+            // Save what the search has found every so often, in case the
+            // session is interrupted
+            if (pGameState->checkpoint_search().failed())
+            {
+                printf("Failed to save a checkpoint of the search results.\n");
+            }
 
             if (!move)
             {
+                if (!pGameState->game_over())
+                {
+                    printf("No room left in the game tree to search.\n");
+                    break;
+                }
                 printf("No valid moves left.\n");
                 BREAK_MSG("Should be impossible?\n");
                 break;
@@ -177,6 +199,10 @@ static void play(GameState* pGameState, PlayerCode human_player, int search_dept
                 pGameState->write_move(move, sizeof move_string, move_string);
                 //printf("%s move: %s (strategy %d; estimated value %d)\n", player_up_name, move_string, value_functions[current_value_function_index], value);  // FIXME: use or remove strategy stuff
                 printf("%s move: %s (estimated value %d)\n", player_up_name, move_string, value);
+                if (game_ms)
+                {
+                    printf("%s has %.3f seconds left.\n", player_up_name, player_clock.remaining_ms() / 1000.0);
+                }
             }
 
             VERIFY(pGameState->perform_move(move));
@@ -186,27 +212,66 @@ static void play(GameState* pGameState, PlayerCode human_player, int search_dept
         ++current_move;
     }
 
+    if (ponder && pGameState->ponder_predictions() > 0)
+    {
+        printf("Pondering: %d of %d predicted replies were played (%d%%)\n", pGameState->ponder_hits(),
+               pGameState->ponder_predictions(), 100 * pGameState->ponder_hits() / pGameState->ponder_predictions());
+    }
+
     #if MINIMAX_STATISTICS
         printf("TOTAL: %I64u nodes evaluated, %I64u beta cutoffs\n", g_total_evaluated_nodes, g_total_beta_cutoffs);
     #endif
 }
 
 
+// Times the same fixed-depth search of a game's starting position with the
+// game's functions called virtually and statically (see Engine/searcher.h)
+static void benchmark_dispatch(const GameDesc* pGame, int depth)
+{
+    GameState* pState = pGame->create_game();
+    printf("%s: depth %d:\n", pGame->m_name, depth);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        const bool static_dispatch = (pass == 1);
+        GameMove move = INVALID_MOVE;
+        UINT64 nodes = 0;
+
+        const UINT64 start_time = GetPerfCounter();
+        const Value value = static_dispatch ? pState->fixed_depth_search(depth, &move, &nodes)
+                                            : pState->GameState::fixed_depth_search(depth, &move, &nodes);
+        const double seconds = double(GetPerfCounter() - start_time) / (g_TicksPerMs * 1000);
+
+        char move_string[MAX_MOVE_STRING_SIZE] = "none";
+        if (move != INVALID_MOVE) pState->write_move(move, sizeof move_string, move_string);
+        printf("  %s dispatch: %I64u nodes in %.3f seconds (%.0f nodes/s); best move %s, value %d\n",
+               static_dispatch ? "Static" : "Virtual", nodes, seconds, seconds > 0 ? nodes / seconds : 0.0, move_string, value);
+    }
+
+    delete pState;
+}
+
+
 int main(int argc, char** argv)
 {
     ComponentTraceBegin();
     TRACE(INFO, "%s launched", *argv);
 
-    #if USE_GAMENODE_HEAP
-        #define INITIAL_NODE_HEAP_MEGABYTES 10
-        g_gamenode_heap = HeapCreate(HEAP_NO_SERIALIZE, INITIAL_NODE_HEAP_MEGABYTES * (1<<20), 0);
-        ASSERT(VALID_HANDLE(g_gamenode_heap));
-    #endif
-
     int maximum_depth = DEFAULT_MAXIMUM_DEPTH;
-    int maximum_analysis_time = DEFAULT_ANALYSIS_TIME;
+    int maximum_analysis_ms = DEFAULT_ANALYSIS_TIME * 1000;
+    int game_ms = 0;  // Time for each computer player's whole game (0 = unlimited)
     int value_functions[2] = {1, 2};  // Default strategies for 1st and 2nd computer players
     int rng_seed = -1;
+    int search_threads = SEARCH_THREADS;
+    GameState::ParallelSearch parallel_search = GameState::eLazySmp;
+    GameState::SearchDriver search_driver = GameState::eFullWindow;
+    bool ponder = false;
+    bool build_database = false;
+    const char* book_file_name = NULL;
+    int book_plies = 0;  // Plies to build the book to (0 = play from it)
+    const char* merged_book_file_name = NULL;
+    const char* checkpoint_file_name = NULL;
+    int benchmark_depth = 0;  // Depth of the dispatch benchmark's searches (0 = play instead)
 
     // If only one game is available, just select it and don't force the user to
     int chosen_game = (g_num_games == 1) ? 1 : 0;
@@ -265,8 +330,13 @@ int main(int argc, char** argv)
                     break;
 
                 case 'M':  // Maximum analysis time per move
-                    maximum_analysis_time = atoi(*argv + 1);
-                    if (maximum_analysis_time < 1) maximum_analysis_time = 1;
+                    maximum_analysis_ms = int(atof(*argv + 1) * 1000);
+                    if (maximum_analysis_ms < 1) maximum_analysis_ms = 1;
+                    break;
+
+                case 'L':  // Time limit for the whole game
+                    game_ms = int(atof(*argv + 1) * 1000);
+                    if (game_ms < 0) game_ms = 0;
                     break;
 
                 case 'V':  // Position evaluation functions
@@ -288,6 +358,65 @@ int main(int argc, char** argv)
                     rng_seed = atoi(*argv + 1);
                     break;
 
+                case 'T':  // Number of search threads
+                    search_threads = atoi(*argv + 1);
+                    if (search_threads < 1 || search_threads > MAX_SEARCH_THREADS)
+                    {
+                        printf("Ignoring invalid thread count %s (valid counts are 1 to %d).\n", *argv + 1, MAX_SEARCH_THREADS);
+                        search_threads = SEARCH_THREADS;
+                    }
+                    break;
+
+                case 'Y':  // Use Young Brothers Wait parallel search
+                    parallel_search = GameState::eSplitPoints;
+                    break;
+
+                case 'Z':  // Use MTD(f) zero-window searches
+                    search_driver = GameState::eMtdf;
+                    break;
+
+                case 'U':  // Use Monte Carlo Tree Search instead of minimax
+                    search_driver = GameState::eMonteCarlo;
+                    break;
+
+                case 'O':  // Think on the human's time
+                    ponder = true;
+                    break;
+
+                case 'E':  // Build the game's endgame database instead of playing
+                    build_database = true;
+                    break;
+
+                case 'B':  // Play from an opening book
+                    book_file_name = *argv + 1;
+                    break;
+
+                case 'W':  // Build or extend the opening book instead of playing
+                    book_plies = atoi(*argv + 1);
+                    if (book_plies <= 0)
+                    {
+                        printf("Ignoring invalid opening book depth %s.\n", *argv + 1);
+                        book_plies = 0;
+                    }
+                    break;
+
+                case 'J':  // Merge another opening book into the book instead of playing
+                    merged_book_file_name = *argv + 1;
+                    break;
+
+                case 'K':  // Resume search results from a checkpoint file, and keep it up to date
+                    checkpoint_file_name = *argv + 1;
+                    break;
+
+                case 'X':  // Benchmark virtual against static dispatch instead of playing
+                    benchmark_depth = atoi(*argv + 1);
+                    if (benchmark_depth <= 0)
+                    {
+                        printf("Ignoring invalid benchmark depth %s.\n", *argv + 1);
+                        benchmark_depth = 0;
+                    }
+                    break;
+
                 case 'C':  // Make computer play itself
                     human_player = -1;
                     break;
@@ -334,9 +463,21 @@ int main(int argc, char** argv)
                            "\t-g<N>\tPlay game N (see list below)\n"
                            "\t-h<N>\tHuman plays in Nth position\n"
                            "\t-d<N>\tSet maximum search depth to N\n"
-                           "\t-m<N>\tSet maximum time per computer move to N\n"
+                           "\t-m<N>\tSet maximum time per computer move to N seconds\n"
+                           "\t-l<N>\tGive each computer player N seconds for the whole game (overrides -m)\n"
                            "\t-v<P>=<N>\tUse position evaluator N for computer player P\n"
                            "\t-s<N>\tUse random number generator seed N\n"
+                           "\t-t<N>\tSearch using N threads\n"
+                           "\t-y\tShare work between threads at split points (default: Lazy SMP)\n"
+                           "\t-z\tSearch with MTD(f) zero-window passes (default: full window)\n"
+                           "\t-u\tSearch with Monte Carlo playouts (UCT) instead of minimax; ignores -d\n"
+                           "\t-o\tPonder (keep searching while the human thinks)\n"
+                           "\t-e\tBuild (or finish building) the game's endgame database with the -t thread count, then exit\n"
+                           "\t-bFILE\tPlay the moves in opening book FILE while it has the position\n"
+                           "\t-w<N>\tAdd the positions within N plies to the -b book, searching with -d and -m, then exit\n"
+                           "\t-jFILE\tAdd the entries of opening book FILE to the -b book, then exit\n"
+                           "\t-kFILE\tLoad search results saved in FILE, and save them there periodically and on exit\n"
+                           "\t-x<N>\tTime N-ply searches with virtual and static dispatch, for the -g game or all games, then exit\n"
                            "\t-c\tComputer plays itself\n"
                            "\t-p\tRun silently (for performance testing)\n"
                            "\t-fFILE\tLoad initial position from FILE\n");
@@ -345,6 +486,15 @@ int main(int argc, char** argv)
         }
     }
 
+    if (benchmark_depth > 0)
+    {
+        for (int i = 0; i < g_num_games; ++i)
+        {
+            if (!chosen_game || chosen_game == i+1) benchmark_dispatch(g_game_list[i], benchmark_depth);
+        }
+        return Result::OK;
+    }
+
     if (!chosen_game)
     {
         printf("Choose a game:\n");
@@ -372,6 +522,9 @@ int main(int argc, char** argv)
     const GameDesc* pGame = g_game_list[chosen_game-1];
 
     GameState* pState = pGame->create_game();
+    pState->set_search_threads(search_threads);
+    pState->set_parallel_search(parallel_search);
+    pState->set_search_driver(search_driver);
 
     if (pState->set_value_function(value_functions[0] - 1).failed())
     {
@@ -397,13 +550,60 @@ int main(int argc, char** argv)
         }
     }
 
+    if (build_database)
+    {
+        Result result = pState->build_endgame_database(search_threads);
+        if (result.failed())
+        {
+            printf("No endgame database was built for %s.\n", pGame->m_name);
+        }
+        delete pState;
+        return result;
+    }
+
+    if (book_plies > 0 || merged_book_file_name != NULL)
+    {
+        bool ok = book_file_name != NULL;
+        if (!ok)
+        {
+            printf("The -w and -j options need an opening book file (-b).\n");
+        }
+        if (ok && book_plies > 0)
+        {
+            ok = pState->build_opening_book(book_file_name, book_plies, maximum_depth, maximum_analysis_ms).ok();
+        }
+        if (ok && merged_book_file_name != NULL)
+        {
+            ok = pState->merge_opening_book(book_file_name, merged_book_file_name).ok();
+        }
+        delete pState;
+        return ok ? Result::OK : Result::Fail;
+    }
+
+    if (book_file_name != NULL && pState->set_opening_book(book_file_name).failed())
+    {
+        printf("Opening book \"%s\" is missing or invalid; ignoring it.\n", book_file_name);
+    }
+
+    if (checkpoint_file_name != NULL)
+    {
+        if (pState->resume_search(checkpoint_file_name).ok())
+        {
+            printf("Resumed search results from \"%s\".\n", checkpoint_file_name);
+        }
+        else
+        {
+            printf("No usable search results in \"%s\"; starting afresh.\n", checkpoint_file_name);
+        }
+    }
+
     if (g_profiling)
     {
-        printf("%s: depth %u: max time %d: ", pGame->m_name, maximum_depth, maximum_analysis_time);
+        printf("%s: depth %u: max time %dms: ", pGame->m_name, maximum_depth, maximum_analysis_ms);
 
         DELAY_CHECKPOINT();
 
-        play(pState, -1, maximum_depth, maximum_analysis_time, value_functions);
+        play(pState, -1, maximum_depth, maximum_analysis_ms, game_ms, value_functions, false);
 
         printf("Game took %.6f seconds.\n", DELAY_MEASURED() / 1000);
         char transcript[10000];
@@ -412,10 +612,10 @@ int main(int argc, char** argv)
     }
     else
     {
-        printf("%s: %s vs. %s: depth %d: max time %d: seed %d\n", pGame->m_name,
+        printf("%s: %s vs. %s: depth %d: max time %dms: seed %d\n", pGame->m_name,
                human_player == 0 ? "human" : "computer",
                human_player == 1 ? "human" : "computer",
-               maximum_depth, maximum_analysis_time, rng_seed);
+               maximum_depth, maximum_analysis_ms, rng_seed);
 
         if (human_player != -1)
         {
@@ -425,7 +625,7 @@ int main(int argc, char** argv)
         bool play_again = (human_player != -1);
         do
         {
-            play(pState, human_player, maximum_depth, maximum_analysis_time, value_functions);
+            play(pState, human_player, maximum_depth, maximum_analysis_ms, game_ms, value_functions, ponder);
 
             printf("Game over; %s was victorious.\n", pState->get_player_name(pState->player_ahead()));
 
@@ -441,7 +641,7 @@ int main(int argc, char** argv)
                 }
                 if (*action == 'P')
                 {
-                    pState->reset();
+                    pState->new_game();
                 }
                 else
                 {
@@ -453,12 +653,12 @@ int main(int argc, char** argv)
         while (play_again);
     }
 
-    delete pState;
+    if (pState->checkpoint_search(true).failed())
+    {
+        printf("Failed to save a checkpoint of the search results.\n");
+    }
 
-    #if USE_GAMENODE_HEAP
-        ASSERT(g_allocations == 0);
-        VERIFY_WIN32(HeapDestroy(g_gamenode_heap));
-    #endif
+    delete pState;
 
     TRACE(INFO, "Polygamy exiting");
     ComponentTraceEnd();
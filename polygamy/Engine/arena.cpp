@@ -0,0 +1,134 @@
+// arena.cpp
+
+#include "shared.h"  // Precompiled header; obligatory
+#include "arena.h"   // Our public interface
+#include <new>       // For std::nothrow
+
+
+__declspec(thread) NodeArena::Block* NodeArena::g_thread_block = NULL;
+__declspec(thread) LONG NodeArena::g_thread_arena_id = 0;
+
+// Source of arena identities; 0 is never used, so that a thread that has not
+// allocated from any arena yet doesn't match one
+static volatile LONG g_last_arena_id = 0;
+
+
+NodeArena::NodeArena()
+  : m_blocks(NULL), m_last_block(NULL), m_free_blocks(NULL), m_id(InterlockedIncrement(&g_last_arena_id)),
+    m_block_bytes(0), m_in_use_bytes(0), m_high_water_bytes(0), m_block_count(0), m_block_data(new BYTE*[NODE_ARENA_MAX_BLOCKS])
+{
+    C_ASSERT(NODE_ARENA_BLOCK_KB * 1024 <= (1 << NODE_ARENA_OFFSET_BITS) * NODE_ARENA_ALIGNMENT);
+    InitializeCriticalSection(&m_lock);
+}
+
+
+NodeArena::~NodeArena()
+{
+    reset();
+    while (m_free_blocks)
+    {
+        Block* block = m_free_blocks;
+        m_free_blocks = block->next;
+        delete[] reinterpret_cast<BYTE*>(block);
+    }
+    delete[] m_block_data;
+    DeleteCriticalSection(&m_lock);
+}
+
+
+//
+// Gives the calling thread a block to allocate from (a free one if possible)
+// and makes the allocation there.  The rest of the thread's previous block, if
+// it had one in this arena, goes unused until the next reset().  Returns NULL
+// if the arena already has NODE_ARENA_MAX_BLOCKS blocks and none is free, or
+// if the heap can't supply another block.
+//
+
+void* NodeArena::allocate_from_new_block(size_t bytes, __out_opt Index* index)
+{
+    EnterCriticalSection(&m_lock);
+
+    Block* block = m_free_blocks;
+    if (block && block->size >= bytes)
+    {
+        m_free_blocks = block->next;
+    }
+    else
+    {
+        // Indexes can't number any more blocks than this
+        if (m_block_count == NODE_ARENA_MAX_BLOCKS)
+        {
+            LeaveCriticalSection(&m_lock);
+            TRACE(WARNING, "Node arena full (%u blocks)", m_block_count);
+            return NULL;
+        }
+
+        // (Nor can they reach beyond the end of a standard block)
+        const size_t size = max(size_t(NODE_ARENA_BLOCK_KB) * 1024, bytes);
+        ASSERT(size <= NODE_ARENA_BLOCK_KB * 1024 || index == NULL);
+        block = reinterpret_cast<Block*>(new (std::nothrow) BYTE[sizeof(Block) + size]);
+        if (block == NULL)
+        {
+            // (Which, in a 32-bit process, comes long before the block limit)
+            LeaveCriticalSection(&m_lock);
+            TRACE(WARNING, "Out of memory for node arena block %u", m_block_count);
+            return NULL;
+        }
+        block->size = size;
+        block->number = m_block_count++;
+        m_block_data[block->number] = block->data();
+        m_block_bytes += size;
+    }
+
+    block->allocated = bytes;
+    block->next = m_blocks;
+    if (m_blocks == NULL) m_last_block = block;
+    m_blocks = block;
+    m_in_use_bytes += block->size;
+
+    LeaveCriticalSection(&m_lock);
+
+    if (index) *index = make_index(block, 0);
+    g_thread_block = block;
+    g_thread_arena_id = m_id;
+    return block->data();
+}
+
+
+//
+// Reclaims everything allocated since the last reset() at once: the blocks in
+// use join the free list as a whole, and the arena takes a new identity so
+// that threads don't go on allocating from them.
+//
+
+void NodeArena::reset()
+{
+    m_high_water_bytes = max(m_high_water_bytes, m_in_use_bytes);
+
+    if (m_blocks)
+    {
+        m_last_block->next = m_free_blocks;
+        m_free_blocks = m_blocks;
+        m_blocks = m_last_block = NULL;
+        m_in_use_bytes = 0;
+    }
+
+    m_id = InterlockedIncrement(&g_last_arena_id);
+}
+
+
+NodeArena::Statistics NodeArena::statistics() const
+{
+    Statistics statistics;
+    statistics.block_bytes = m_block_bytes;
+    statistics.in_use_bytes = m_in_use_bytes;
+    statistics.high_water_bytes = max(m_high_water_bytes, m_in_use_bytes);
+
+    statistics.allocated_bytes = 0;
+    for (const Block* block = m_blocks; block; block = block->next)
+    {
+        statistics.allocated_bytes += block->allocated;
+    }
+
+    return statistics;
+}
@@ -0,0 +1,134 @@
+// arena.h
+
+#ifndef ENGINE_ARENA_H
+#define ENGINE_ARENA_H
+
+
+// Allocations are rounded up to a multiple of this many bytes
+#define NODE_ARENA_ALIGNMENT 8
+
+// An Index holds an allocation's offset in its block, in units of
+// NODE_ARENA_ALIGNMENT, in this many bits, and the block's number above them
+#define NODE_ARENA_OFFSET_BITS 18
+#define NODE_ARENA_MAX_BLOCKS (1 << (32 - NODE_ARENA_OFFSET_BITS))
+
+
+//
+// NodeArena: a bump-pointer allocator for game tree nodes and their child
+// lists.  Memory is carved out of large blocks (NODE_ARENA_BLOCK_KB each) and
+// never freed piece by piece; reset() makes all of it available again at once,
+// in constant time, by putting the arena's blocks back on its free list.
+// Blocks only go back to the heap when the arena is deleted.
+//
+// An allocation can also be identified by a 32-bit Index, which pointer()
+// turns back into its address with one lookup in the arena's table of blocks.
+// Game tree nodes link to their children this way, which on 64-bit systems
+// takes half the space of a pointer.  Indexes stay valid until reset().
+//
+// Since an Index can only number NODE_ARENA_MAX_BLOCKS blocks (16 GB with the
+// default block size), an arena can't grow any bigger: once it has that many
+// blocks, and none is free, allocate() returns NULL.  It also does if the
+// heap runs out first, as it will in a 32-bit process.  GameState then stops
+// the search as if its time had run out (see GameState::abandon_search()).
+//
+// Several threads may allocate from one arena at a time, as split workers do
+// in the tree of the thread that recruited them.  Each thread allocates from
+// a block of its own, remembered in thread-local storage, without locking;
+// only taking a new block is serialized.  A thread's block is tagged with its
+// arena's identity, which changes at every reset(), so that no thread goes on
+// allocating from a block that has been reclaimed.  reset() and statistics()
+// must only be called while no other thread is using the arena.
+//
+// GameState keeps two arenas, and whenever a move is played or taken back it
+// copies the part of its tree still in use from one to the other and resets
+// the first (see GameState::compact_tree()).  Subtrees the game has discarded
+// are thereby reclaimed in bulk, and a new game releases the whole tree by
+// resetting its arena.
+//
+
+class NodeArena
+{
+public:
+
+    struct Statistics
+    {
+        UINT64 block_bytes;       // Memory held in blocks, in use or free
+        UINT64 in_use_bytes;      // Memory in the blocks taken since the last reset()
+        UINT64 allocated_bytes;   // Memory allocated from those blocks
+        UINT64 high_water_bytes;  // Most memory ever in use between resets
+    };
+
+    typedef UINT32 Index;
+
+    NodeArena();
+    ~NodeArena();
+
+    // Also sets 'index', if given, to the allocation's Index.  Returns NULL if
+    // the arena is full.
+    FORCEINLINE void* allocate(size_t bytes, __out_opt Index* index =NULL)
+    {
+        bytes = (bytes + NODE_ARENA_ALIGNMENT - 1) & ~size_t(NODE_ARENA_ALIGNMENT - 1);
+
+        Block* block = g_thread_block;
+        if (g_thread_arena_id == m_id && block->allocated + bytes <= block->size)
+        {
+            void* pointer = block->data() + block->allocated;
+            if (index) *index = make_index(block, block->allocated);
+            block->allocated += bytes;
+            return pointer;
+        }
+
+        return allocate_from_new_block(bytes, index);
+    }
+
+    FORCEINLINE void* pointer(Index index) const
+    {
+        return m_block_data[index >> NODE_ARENA_OFFSET_BITS] +
+               (index & ((1 << NODE_ARENA_OFFSET_BITS) - 1)) * NODE_ARENA_ALIGNMENT;
+    }
+
+    void reset();
+
+    Statistics statistics() const;
+
+private:
+
+    struct Block
+    {
+        UINT64 size;       // Bytes available after this header
+        UINT64 allocated;  // Bytes handed out so far
+        Block* next;
+        UINT32 number;     // Position in m_block_data, for life
+        BYTE* data() {return reinterpret_cast<BYTE*>(this + 1);}
+    };
+
+    Block* m_blocks;          // Taken since the last reset(), most recent first
+    Block* m_last_block;      // The end of that list (the first taken)
+    Block* m_free_blocks;
+    LONG m_id;                // Identifies the arena between resets
+    UINT64 m_block_bytes;
+    UINT64 m_in_use_bytes;
+    UINT64 m_high_water_bytes;
+    UINT32 m_block_count;     // Blocks ever created
+    BYTE** m_block_data;      // The data() of each block, by number (NODE_ARENA_MAX_BLOCKS entries)
+    CRITICAL_SECTION m_lock;  // Protects the fields above (except m_id, which only reset() changes,
+                              // and m_block_data entries, which never change once set)
+
+    void* allocate_from_new_block(size_t bytes, __out_opt Index* index);
+
+    FORCEINLINE static Index make_index(const Block* block, UINT64 offset)
+    {
+        return (block->number << NODE_ARENA_OFFSET_BITS) | Index(offset / NODE_ARENA_ALIGNMENT);
+    }
+
+    // The block the current thread allocates from, and the identity of its arena
+    static __declspec(thread) Block* g_thread_block;
+    static __declspec(thread) LONG g_thread_arena_id;
+
+    // Prevent copying
+    NodeArena(const NodeArena&);
+    NodeArena& operator=(const NodeArena&);
+};
+
+
+#endif // ENGINE_ARENA_H
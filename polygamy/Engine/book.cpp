@@ -0,0 +1,246 @@
+// book.cpp
+
+#include "shared.h"  // Precompiled header; obligatory
+#include "book.h"    // Our public interface
+
+
+#define OPENING_BOOK_SIGNATURE "POLYBOOK"  // 8 characters, without a terminator
+#define OPENING_BOOK_CHUNK_ENTRIES 0x1000000   // Entries per ReadFile() or WriteFile() call, which take 32-bit sizes
+
+
+static bool valid_header(const BookHeader& header, PositionHash root_hash)
+{
+    return memcmp(header.signature, OPENING_BOOK_SIGNATURE, sizeof header.signature) == 0 &&
+           header.version == OPENING_BOOK_VERSION &&
+           header.entry_size == sizeof(BookEntry) &&
+           header.root_hash == root_hash;
+}
+
+
+Result OpeningBook::open(const char* file_name, PositionHash root_hash)
+{
+    TRACE_VOID_METHOD();
+
+    close();
+
+    m_file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return Result::Fail;
+    }
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(m_file, &size) && UINT64(size.QuadPart) >= sizeof(BookHeader))
+    {
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping)
+        {
+            m_view = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+    }
+
+    if (m_view)
+    {
+        const BookHeader* header = static_cast<const BookHeader*>(m_view);
+        if (valid_header(*header, root_hash) &&
+            header->entry_count == (UINT64(size.QuadPart) - sizeof(BookHeader)) / sizeof(BookEntry))
+        {
+            m_entries = reinterpret_cast<const BookEntry*>(header + 1);
+            m_entry_count = header->entry_count;
+            return Result::OK;
+        }
+    }
+
+    TRACE(WARNING, "Ignoring unusable opening book %s", file_name);
+    close();
+    return Result::Fail;
+}
+
+
+void OpeningBook::close()
+{
+    if (m_view)
+    {
+        VERIFY_TRUE(UnmapViewOfFile(m_view));
+    }
+    if (m_mapping)
+    {
+        VERIFY_TRUE(CloseHandle(m_mapping));
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        VERIFY_TRUE(CloseHandle(m_file));
+    }
+
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+    m_view = NULL;
+    m_entries = NULL;
+    m_entry_count = 0;
+}
+
+
+// Binary search of entries in book order
+static const BookEntry* find_entries(const BookEntry* entries, UINT64 entry_count, PositionHash hash, __out UINT64* count)
+{
+    // Find the first entry for the position, if any
+    UINT64 low = 0, high = entry_count;
+    while (low < high)
+    {
+        const UINT64 middle = low + (high - low) / 2;
+        if (entries[middle].hash < hash) low = middle + 1;
+        else high = middle;
+    }
+
+    UINT64 end = low;
+    while (end < entry_count && entries[end].hash == hash) ++end;
+
+    *count = end - low;
+    return entries + low;
+}
+
+
+const BookEntry* OpeningBook::find(PositionHash hash, __out UINT64* count) const
+{
+    return find_entries(m_entries, m_entry_count, hash, count);
+}
+
+
+const BookEntry* BookEntryList::find(PositionHash hash, __out UINT64* count) const
+{
+    return find_entries(m_entries, m_count, hash, count);
+}
+
+
+Result BookEntryList::reserve(UINT64 capacity)
+{
+    if (capacity > m_capacity)
+    {
+        BookEntry* entries = new BookEntry[size_t(capacity)];
+        if (entries == NULL) return Result::Fail;
+        if (m_count) memcpy(entries, m_entries, size_t(m_count) * sizeof(BookEntry));
+        delete[] m_entries;
+        m_entries = entries;
+        m_capacity = capacity;
+    }
+    return Result::OK;
+}
+
+
+Result BookEntryList::add(const BookEntry& entry)
+{
+    if (m_count == m_capacity && reserve(max(m_capacity * 2, UINT64(1024))).failed())
+    {
+        return Result::Fail;
+    }
+
+    m_entries[m_count++] = entry;
+    return Result::OK;
+}
+
+
+Result BookEntryList::add(const BookEntryList& list)
+{
+    if (reserve(m_count + list.m_count).failed()) return Result::Fail;
+
+    if (list.m_count) memcpy(m_entries + m_count, list.m_entries, size_t(list.m_count) * sizeof(BookEntry));
+    m_count += list.m_count;
+    return Result::OK;
+}
+
+
+Result BookEntryList::read(const char* file_name, PositionHash root_hash)
+{
+    TRACE_VOID_METHOD();
+
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return GetLastError() == ERROR_FILE_NOT_FOUND ? Result::OK : Result::Fail;
+    }
+
+    BookHeader header;
+    DWORD done = 0;
+    bool ok = ReadFile(file, &header, sizeof header, &done, NULL) && done == sizeof header &&
+              valid_header(header, root_hash);
+
+    ok = ok && reserve(m_count + header.entry_count).ok();
+
+    for (UINT64 n = 0; ok && n < header.entry_count; n += OPENING_BOOK_CHUNK_ENTRIES)
+    {
+        const DWORD chunk = DWORD(min(header.entry_count - n, UINT64(OPENING_BOOK_CHUNK_ENTRIES)) * sizeof(BookEntry));
+        ok = ReadFile(file, m_entries + m_count, chunk, &done, NULL) && done == chunk;
+        if (ok) m_count += chunk / sizeof(BookEntry);
+    }
+
+    VERIFY_TRUE(CloseHandle(file));
+    return ok ? Result::OK : Result::Fail;
+}
+
+
+// Book order: by position, then by move, with the deepest search first
+static int __cdecl compare_entries(const void* p1, const void* p2)
+{
+    const BookEntry* e1 = static_cast<const BookEntry*>(p1);
+    const BookEntry* e2 = static_cast<const BookEntry*>(p2);
+
+    if (e1->hash != e2->hash) return e1->hash < e2->hash ? -1 : 1;
+    if (e1->move != e2->move) return e1->move < e2->move ? -1 : 1;
+    if (e1->depth != e2->depth) return e1->depth > e2->depth ? -1 : 1;
+    return 0;
+}
+
+
+void BookEntryList::combine()
+{
+    if (m_count == 0) return;
+
+    qsort(m_entries, size_t(m_count), sizeof(BookEntry), compare_entries);
+
+    UINT64 kept = 0;
+    for (UINT64 n = 1; n < m_count; ++n)
+    {
+        BookEntry& last = m_entries[kept];
+        if (m_entries[n].hash == last.hash && m_entries[n].move == last.move)
+        {
+            last.weight = UINT32(min(UINT64(last.weight) + m_entries[n].weight, UINT64(MAXUINT32)));
+        }
+        else
+        {
+            m_entries[++kept] = m_entries[n];
+        }
+    }
+    m_count = kept + 1;
+}
+
+
+Result BookEntryList::write(const char* file_name, PositionHash root_hash) const
+{
+    TRACE_VOID_METHOD();
+
+    HANDLE file = CreateFileA(file_name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return Result::Fail;
+    }
+
+    BookHeader header;
+    memcpy(header.signature, OPENING_BOOK_SIGNATURE, sizeof header.signature);
+    header.version = OPENING_BOOK_VERSION;
+    header.entry_size = sizeof(BookEntry);
+    header.root_hash = root_hash;
+    header.entry_count = m_count;
+
+    DWORD done = 0;
+    bool ok = WriteFile(file, &header, sizeof header, &done, NULL) && done == sizeof header;
+
+    for (UINT64 n = 0; ok && n < m_count; n += OPENING_BOOK_CHUNK_ENTRIES)
+    {
+        const DWORD chunk = DWORD(min(m_count - n, UINT64(OPENING_BOOK_CHUNK_ENTRIES)) * sizeof(BookEntry));
+        ok = WriteFile(file, m_entries + n, chunk, &done, NULL) && done == chunk;
+    }
+
+    ok = ok && FlushFileBuffers(file);
+    VERIFY_TRUE(CloseHandle(file));
+    return ok ? Result::OK : Result::Fail;
+}
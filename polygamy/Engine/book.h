@@ -0,0 +1,120 @@
+// book.h
+
+#ifndef ENGINE_BOOK_H
+#define ENGINE_BOOK_H
+
+#include "game.h"  // For Value, GameMove, PositionHash
+
+
+//
+// Opening books: moves for the first few plies of a game, with their values,
+// found ahead of time by deep searches (see GameState::build_opening_book()).
+//
+// A book file is a BookHeader followed by BookEntry records sorted by
+// position hash and then by move, so a position's moves are contiguous and
+// can be found by binary search.  OpeningBook maps the file into memory
+// read-only; looking a position up takes a few dozen comparisons and no
+// allocation.  BookEntryList holds a book in memory while it is built,
+// extended or merged, and writes the result.
+//
+// The header records the hash of the position the book starts from, so a
+// book can't be used with the wrong game (or board size, etc).  Positions
+// that are reflections or rotations of each other share their entries, which
+// are keyed by the canonical hash and record moves as they are played in the
+// canonical image (see GameState::canonical_hash()).
+//
+
+#define OPENING_BOOK_VERSION 2
+
+struct BookHeader
+{
+    char signature[8];         // OPENING_BOOK_SIGNATURE
+    UINT32 version;            // OPENING_BOOK_VERSION
+    UINT32 entry_size;         // sizeof(BookEntry), as a check on the layout
+    PositionHash root_hash;    // Identifies the starting position (see GameState::starting_position_key())
+    UINT64 entry_count;
+};
+
+struct BookEntry
+{
+    PositionHash hash;         // Position in which the move may be played (its canonical hash)
+    GameMove move;             // As played in the position's canonical image
+    Value value;               // Value after the move, from player 0's point of view
+    UINT32 weight;             // How strongly the move is recommended (greater is better)
+    UINT32 depth;              // Search depth that produced 'value'
+};
+
+
+class OpeningBook
+{
+public:
+
+    OpeningBook() : m_file(INVALID_HANDLE_VALUE), m_mapping(NULL), m_view(NULL), m_entries(NULL), m_entry_count(0) {}
+    ~OpeningBook() {close();}
+
+    // Fails if the file is missing or unusable, or was built from a different
+    // starting position
+    Result open(const char* file_name, PositionHash root_hash);
+    void close();
+
+    // Returns the first of a position's entries and sets 'count' to how many
+    // there are (0 if the book doesn't have the position)
+    const BookEntry* find(PositionHash hash, __out UINT64* count) const;
+
+    UINT64 entry_count() const {return m_entry_count;}
+
+private:
+
+    HANDLE m_file;
+    HANDLE m_mapping;
+    const void* m_view;
+    const BookEntry* m_entries;  // Just past the header
+    UINT64 m_entry_count;
+
+    // Prevent copying
+    OpeningBook(const OpeningBook&);
+    OpeningBook& operator=(const OpeningBook&);
+};
+
+
+class BookEntryList
+{
+public:
+
+    BookEntryList() : m_entries(NULL), m_count(0), m_capacity(0) {}
+    ~BookEntryList() {delete[] m_entries;}
+
+    Result add(const BookEntry& entry);
+    Result add(const BookEntryList& list);
+
+    // Appends the entries of a book file.  A missing file counts as an empty
+    // book; one built from a different starting position is an error.
+    Result read(const char* file_name, PositionHash root_hash);
+
+    // Sorts the entries into book order and combines those for the same move
+    // in the same position: the deepest search's value is kept and the
+    // weights are added together
+    void combine();
+
+    // Writes a book file, or looks a position up as OpeningBook::find() does;
+    // the entries must have been combined
+    Result write(const char* file_name, PositionHash root_hash) const;
+    const BookEntry* find(PositionHash hash, __out UINT64* count) const;
+
+    UINT64 count() const {return m_count;}
+
+private:
+
+    BookEntry* m_entries;
+    UINT64 m_count;
+    UINT64 m_capacity;
+
+    Result reserve(UINT64 capacity);
+
+    // Prevent copying
+    BookEntryList(const BookEntryList&);
+    BookEntryList& operator=(const BookEntryList&);
+};
+
+
+#endif // ENGINE_BOOK_H
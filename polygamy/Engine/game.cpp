@@ -1,7 +1,16 @@
 // game.cpp
 
-#include "shared.h"  // Precompiled header; obligatory
-#include "game.h"    // Our public interface
+#include "shared.h"         // Precompiled header; obligatory
+#include "game.h"           // Our public interface
+#include "transposition.h"  // For TranspositionTable
+#include "ordering.h"       // For MoveOrdering
+#include "smp.h"            // For SearchHelper
+#include "thinker.h"        // For Thinker
+#include "mcts.h"           // For MonteCarloSearch
+#include "book.h"           // For OpeningBook, BookEntryList
+#include "searcher.h"       // For Searcher
+#include "arena.h"          // For NodeArena
+#include <new>              // For placement new and std::bad_alloc
 
 
 // Whether the global profiling mode is enabled
@@ -30,8 +39,46 @@ int g_current_search_depth = 0;
     unsigned __int64 g_moves_applied = 0;
     unsigned __int64 g_evaluated_nodes = 0;
     unsigned __int64 g_beta_cutoffs = 0;
+    unsigned __int64 g_pvs_researches = 0;
+    unsigned __int64 g_mtdf_passes = 0;
+    unsigned __int64 g_aspiration_fails_low = 0;
+    unsigned __int64 g_aspiration_fails_high = 0;
+    unsigned __int64 g_killer_cutoffs = 0;
+    unsigned __int64 g_quiescence_nodes = 0;
+    unsigned __int64 g_quiescence_moves = 0;
+    unsigned __int64 g_quiescence_cutoffs = 0;
+    unsigned __int64 g_quiescence_depth_limits = 0;
+    unsigned __int64 g_null_move_cutoffs = 0;
+    unsigned __int64 g_futility_prunes = 0;
+    unsigned __int64 g_razoring_prunes = 0;
+    unsigned __int64 g_late_move_reductions = 0;
+    unsigned __int64 g_late_move_researches = 0;
+    unsigned __int64 g_endgame_solves = 0;
+    unsigned __int64 g_endgame_nodes = 0;
+    unsigned __int64 g_move_lists = 0;
+    unsigned __int64 g_move_list_allocations = 0;
+    unsigned __int64 g_tree_bytes_kept = 0;
+    unsigned __int64 g_tree_bytes_discarded = 0;
     unsigned __int64 g_total_evaluated_nodes = 0;
     unsigned __int64 g_total_beta_cutoffs = 0;
+
+    // Heap allocations made by each thread, counted by replacing the global
+    // operator new, so that the search can check which of its paths allocate
+    // (g_move_list_allocations, counted over evaluate_moves(), should stay at 0)
+    static __declspec(thread) unsigned __int64 g_thread_heap_allocations = 0;
+
+    void* __cdecl operator new(size_t bytes)
+    {
+        ++g_thread_heap_allocations;
+        void* pointer = malloc(bytes ? bytes : 1);
+        if (pointer == NULL) throw std::bad_alloc();
+        return pointer;
+    }
+
+    void __cdecl operator delete(void* pointer)
+    {
+        free(pointer);
+    }
 #endif
 
 
@@ -58,6 +105,96 @@ int register_game(const char* name, GameCreator* game_creator)
 };
 
 
+//
+// Zobrist key generation.  Uses the SplitMix64 generator rather than rand()
+// so that hashes don't depend on the RNG seed and are the same in every run.
+//
+
+int generate_zobrist_keys(__out_bcount(bytes) void* keys, size_t bytes, PositionHash seed)
+{
+    PositionHash* key = static_cast<PositionHash*>(keys);
+    int key_count = int(bytes / sizeof(PositionHash));
+
+    for (int n = 0; n < key_count; ++n)
+    {
+        PositionHash z = (seed += 0x9E3779B97F4A7C15ui64);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ui64;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBui64;
+        key[n] = z ^ (z >> 31);
+    }
+
+    return key_count;
+}
+
+
+void transform_cell(int symmetry, bool inverse, int width, int height, __inout int* x, __inout int* y)
+{
+    ASSERT(symmetry >= 0 && symmetry < BOARD_SYMMETRIES);
+    ASSERT(!(symmetry & 4) || width == height);
+
+    // The reflections undo themselves and commute with one another, so only
+    // the swap needs to move to the other end to undo a symmetry
+    int swapped;
+    if ((symmetry & 4) && !inverse) {swapped = *x; *x = *y; *y = swapped;}
+    if (symmetry & 1) *x = width - 1 - *x;
+    if (symmetry & 2) *y = height - 1 - *y;
+    if ((symmetry & 4) && inverse) {swapped = *x; *x = *y; *y = swapped;}
+}
+
+
+PositionHash least_symmetric_hash(__in const PositionHash* hashes, unsigned symmetries,
+                                  PositionHash player_key, __out int* symmetry)
+{
+    ASSERT(symmetries & 1);
+
+    PositionHash least = hashes[0] ^ player_key;
+    *symmetry = 0;
+
+    for (int n = 1; n < BOARD_SYMMETRIES; ++n)
+    {
+        if ((symmetries & (1 << n)) && (hashes[n] ^ player_key) < least)
+        {
+            least = hashes[n] ^ player_key;
+            *symmetry = n;
+        }
+    }
+
+    return least;
+}
+
+
+//
+// Copy constructor, used by derived classes' clone() methods.  The copy gets
+// the same position and player to move, but a fresh game tree of its own
+// (which clone_for_search() starts, in the original's node arena).
+//
+
+GameState::GameState(const GameState& original)
+  : m_player_up(original.m_player_up), m_move_counter(original.m_move_counter),
+    m_initial_node(NULL), m_current_node(NULL), m_node_arena(NULL), m_spare_node_arena(NULL), m_output_buffer(NULL), m_output_buffer_protector(NULL), m_transposition_table(NULL), m_move_ordering(NULL),
+    m_search_threads(1), m_parallel_search(original.m_parallel_search), m_search_driver(original.m_search_driver),
+    m_stop_flag(NULL), m_out_of_time(0), m_deadline(0), m_deadline_countdown(0),
+    m_split_workers(NULL), m_split_point(NULL), m_null_move_node(NULL),
+    m_thinker(NULL), m_predicted_move(INVALID_MOVE), m_ponder_predictions(0), m_ponder_hits(0), m_monte_carlo(NULL),
+    m_opening_book(NULL), m_building_book(false), m_checkpoint_key(0), m_last_checkpoint(0)
+{
+    *m_checkpoint_file = 0;  // Clones don't save checkpoints
+}
+
+
+GameState::~GameState()
+{
+    ASSERT(m_thinker == NULL);  // The thread would be using the derived class
+    delete m_split_workers;
+    delete m_transposition_table;
+    delete m_move_ordering;
+    delete m_monte_carlo;
+    delete m_opening_book;
+    delete m_node_arena;  // Frees the game tree
+    delete m_spare_node_arena;
+}
+
+
 //
 // Reset the base object's state.  Note that most derived game classes must
 // implement their own reset() method, and when they do, it must be sure to
@@ -71,12 +208,76 @@ void GameState::reset()
     m_move_counter = 0;
     m_player_up = 0;
 
-    if (m_initial_node)
+    // Release the whole game tree at once
+    if (m_node_arena)
+    {
+        m_node_arena->reset();
+    }
+    else
+    {
+        m_node_arena = new NodeArena;
+        m_spare_node_arena = new NodeArena;
+    }
+
+    m_current_node = m_initial_node = new_node(0);
+    m_predicted_move = INVALID_MOVE;
+
+    if (m_move_ordering)
+    {
+        m_move_ordering->clear();
+    }
+}
+
+
+//
+// Start another game.  The transposition table is kept if the game starts
+// where the checkpointed one did, so the first save doesn't replace the
+// checkpoint with a nearly empty table; otherwise positions may mean
+// something different in the new game (e.g. Ataxx boards with different
+// blocked cells hash identically), so it is cleared, and as its results no
+// longer belong in the checkpoint, checkpointing stops.
+//
+
+void GameState::new_game()
+{
+    TRACE_VOID_METHOD();
+
+    reset();  // The derived class's, which sets up the starting position
+
+    if (m_checkpoint_key != 0 && starting_position_key() == m_checkpoint_key)
+    {
+        return;
+    }
+
+    if (*m_checkpoint_file)
+    {
+        TRACE(WARNING, "New game doesn't start from the position checkpointed in %s; no longer saving to it", m_checkpoint_file);
+        *m_checkpoint_file = 0;
+    }
+    if (m_transposition_table)
     {
-        prune_tree(m_initial_node);
+        m_transposition_table->clear();
     }
+}
+
+
+//
+// Move a child and its move from position 'from' in a child list to position
+// 'to' (no later in the list), shifting the children in between along by one
+//
+
+FORCEINLINE void GameState::move_child(ChildList list, int from, int to)
+{
+    ASSERT(to <= from);
+
+    const GameNode moving_node = list.nodes[from];
+    const GameMove moving_move = list.moves[from];
 
-    m_current_node = m_initial_node = new GameNode(0);
+    memmove(list.nodes + to + 1, list.nodes + to, (from - to) * sizeof(GameNode));
+    memmove(list.moves + to + 1, list.moves + to, (from - to) * sizeof(GameMove));
+
+    list.nodes[to] = moving_node;
+    list.moves[to] = moving_move;
 }
 
 
@@ -84,30 +285,246 @@ void GameState::reset()
 // Find the appropriate position for a move in an ordered child list
 //
 
-FORCEINLINE void GameState::adjust_node_position(GameNode::Child* list, int list_length)
+FORCEINLINE void GameState::adjust_node_position(ChildList list, int list_length)
 {
-    Value value = list[list_length].resulting_node->value;
+    // Compare values from the point of view of the player to move
+    const Value sign = side_sign();
+    Value value = sign * list.nodes[list_length].value;
 
     int insert_pos = 0;
-    while (insert_pos < list_length && worse_or_equal(value, list[insert_pos].resulting_node->value))
+    while (insert_pos < list_length && value <= sign * list.nodes[insert_pos].value)
     {
         ++insert_pos;
     }
 
     if (insert_pos != list_length)
     {
-        GameNode::Child moving_child = list[list_length];
+        move_child(list, list_length, insert_pos);
+    }
+}
+
+
+//
+// Refine the order of a newly generated child list, which is sorted by
+// immediate value, using the moves that caused beta cutoffs elsewhere in the
+// search: moves of equal value are sorted by their history scores, and then
+// this ply's killer moves, if legal here, are moved to the head of the list.
+// Like promote_move(), this disturbs the ordering by value.
+//
+
+FORCEINLINE void GameState::order_new_children(ChildList list, int count)
+{
+    #if USE_KILLERS_AND_HISTORY
+        if (m_move_ordering == NULL || count < 2) return;
+
+        if (move_index_count() > 0)
+        {
+            // Stable insertion sort by history within each run of equal values
+            int scores[MAX_POSSIBLE_MOVES];
+            for (int n = 0; n < count; ++n)
+            {
+                scores[n] = m_move_ordering->history(m_player_up, move_index(list.moves[n]));
+            }
+
+            for (int n = 1; n < count; ++n)
+            {
+                const int score = scores[n];
+                int insert_pos = n;
+                while (insert_pos > 0 && scores[insert_pos - 1] < score &&
+                       list.nodes[insert_pos - 1].value == list.nodes[n].value)
+                {
+                    --insert_pos;
+                }
+                if (insert_pos != n)
+                {
+                    move_child(list, n, insert_pos);
+                    memmove(scores + insert_pos + 1, scores + insert_pos, (n - insert_pos) * sizeof(int));
+                    scores[insert_pos] = score;
+                }
+            }
+        }
+
+        // Oldest killer first, so that the most recent one ends up at the head
+        const GameMove* killers = m_move_ordering->killers(m_move_counter);
+        for (int k = KILLER_SLOTS - 1; k >= 0; --k)
+        {
+            if (killers[k] == INVALID_MOVE) continue;
+
+            for (int n = 0; n < count; ++n)
+            {
+                if (equivalent_moves(list.moves[n], killers[k]))
+                {
+                    move_child(list, n, 0);
+                    break;
+                }
+            }
+        }
+    #else
+        UNREFERENCED_PARAMETER(list);
+        UNREFERENCED_PARAMETER(count);
+    #endif
+}
+
+
+//
+// Remember a move that caused a beta cutoff in the current position, with
+// 'depth' plies of search remaining, for order_new_children()
+//
+
+FORCEINLINE void GameState::record_cutoff(GameMove move, int depth)
+{
+    #if USE_KILLERS_AND_HISTORY
+        if (m_move_ordering && move != PASSING_MOVE)
+        {
+            #if MINIMAX_STATISTICS
+                if (m_move_ordering->is_killer(m_move_counter, move)) ++g_killer_cutoffs;
+            #endif
+            m_move_ordering->record_cutoff(m_move_counter, m_player_up, move, move_index(move), depth);
+        }
+    #else
+        UNREFERENCED_PARAMETER(move);
+        UNREFERENCED_PARAMETER(depth);
+    #endif
+}
+
+
+//
+// Late move reductions: returns how many plies less deeply to search the nth
+// move in a list, with 'depth' plies to go.  Lists are sorted best first, so
+// moves far down them are rarely best.  Killer moves are never reduced, and a
+// reduced search always keeps at least one ply.
+//
+
+FORCEINLINE int GameState::late_move_reduction(int depth, int n, GameMove move) const
+{
+    #if USE_LATE_MOVE_REDUCTIONS
+        if (depth < LMR_MIN_DEPTH) return 0;
+
+        const BYTE* reductions = late_move_reductions();
+        if (reductions == NULL) return 0;
+
+        int reduction = reductions[min(n, LMR_TABLE_SIZE - 1)];
+        if (reduction == 0) return 0;
+
+        #if USE_KILLERS_AND_HISTORY
+            if (m_move_ordering && m_move_ordering->is_killer(m_move_counter, move)) return 0;
+        #else
+            UNREFERENCED_PARAMETER(move);
+        #endif
+
+        return min(reduction, depth - 2);
+    #else
+        UNREFERENCED_PARAMETER(depth);
+        UNREFERENCED_PARAMETER(n);
+        UNREFERENCED_PARAMETER(move);
+        return 0;
+    #endif
+}
+
+
+//
+// Game tree memory management.  Nodes are carved out of the node arena and
+// never freed one by one: subtrees the game no longer needs are just cut off
+// the tree, and compact_tree() reclaims them all at once.
+//
+
+FORCEINLINE GameState::GameNode* GameState::new_node(Value value)
+{
+    void* memory = m_node_arena->allocate(sizeof(GameNode));
+    return memory ? new (memory) GameNode(value) : NULL;
+}
+
+
+// Allocates the block for a child list of the given length (uninitialized),
+// returning its nodes and setting 'index' to its arena index.  Like
+// new_node(), returns NULL if the arena is full.
+FORCEINLINE GameState::GameNode* GameState::new_children(int count, __out UINT32* index)
+{
+    C_ASSERT(sizeof(GameNode) == 12);
+    C_ASSERT(MAX_POSSIBLE_MOVES < (1 << 13));  // (The range of GameNode::child_count)
+
+    return static_cast<GameNode*>(m_node_arena->allocate(count * (sizeof(GameNode) + sizeof(GameMove)), index));
+}
+
+
+FORCEINLINE GameState::ChildList GameState::children_of(const GameNode* node) const
+{
+    ASSERT(node->child_count > 0);
+
+    ChildList list;
+    list.nodes = static_cast<GameNode*>(m_node_arena->pointer(node->children));
+    list.moves = reinterpret_cast<GameMove*>(list.nodes + node->child_count);
+    return list;
+}
+
+
+// Copies the subtree below a node from another arena into the node arena.
+// 'node' is already the copy, but its child list index still refers to the
+// other arena; 'current_node' is updated if it is among the nodes copied.
+//
+// Should the arena fill up, the rest of the subtree is cut off, leaving the
+// node unexplored.  The copy never takes much more room than the original,
+// and the moves played (each one the first child of its parent) are copied
+// before anything else, so only search results can be lost this way.
+void GameState::copy_children(const NodeArena& from, __inout GameNode* node, __inout GameNode** current_node)
+{
+    const int count = node->child_count;
+    const GameNode* source = static_cast<const GameNode*>(from.pointer(node->children));
+    GameNode* children = new_children(count, &node->children);
+    if (children == NULL)
+    {
+        node->child_count = -1;
+        node->explored_depth = -1;
+        return;
+    }
 
-        // Shift remaining nodes in the list to the right to make room for the new one
-        memmove(list + insert_pos + 1, list + insert_pos, (list_length - insert_pos) * sizeof GameNode::Child);
+    // (Copies the moves along with the nodes)
+    memcpy(children, source, count * (sizeof(GameNode) + sizeof(GameMove)));
 
-        list[insert_pos] = moving_child;
+    for (int n = 0; n < count; ++n)
+    {
+        if (source + n == *current_node) *current_node = children + n;
+        if (children[n].child_count > 0) copy_children(from, children + n, current_node);
     }
 }
 
 
 //
-// Generate a list of legal moves sorted by immediate value
+// Copies what is left of the game tree (the moves played so far, with the
+// alternatives to each, and everything searched from the current position
+// on) into the spare arena, then resets the old one.  Everything else that
+// was allocated since the last compaction is thereby reclaimed in one step:
+// the subtrees cut off by perform_move() and revert_move(), null-move
+// searches, and the trees of clones.  No other thread may be searching.
+//
+
+void GameState::compact_tree()
+{
+    NodeArena* old_arena = m_node_arena;
+    m_node_arena = m_spare_node_arena;
+    m_spare_node_arena = old_arena;
+
+    GameNode* initial_node = new_node(0);
+    VERIFY_PTR(initial_node);  // (The arena is empty)
+    *initial_node = *m_initial_node;
+    if (m_current_node == m_initial_node) m_current_node = initial_node;
+    if (initial_node->child_count > 0) copy_children(*old_arena, initial_node, &m_current_node);
+    m_initial_node = initial_node;
+
+    #if MINIMAX_STATISTICS
+        const UINT64 kept = m_node_arena->statistics().allocated_bytes;
+        g_tree_bytes_kept += kept;
+        g_tree_bytes_discarded += old_arena->statistics().allocated_bytes - kept;
+    #endif
+
+    old_arena->reset();
+}
+
+
+//
+// Generate a list of legal moves sorted by immediate value.  If the node arena
+// is full, the node is left unexpanded (child_count stays -1) and the search
+// is abandoned.
 //
 // FIXME: might just want to make get_possible_moves() only return actually valid moves
 // FIXME: if we do that, we may be able to eliminate apply_passing_move() altogether
@@ -117,394 +534,1959 @@ FORCEINLINE void GameState::generate_move_list(GameNode* node)
 {
     if (node->child_count == -1)
     {
-        ASSERT(node->continuations == NULL);
-        ASSERT(node->explored_depth == -1);
-        node->child_count = 0;
+        // Note: explored_depth may already be set if this node's value came
+        // from the transposition table without it being expanded.
         node->explored_depth = 0;
+        node->bound = eExact;
 
-        GameNode::Child child_list[1000];  // FIXME: magic number (max no. of moves available ever in any game)
+        // The list is built here, and copied to the node arena once its length
+        // is known (since some of the moves listed may be rejected)
+        UINT32 node_buffer[MAX_POSSIBLE_MOVES * sizeof(GameNode) / sizeof(UINT32)];
+        GameMove moves[MAX_POSSIBLE_MOVES];
+        Value values[MAX_POSSIBLE_MOVES];
+        ChildList children = {reinterpret_cast<GameNode*>(node_buffer), moves};
 
-        GameMove* possible_moves = get_possible_moves();
-
-        for (GameMove* move = possible_moves; *move; ++move)
-        {
-            if (apply_move(*move).failed()) continue;
-            child_list[node->child_count].move = *move;
-            child_list[node->child_count].resulting_node = new GameNode(position_val());
-            undo_last_move();
-            adjust_node_position(child_list, node->child_count);
-            ++node->child_count;
-            ASSERT(node->child_count < countof(child_list));
-            #if MINIMAX_STATISTICS
-                ++g_moves_applied;
-                ++g_evaluated_nodes;
-            #endif
-        }
+        #if MINIMAX_STATISTICS
+            const unsigned __int64 allocations = g_thread_heap_allocations;
+            const int child_count = evaluate_moves(moves, values);
+            g_move_list_allocations += g_thread_heap_allocations - allocations;
+            ++g_move_lists;
+            g_moves_applied += child_count;
+            g_evaluated_nodes += child_count;
+        #else
+            const int child_count = evaluate_moves(moves, values);
+        #endif
 
-        if (node->child_count == 0 && apply_passing_move().ok())
+        for (int n = 0; n < child_count; ++n)
         {
-            node->child_count = 1;
-            child_list[0].move = PASSING_MOVE;
-            child_list[0].resulting_node = new GameNode(position_val());
-            undo_last_move();
-            #if MINIMAX_STATISTICS
-                ++g_moves_applied;
-                ++g_evaluated_nodes;
-            #endif
+            new (&children.nodes[n]) GameNode(values[n]);
+            adjust_node_position(children, n);
         }
 
-        if (node->child_count == 0)
+        if (child_count == 0)
         {
+            node->child_count = 0;
             node->value = game_over_val();
             node->explored_depth = FULLY_ANALYZED;
         }
         else
         {
-            node->value = child_list[0].resulting_node->value;
-            node->continuations = new GameNode::Child[node->child_count];
-            memcpy(node->continuations, child_list, node->child_count * sizeof GameNode::Child);
+            const Value best_value = children.nodes[0].value;
+            order_new_children(children, child_count);
+
+            GameNode* child_nodes = new_children(child_count, &node->children);
+            if (child_nodes == NULL)
+            {
+                // No room in the arena: leave the node unexpanded (callers
+                // check child_count) and stop the search
+                node->explored_depth = -1;
+                abandon_search();
+                return;
+            }
+
+            memcpy(child_nodes, children.nodes, child_count * sizeof(GameNode));
+            memcpy(child_nodes + child_count, children.moves, child_count * sizeof(GameMove));
+            node->child_count = short(child_count);
+            node->value = best_value;
+        }
+    }
+}
+
+
+//
+// Move the given move to the head of a node's child list, if present.  This
+// disturbs the list's ordering by value, which negamax() restores as it goes.
+// Returns false if the move isn't in the list.
+//
+
+FORCEINLINE bool GameState::promote_move(GameNode* node, GameMove move)
+{
+    const ChildList children = children_of(node);
+
+    for (int n = 0; n < node->child_count; ++n)
+    {
+        if (children.moves[n] == move)
+        {
+            move_child(children, n, 0);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+Result GameState::perform_move(GameMove move)
+{
+    TRACE_VOID_METHOD();
+
+    // If this is the first move of the game, m_current_node may not have been
+    // populated yet.  (If the game tree has no room for it, the move can't be
+    // recorded there.)
+    generate_move_list(m_current_node);
+    if (m_current_node->child_count < 0)
+    {
+        return Result::Fail;
+    }
+    ASSERT(m_current_node->child_count > 0);
+
+    Result hr = (move == PASSING_MOVE) ? apply_passing_move() : apply_move(move);
+
+    if (hr.ok())
+    {
+        if (m_predicted_move != INVALID_MOVE && equivalent_moves(move, m_predicted_move))
+        {
+            ++m_ponder_hits;
+        }
+        m_predicted_move = INVALID_MOVE;
+
+        // In case this is a human move and doesn't match the computer's chosen
+        // optimal move, we move it to the head of the current node's move list.
+        // This way the game tree provides a record of the course of the game,
+        // and stores the alternative moves that were available at each position
+        // along with their estimated values (but not their entire subtrees).
+
+        const ChildList children = children_of(m_current_node);
+        bool found = false;
+
+        // FIXME: computer may generate B1A1 as a valid move in the list
+        // (to stand in for B1A1, B2A1 and A2A1) and if the user then does
+        // a different variant (e.g. A2A1) this code won't find it in the
+        // list and the ASSERT below will fire.
+
+        // FIXME: Could remove the 'equivalent_moves' stuff completely if it
+        // isn't applicable to games other than Ataxx, by representing clone
+        // moves using only the destination cell (not the source cell)
+
+        for (int n = 0; n < m_current_node->child_count; ++n)
+        {
+            if (equivalent_moves(move, children.moves[n]))
+            {
+                // Found the continuation that was actually used; place it at
+                // the head of the list (a no-op if n is 0).  Note that this
+                // leaves the remainder of the list (beyond children[n])
+                // undisturbed, so this loop can proceed.
+                move_child(children, n, 0);
+                found = true;
+            }
+            else
+            {
+                // Found an alternative continuation; cut off its subtrees
+                // (compact_tree() reclaims them below), but leave its value
+                // and explored depth intact.
+                children.nodes[n].child_count = 0;
+            }
         }
 
-        delete[] possible_moves;
+        ASSERT(found);
+        m_current_node = &children.nodes[0];
+        compact_tree();
+    }
+
+    return hr;
+}
+
+
+//
+// Returns to the previous position's node, which is found by following the
+// moves played from the start (perform_move() keeps each one at the head of
+// its node's child list).  Since perform_move() discarded the subtrees of
+// its other children, the node's move list is generated afresh; the old one
+// is cut off here and reclaimed by compact_tree().
+//
+
+void GameState::revert_move()
+{
+    TRACE_VOID_METHOD();
+    ASSERT(m_current_node != m_initial_node);
+
+    undo_last_move();
+
+    GameNode* parent = m_initial_node;
+    while (children_of(parent).nodes != m_current_node)
+    {
+        parent = children_of(parent).nodes;
+    }
+
+    parent->child_count = -1;
+    parent->explored_depth = -1;
+
+    m_current_node = parent;
+    m_predicted_move = INVALID_MOVE;
+    compact_tree();
+}
+
+
+//
+// Fixed-depth search and move list evaluation through the game's virtual
+// functions, for games that don't bind a Searcher to their own class
+//
+
+Value GameState::fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes)
+{
+    return Searcher<GameState>(this).search(depth, best_move, nodes);
+}
+
+int GameState::evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values)
+{
+    return Searcher<GameState>(this).evaluate_moves(moves, values);
+}
+
+
+//
+// Pondering.  Should the opponent play some other move than the predicted one,
+// perform_move() discards the predicted move's subtree as usual.
+//
+
+Result GameState::start_pondering(int target_depth)
+{
+    TRACE_VOID_METHOD();
+    ASSERT(m_thinker == NULL);
+
+    // (The Monte Carlo search keeps nothing from one analysis to the next, so
+    // it has nothing to gain from pondering)
+    if (game_over() || m_search_driver == eMonteCarlo) return Result::Fail;
+
+    // (Set before the thread starts, since it silences output())
+    m_thinker = new Thinker(this, target_depth);
+
+    if (FAILED(m_thinker->initialize()))
+    {
+        TRACE(WARNING, "Failed to start the pondering thread");
+        delete m_thinker;
+        m_thinker = NULL;
+        return Result::Fail;
+    }
+
+    return Result::OK;
+}
+
+
+void GameState::stop_pondering()
+{
+    TRACE_VOID_METHOD();
+
+    delete m_thinker;  // Stops the thread
+    m_thinker = NULL;
+}
+
+
+//
+// Main routine of the pondering thread.  The reply at the head of the current
+// node's move list is the one the last search expected, so that is searched
+// first, as if it had already been played; the search is then repeated from
+// the current position, which also explores all the other replies.  Both
+// searches go on until they reach the target depth or the stop flag is set.
+//
+
+void GameState::ponder(int target_depth, const volatile LONG* stop_flag)
+{
+    const int unlimited_time = 0x7FFFFFFF;  // Milliseconds; pondering stops only when told to
+    m_stop_flag = stop_flag;
+
+    generate_move_list(m_current_node);
+    if (m_current_node->child_count < 0)  // No room in the game tree
+    {
+        m_stop_flag = NULL;
+        return;
+    }
+    GameNode* position = m_current_node;
+    const ChildList predicted = children_of(position);  // (Its first entry)
+    GameMove move;
+
+    if ((predicted.moves[0] == PASSING_MOVE ? apply_passing_move() : apply_move(predicted.moves[0])).ok())
+    {
+        // (Pondering may be restarted in the same position)
+        if (m_predicted_move == INVALID_MOVE) ++m_ponder_predictions;
+        m_predicted_move = predicted.moves[0];
+
+        m_current_node = &predicted.nodes[0];
+        if (!game_over())
+        {
+            analyze(target_depth, unlimited_time, &move);
+        }
+        undo_last_move();
+        m_current_node = position;
+    }
+
+    if (!search_aborted())
+    {
+        analyze(target_depth + 1, unlimited_time, &move);
+    }
+
+    m_stop_flag = NULL;
+}
+
+
+//
+// Wrapper for negamax()
+//
+//  target_depth: target search depth
+//  maximum_analysis_ms: time limit in milliseconds
+//  ret_move: returns best move found, or NULL if none available (or if the
+//            game tree has no room for the position's move list)
+//  lower_bound: ...
+//  upper_bound: ...
+//
+// The time limit is enforced within the search: negamax() checks the clock
+// every DEADLINE_POLL_INTERVAL calls, and once the time is up, the search is
+// abandoned and the move chosen by the last complete iteration is returned.
+// The search also ends early if the best move has stayed the same for
+// STABLE_MOVE_ITERATIONS iterations and a quarter of the time has been used,
+// since each iteration usually takes longer than all the previous ones
+// together, so the next one would probably not finish anyway.
+//
+
+Value GameState::analyze(int target_depth, int maximum_analysis_ms, __out GameMove* ret_move, Value lower_bound, Value upper_bound)
+{
+    TRACE_VOID_METHOD();
+
+    if (lower_bound == INVALID_VALUE) lower_bound = min_val();
+    if (upper_bound == INVALID_VALUE) upper_bound = (game_attributes() & eGreedy) ? max_val() : victory_val();
+
+    ASSERT(ret_move != NULL);
+    *ret_move = INVALID_MOVE;
+
+    // Games that know perfect play outright need no search at all
+    Value solved_value;
+    if (solved_position(ret_move, &solved_value))
+    {
+        return solved_value;
+    }
+
+    // Nor do positions in the opening book
+    if (m_opening_book && probe_opening_book(ret_move, &solved_value))
+    {
+        return solved_value;
+    }
+
+    if (m_search_driver == eMonteCarlo)
+    {
+        if (m_monte_carlo == NULL)
+        {
+            m_monte_carlo = new MonteCarloSearch;
+            if (m_monte_carlo->allocate(MCTS_POOL_NODES).failed())
+            {
+                TRACE(WARNING, "Failed to allocate a %d-node Monte Carlo search tree; using minimax", MCTS_POOL_NODES);
+                delete m_monte_carlo;
+                m_monte_carlo = NULL;
+            }
+        }
+        if (m_monte_carlo)
+        {
+            return m_monte_carlo->search(this, maximum_analysis_ms, ret_move);
+        }
+    }
+
+    #if USE_TRANSPOSITION_TABLE
+        if (m_transposition_table == NULL && position_hash() != 0)
+        {
+            m_transposition_table = new TranspositionTable;
+            if (m_transposition_table->allocate(TRANSPOSITION_TABLE_MB).failed())
+            {
+                TRACE(WARNING, "Failed to allocate a %d MB transposition table", TRANSPOSITION_TABLE_MB);
+                delete m_transposition_table;
+                m_transposition_table = NULL;
+            }
+        }
+        if (m_transposition_table)
+        {
+            m_transposition_table->new_search();
+        }
+    #endif
+
+    #if USE_KILLERS_AND_HISTORY
+        if (m_move_ordering == NULL)
+        {
+            m_move_ordering = new MoveOrdering;
+            if (m_move_ordering->allocate(move_index_count()).failed())
+            {
+                TRACE(WARNING, "Failed to allocate a history table for %d moves", move_index_count());
+                delete m_move_ordering;
+                m_move_ordering = NULL;
+            }
+        }
+        if (m_move_ordering)
+        {
+            m_move_ordering->new_search();
+        }
+    #endif
+
+    // Populate the move list if necessary.  Without room for it in the game
+    // tree there is nothing to search.  (No search is under way yet, so
+    // generate_move_list() can't have stopped one.)
+    generate_move_list(m_current_node);
+    if (m_current_node->child_count < 0)
+    {
+        return INVALID_VALUE;
+    }
+    const ChildList children = children_of(m_current_node);
+
+    // We can skip analysis and return a move right away in 3 cases:
+    //
+    // 1. We've already explored the game tree to the requested depth.
+    //    (The same result may be produced by the code below, but it
+    //    does no harm to skip it altogether, for clarity.)
+    //
+    // 2. There is only one valid move.
+    //
+    // 3. We can achieve the requested value immediately.
+
+    if (m_current_node->explored_depth >= target_depth ||
+        m_current_node->child_count == 1 ||
+        side_sign() * m_current_node->value >= side_sign() * upper_bound)
+    {
+        *ret_move = children.moves[0];
+        return m_current_node->value;
+    }
+
+    // Result of the last complete iteration (so far, just the move list's order)
+    GameMove completed_move = children.moves[0];
+    Value completed_value = children.nodes[0].value;
+    int stable_iterations = 0;
+
+    m_current_node->value = INVALID_VALUE;  // This may be unnecessary
+    bool already_bragged = false;
+
+    DELAY_CHECKPOINT();
+
+    // The deadline stops the search through m_stop_flag, which split point
+    // workers share.  (When pondering, the Thinker's stop flag is in use, and
+    // there is no deadline.)
+    const volatile LONG* previous_stop_flag = m_stop_flag;
+    if (m_stop_flag == NULL)
+    {
+        m_out_of_time = 0;
+        m_stop_flag = &m_out_of_time;
+        m_deadline = GetPerfCounter() + UINT64(maximum_analysis_ms) * g_TicksPerMs;
+        m_deadline_countdown = DEADLINE_POLL_INTERVAL;
+    }
+
+    // A position the game can solve outright (see endgame_solvable()) gets a
+    // few shallow iterations, which leave a sensible move to fall back on if
+    // time runs out, and then one deep enough for every move to be handed to
+    // the solver
+    #if USE_ENDGAME_SOLVERS
+        const bool solving = endgame_solvable(FULLY_ANALYZED);
+        if (solving) target_depth = ENDGAME_PRELUDE_DEPTH + 1;
+    #else
+        const bool solving = false;
+    #endif
+
+    prepare_split_workers();
+
+    // Start the Lazy SMP helper threads, if any.  They follow our progress
+    // through 'main_depth' and keep searching until stop_helpers() is called.
+    volatile LONG main_depth = 0;
+    SearchHelper* helpers[MAX_SEARCH_THREADS];
+    int helper_count = start_helpers(target_depth, lower_bound, upper_bound, &main_depth, helpers);
+
+    // In each iteration up to the requested search depth we call negamax() for
+    // each move in our ordered list, and re-order it to optimize the next pass.
+
+    for (int current_depth = 0; current_depth < target_depth; ++current_depth)
+    {
+        // Used by some games' evaluation functions
+        g_current_search_depth = max(g_current_search_depth, current_depth);
+        main_depth = current_depth;
+        const int search_depth = (solving && current_depth == ENDGAME_PRELUDE_DEPTH) ? FULLY_ANALYZED - 1 : current_depth;
+
+        #if MINIMAX_TRACE
+            output("\b\b\b\b\b\b\b\b\bMINIMAX: Depth %d move order: ", current_depth + 1);
+            for (int n = 0; n < m_current_node->child_count; ++n)
+            {
+                char move_string[MAX_MOVE_STRING_SIZE];
+                write_move(children.moves[n], sizeof move_string, move_string);
+                output("%s (%d) ", move_string, children.nodes[n].value);
+            }
+            output("\nMINIMAX: ");
+        #endif
+
+        // Used to detect when deeper searches would be redundant
+        bool position_fully_analyzed;
+
+        // (A zero-width target range is already a single MTD(f) pass, so it
+        // doesn't need the MTD(f) driver or an aspiration window.  The first
+        // iteration has no previous value to centre a window on.)
+        Value best_value_so_far;
+        if (lower_bound == upper_bound)
+            best_value_so_far = search_root(search_depth, lower_bound, upper_bound, &position_fully_analyzed);
+        else if (m_search_driver == eMtdf)
+            best_value_so_far = search_root_mtdf(search_depth, lower_bound, upper_bound, &position_fully_analyzed);
+        else if (current_depth > 0 && aspiration_window() > 0 && search_depth == current_depth)
+            best_value_so_far = search_root_aspiration(search_depth, lower_bound, upper_bound, &position_fully_analyzed);
+        else
+            best_value_so_far = search_root(search_depth, lower_bound, upper_bound, &position_fully_analyzed);
+
+        // Stopped at the deadline (or, when pondering, from outside)
+        if (search_aborted())
+        {
+            #if MINIMAX_STATISTICS
+                output("Stopped during depth %d after %.0f ms (limit %d ms)\n", current_depth + 1, TOTAL_DELAY_MEASURED(), maximum_analysis_ms);
+            #endif
+            break;
+        }
+
+        stable_iterations = (children.moves[0] == completed_move) ? stable_iterations + 1 : 0;
+        completed_move = children.moves[0];
+        completed_value = children.nodes[0].value;
+
+        // (A solved position's value is already the best result available,
+        // and the opening book builder only needs to know that it is a win.)
+        if (!g_profiling && !solving && !m_building_book && current_depth > 1 && is_victory(best_value_so_far) && !already_bragged)
+        {
+            output("Winning within %d moves.\n", current_depth / 2 + 1);
+            already_bragged = true;
+            #if MAXIMIZE_VICTORY
+                // (Still bound by our deadline and stop flag, which are
+                // only released once maximize_victory() is done)
+                stop_helpers(helper_count, helpers);
+                Value victory_value = maximize_victory(maximum_analysis_ms, ret_move);
+                m_stop_flag = previous_stop_flag;
+                m_deadline = 0;
+                return victory_value;
+            #endif
+        }
+
+        if (position_fully_analyzed)
+        {
+            output("Position fully analyzed.\n");
+            break;
+        }
+
+        float total_ms = TOTAL_DELAY_MEASURED();
+        if (total_ms > float(maximum_analysis_ms))
+        {
+            #if MINIMAX_STATISTICS
+                output("Cutting off analysis at depth %d after %.0f ms (limit %d ms)\n\n", current_depth + 1, total_ms, maximum_analysis_ms);
+            #endif
+            break;
+        }
+        if (stable_iterations >= STABLE_MOVE_ITERATIONS && total_ms > float(maximum_analysis_ms) / 4)
+        {
+            #if MINIMAX_STATISTICS
+                output("Best move unchanged for %d iterations; stopping at depth %d after %.0f ms\n", stable_iterations, current_depth + 1, total_ms);
+            #endif
+            break;
+        }
+    }
+    // End of depth loop
+
+    stop_helpers(helper_count, helpers);
+
+    // An abandoned iteration may have left any move at the head of the list
+    if (search_aborted())
+    {
+        VERIFY_TRUE(promote_move(m_current_node, completed_move));
+        children.nodes[0].value = completed_value;
+    }
+
+    m_stop_flag = previous_stop_flag;
+    m_deadline = 0;
+
+    #if MINIMAX_STATISTICS
+        output("Move %d: %I64u nodes evaluated, %I64u moves applied, %I64u minimax calls, %I64u beta cutoffs, %I64u re-searches\n",
+               m_move_counter + 1, g_evaluated_nodes, g_moves_applied, g_minimax_calls, g_beta_cutoffs, g_pvs_researches);
+        g_total_evaluated_nodes += g_evaluated_nodes;
+        g_total_beta_cutoffs += g_beta_cutoffs;
+        g_evaluated_nodes = g_moves_applied = g_minimax_calls = g_beta_cutoffs = g_pvs_researches = 0;
+
+        if (g_mtdf_passes)
+        {
+            output("MTD(f): %I64u passes\n", g_mtdf_passes);
+            g_mtdf_passes = 0;
+        }
+        if (g_quiescence_nodes)
+        {
+            output("Quiescence: %I64u nodes, %I64u tactical moves, %I64u stand-pat cutoffs, %I64u stopped at depth %d\n",
+                   g_quiescence_nodes, g_quiescence_moves, g_quiescence_cutoffs, g_quiescence_depth_limits, QUIESCENCE_MAX_DEPTH);
+            g_quiescence_nodes = g_quiescence_moves = g_quiescence_cutoffs = g_quiescence_depth_limits = 0;
+        }
+        if (g_null_move_cutoffs + g_futility_prunes + g_razoring_prunes)
+        {
+            output("Forward pruning: %I64u null-move cutoffs, %I64u futile moves skipped, %I64u positions razored\n",
+                   g_null_move_cutoffs, g_futility_prunes, g_razoring_prunes);
+            g_null_move_cutoffs = g_futility_prunes = g_razoring_prunes = 0;
+        }
+        if (g_late_move_reductions)
+        {
+            output("Late move reductions: %I64u moves reduced, %I64u re-searched at full depth\n",
+                   g_late_move_reductions, g_late_move_researches);
+            g_late_move_reductions = g_late_move_researches = 0;
+        }
+        if (g_endgame_solves)
+        {
+            output("Endgame solver: %I64u positions solved, %I64u nodes\n", g_endgame_solves, g_endgame_nodes);
+            g_endgame_solves = g_endgame_nodes = 0;
+        }
+        if (g_move_lists)
+        {
+            output("Move generation: %I64u move lists, %I64u heap allocations\n", g_move_lists, g_move_list_allocations);
+            g_move_lists = g_move_list_allocations = 0;
+        }
+        if (m_node_arena)
+        {
+            // (The spare arena is empty, but holds blocks from earlier compactions)
+            const NodeArena::Statistics arena = m_node_arena->statistics();
+            const NodeArena::Statistics spare = m_spare_node_arena->statistics();
+            output("Game tree: %I64u KB allocated in %I64u KB of blocks; high-water mark %I64u KB, %I64u KB held; "
+                   "moves played kept %I64u KB and discarded %I64u KB\n",
+                   arena.allocated_bytes / 1024, arena.in_use_bytes / 1024,
+                   max(arena.high_water_bytes, spare.high_water_bytes) / 1024, (arena.block_bytes + spare.block_bytes) / 1024,
+                   g_tree_bytes_kept / 1024, g_tree_bytes_discarded / 1024);
+            g_tree_bytes_kept = g_tree_bytes_discarded = 0;
+        }
+        if (g_killer_cutoffs)
+        {
+            output("Killer moves: %I64u beta cutoffs\n", g_killer_cutoffs);
+            g_killer_cutoffs = 0;
+        }
+        if (g_aspiration_fails_low + g_aspiration_fails_high)
+        {
+            output("Aspiration windows: %I64u fails low, %I64u fails high\n", g_aspiration_fails_low, g_aspiration_fails_high);
+            g_aspiration_fails_low = g_aspiration_fails_high = 0;
+        }
+        if (helper_count)
+        {
+            output("Search threads: main + %d helpers\n", helper_count);
+        }
+        if (m_split_workers)
+        {
+            output("Search threads: main + %d split workers; %ld split points\n", m_split_workers->worker_count(), m_split_workers->splits());
+            m_split_workers->clear_statistics();
+        }
+        if (m_transposition_table)
+        {
+            const TranspositionTable::Statistics& tt = m_transposition_table->statistics();
+            output("Transposition table: %I64u probes, %I64u hits, %I64u cutoffs, %I64u stores, %I64u replacements, %I64u collisions\n",
+                   tt.probes, tt.hits, tt.cutoffs, tt.stores, tt.replacements, tt.collisions);
+            m_transposition_table->clear_statistics();
+        }
+    #endif
+
+    // Observe that all codepaths above lead to 'children.moves[0]' containing the
+    // best move found so far and 'children.nodes[0].value' its value.
+    *ret_move = children.moves[0];
+    return m_current_node->value = children.nodes[0].value;
+}
+
+
+//
+// Searches each move available in the current position to the given depth,
+// re-ordering the root move list to optimize the next pass.  Used by both
+// analyze() and the Lazy SMP helpers.
+//
+//  depth: search depth passed to negamax() for each move
+//  lower_bound, upper_bound: as in analyze()
+//  fully_analyzed: set to whether every move has been exhaustively searched
+//
+// Returns: the best value found
+//
+
+Value GameState::search_root(int depth, Value lower_bound, Value upper_bound, __out bool* fully_analyzed)
+{
+    const ChildList children = children_of(m_current_node);
+
+    *fully_analyzed = true;  // Falsified as needed below
+
+    // The search window, from the point of view of the player to move
+    const Value sign = side_sign();
+    Value alpha = sign * lower_bound;
+    const Value beta = sign * upper_bound;
+
+    Value best_value_so_far = lower_bound;
+
+    for (int n = 0; n < m_current_node->child_count; ++n)
+    {
+        MXTRACE(char move_string[MAX_MOVE_STRING_SIZE];
+                write_move(children.moves[n], sizeof move_string, move_string);
+                output("%s", move_string));
+
+        // The first move gets the full window; the rest only need to be shown
+        // to be no better than it (see negamax())
+        Value new_value = search_child(depth, children.moves[n], &children.nodes[n], alpha, beta, n > 0);
+
+        MXTRACE(output(": value %d                                                  \nMINIMAX: ", sign * new_value));
+
+        if (search_aborted())
+        {
+            *fully_analyzed = false;
+            break;
+        }
+
+        // Move this node to the appropriate position in the ordered child list,
+        // and refresh the best value so far from the head of the list.
+        adjust_node_position(children, n);
+        best_value_so_far = children.nodes[0].value;
+        alpha = max(alpha, sign * best_value_so_far);
+
+        *fully_analyzed &= (children.nodes[n].explored_depth == FULLY_ANALYZED);
+
+        if (new_value >= beta) break;  // Reached target value
+    }
+    // End of move loop
+
+    return best_value_so_far;
+}
+
+
+//
+// MTD(f) version of search_root(): finds the value of the current position by
+// a series of zero-window searches, each of which only determines whether the
+// value is above or below a test value.  Each pass narrows the range known to
+// contain the value, starting from the previous iteration's value as a guess,
+// until the range closes.  Zero-window searches are much cheaper than full
+// ones, and the bounds stored in the game tree and transposition table by one
+// pass spare most of the work of the next, so with a good first guess this
+// takes only a few passes.
+//
+// Parameters and return value are as for search_root().
+//
+
+Value GameState::search_root_mtdf(int depth, Value lower_bound, Value upper_bound, __out bool* fully_analyzed)
+{
+    const ChildList children = children_of(m_current_node);
+
+    // The range known to contain the value, and the current guess, from the
+    // point of view of the player to move
+    const Value sign = side_sign();
+    Value lower = sign * lower_bound;
+    Value upper = sign * upper_bound;
+    Value guess = sign * children.nodes[0].value;
+
+    // Move that last proved to be worth at least 'lower'.  When the final pass
+    // fails low, the order of the child list no longer identifies it.
+    GameMove best_move = children.moves[0];
+    int passes = 0;
+
+    while (lower < upper && passes < MTDF_MAX_PASSES)
+    {
+        Value beta = max(guess, lower + 1);
+
+        #if MINIMAX_STATISTICS
+            unsigned __int64 initial_node_count = g_evaluated_nodes;
+        #endif
+
+        guess = sign * search_root(depth, sign * (beta - 1), sign * beta, fully_analyzed);
+        ++passes;
+
+        if (search_aborted()) return children.nodes[0].value;
+
+        if (guess < beta)
+        {
+            upper = guess;  // Failed low
+        }
+        else
+        {
+            lower = guess;  // Failed high
+            best_move = children.moves[0];
+        }
+
+        #if MINIMAX_STATISTICS
+            ++g_mtdf_passes;
+            output("MTD(f) depth %d pass %d: test value %d, %s %d, %I64u nodes\n", depth + 1, passes, sign * beta,
+                   guess < beta ? "at most" : "at least", sign * guess, g_evaluated_nodes - initial_node_count);
+        #endif
+    }
+
+    if (lower < upper)
+    {
+        // Not converging (search instability can cause this); settle for a
+        // conventional search with the range found so far
+        TRACE(WARNING, "MTD(f) did not converge after %d passes", passes);
+        return search_root(depth, sign * lower, sign * upper, fully_analyzed);
+    }
+
+    VERIFY_TRUE(promote_move(m_current_node, best_move));
+
+    // A pass that cuts off early only analyzes some of the moves
+    *fully_analyzed = true;
+    for (int n = 0; n < m_current_node->child_count; ++n)
+    {
+        *fully_analyzed &= (children.nodes[n].explored_depth == FULLY_ANALYZED);
+    }
+
+    return children.nodes[0].value;
+}
+
+
+//
+// Aspiration window version of search_root(): searches the current position
+// with a narrow window centred on the previous iteration's value, which
+// prunes far more than a full window does when the value is stable from one
+// depth to the next.  If the value turns out to lie outside the window, the
+// search fails low or high and is repeated with the window widened on that
+// side, doubling the widening each time, until the value falls inside it or
+// the window reaches the requested bounds.
+//
+// Parameters and return value are as for search_root().
+//
+
+Value GameState::search_root_aspiration(int depth, Value lower_bound, Value upper_bound, __out bool* fully_analyzed)
+{
+    const ChildList children = children_of(m_current_node);
+
+    // The requested range and the window, from the point of view of the
+    // player to move
+    const Value sign = side_sign();
+    const Value lower = sign * lower_bound;
+    const Value upper = sign * upper_bound;
+    const Value guess = sign * children.nodes[0].value;
+
+    Value delta = aspiration_window();
+    Value alpha = max(lower, guess - delta);
+    Value beta = min(upper, guess + delta);
+
+    int fails_low = 0, fails_high = 0;
+    #if MINIMAX_STATISTICS
+        unsigned __int64 initial_node_count = g_evaluated_nodes;
+        unsigned __int64 wasted_nodes = 0;
+    #endif
+
+    for (;;)
+    {
+        #if MINIMAX_STATISTICS
+            unsigned __int64 search_node_count = g_evaluated_nodes;
+        #endif
+
+        Value value = sign * search_root(depth, sign * alpha, sign * beta, fully_analyzed);
+
+        if (search_aborted()) return children.nodes[0].value;
+
+        // The value is only a bound if it lies on or outside the window, and
+        // that bound is no use unless the window was narrower than requested
+        if (value <= alpha && alpha > lower)
+        {
+            ++fails_low;
+            delta *= 2;
+            alpha = max(lower, value - delta);
+        }
+        else if (value >= beta && beta < upper)
+        {
+            ++fails_high;
+            delta *= 2;
+            beta = min(upper, value + delta);
+        }
+        else
+        {
+            break;
+        }
+
+        #if MINIMAX_STATISTICS
+            wasted_nodes += g_evaluated_nodes - search_node_count;
+        #endif
+    }
+
+    #if MINIMAX_STATISTICS
+        g_aspiration_fails_low += fails_low;
+        g_aspiration_fails_high += fails_high;
+        output("Aspiration depth %d: guess %d, %d fails low, %d fails high, %d re-searches, %I64u nodes (%I64u in failed searches)\n",
+               depth + 1, sign * guess, fails_low, fails_high, fails_low + fails_high,
+               g_evaluated_nodes - initial_node_count, wasted_nodes);
+    #endif
+
+    return children.nodes[0].value;
+}
+
+
+//
+// Stops the search in progress, and those of its helpers and split workers,
+// as if its time had run out.  Used when the game tree has no more room.
+//
+
+void GameState::abandon_search()
+{
+    if (m_stop_flag)
+    {
+        InterlockedExchange(const_cast<volatile LONG*>(m_stop_flag), 1);
+    }
+}
+
+
+//
+// Creates a copy of this game for another search thread, sharing our
+// transposition table, split workers, stop flag and deadline (so that a
+// worker deep in a subtree stops the search on time, even while we only wait
+// for it).  Returns NULL if the game doesn't implement clone(), or if the
+// game tree has no room for it.
+//
+
+GameState* GameState::clone_for_search() const
+{
+    GameState* copy = clone();
+
+    if (copy)
+    {
+        copy->m_transposition_table = m_transposition_table;
+        copy->m_move_ordering = m_move_ordering;
+        copy->m_split_workers = m_split_workers;
+        copy->m_stop_flag = m_stop_flag;
+        copy->m_deadline = m_deadline;
+        copy->m_deadline_countdown = DEADLINE_POLL_INTERVAL;
+        copy->m_node_arena = m_node_arena;
+        copy->m_current_node = copy->m_initial_node = copy->new_node(0);
+
+        if (copy->m_initial_node == NULL)  // The arena is full
+        {
+            delete_clone(copy);
+            copy = NULL;
+        }
+    }
+
+    return copy;
+}
+
+
+void GameState::delete_clone(GameState* copy)
+{
+    // The shared objects belong to the main thread's game.  So does the arena
+    // holding the copy's game tree, which is reclaimed with the rest of the
+    // main thread's discarded nodes by its next compact_tree().
+    copy->m_transposition_table = NULL;
+    copy->m_move_ordering = NULL;
+    copy->m_split_workers = NULL;
+    copy->m_node_arena = NULL;
+    delete copy;
+}
+
+
+//
+// Identifies the game and its starting position to the files that search
+// results are kept in (opening books and checkpoints), so it must be called
+// in the starting position.  The board's size is mixed in with the hash,
+// since different games' empty boards may have the same hash.
+//
+
+PositionHash GameState::starting_position_key() const
+{
+    return position_hash() ^ (PositionHash(get_rows()) << 56) ^ (PositionHash(get_columns()) << 48);
+}
+
+
+//
+// Checkpoints: the transposition table saved to a file, to be loaded when a
+// later run resumes the analysis of the same game from the same start.
+//
+
+Result GameState::resume_search(const char* file_name)
+{
+    TRACE_VOID_METHOD();
+    ASSERT(move_counter() == 0);
+
+    #if USE_TRANSPOSITION_TABLE
+        if (FAILED(StringCbCopyA(m_checkpoint_file, sizeof m_checkpoint_file, file_name)))
+        {
+            *m_checkpoint_file = 0;
+            return Result::Fail;
+        }
+        m_checkpoint_key = starting_position_key();
+        m_last_checkpoint = GetPerfCounter();  // Nothing new to save yet
+
+        bool created = false;
+        if (m_transposition_table == NULL)
+        {
+            m_transposition_table = new TranspositionTable;
+            if (m_transposition_table == NULL) return Result::Fail;
+            created = true;
+        }
+
+        if (m_transposition_table->load(file_name, m_checkpoint_key).failed())
+        {
+            if (created)
+            {
+                // analyze() will allocate one of the usual size
+                delete m_transposition_table;
+                m_transposition_table = NULL;
+            }
+            return Result::Fail;
+        }
+
+        return Result::OK;
+    #else
+        UNREFERENCED_PARAMETER(file_name);
+        return Result::Fail;
+    #endif
+}
+
+
+Result GameState::checkpoint_search(bool now)
+{
+    TRACE_VOID_METHOD();
+
+    if (*m_checkpoint_file == 0 || m_transposition_table == NULL)
+    {
+        return Result::OK;  // Nothing to save
+    }
+
+    // The whole table is written each time, so not after every move
+    const UINT64 time_now = GetPerfCounter();
+    if (!now && time_now - m_last_checkpoint < UINT64(CHECKPOINT_INTERVAL_S) * 1000 * g_TicksPerMs)
+    {
+        return Result::OK;
+    }
+    m_last_checkpoint = time_now;
+
+    return m_transposition_table->save(m_checkpoint_file, m_checkpoint_key);
+}
+
+
+//
+// Opening books.  Books are tied to the starting position (see
+// starting_position_key()), so these must all be called there.
+//
+
+
+Result GameState::set_opening_book(const char* file_name)
+{
+    TRACE_VOID_METHOD();
+    ASSERT(move_counter() == 0);
+
+    if (m_opening_book == NULL)
+    {
+        m_opening_book = new OpeningBook;
+        if (m_opening_book == NULL) return Result::Fail;
+    }
+
+    if (m_opening_book->open(file_name, starting_position_key()).failed())
+    {
+        delete m_opening_book;
+        m_opening_book = NULL;
+        return Result::Fail;
+    }
+
+    return Result::OK;
+}
+
+
+//
+// Plays the book move with the greatest weight.  The moves are checked, in
+// case of a hash collision with a position the book doesn't really have.
+//
+
+bool GameState::probe_opening_book(__out GameMove* ret_move, __out Value* value)
+{
+    int symmetry;
+    UINT64 count;
+    const BookEntry* entries = m_opening_book->find(canonical_hash(&symmetry), &count);
+
+    const BookEntry* best = NULL;
+    for (UINT64 n = 0; n < count; ++n)
+    {
+        if ((best == NULL || entries[n].weight > best->weight) && valid_move(transform_move(entries[n].move, symmetry, true)))
+        {
+            best = entries + n;
+        }
+    }
+
+    if (best == NULL) return false;
+
+    *ret_move = transform_move(best->move, symmetry, true);
+    *value = best->value;
+    return true;
+}
+
+
+Result GameState::build_opening_book(const char* file_name, int plies, int depth, int maximum_analysis_ms)
+{
+    TRACE_VOID_METHOD();
+    ASSERT(move_counter() == 0);
+
+    const PositionHash root_hash = starting_position_key();
+
+    // Start from what the book already has, if anything
+    BookEntryList existing, entries;
+    if (existing.read(file_name, root_hash).failed())
+    {
+        output("Failed to read \"%s\" (or it is an opening book for a different game).\n", file_name);
+        return Result::Fail;
+    }
+    existing.combine();
+
+    // The book being built mustn't answer the searches that build it
+    OpeningBook* opening_book = m_opening_book;
+    m_opening_book = NULL;
+    m_building_book = true;
+
+    DELAY_CHECKPOINT();
+    UINT64 positions = 0;
+    bool ok = add_book_moves(&entries, existing, plies, depth, maximum_analysis_ms, &positions).ok() &&
+              existing.add(entries).ok();
+
+    m_opening_book = opening_book;
+    m_building_book = false;
+
+    if (ok)
+    {
+        existing.combine();
+        ok = existing.write(file_name, root_hash).ok();
+    }
+
+    if (ok)
+    {
+        output("Opening book: %I64u positions searched in %.3f seconds; \"%s\" has %I64u entries\n",
+               positions, DELAY_MEASURED() / 1000, file_name, existing.count());
+    }
+    else
+    {
+        output("Failed to write \"%s\"; error %u\n", file_name, GetLastError());
+    }
+
+    return ok ? Result::OK : Result::Fail;
+}
+
+
+//
+// Searches each of the current position's moves in turn (unless the book
+// already has the position to the required depth), adds the good ones to
+// 'entries', and does the same for the positions they lead to.  Forced moves
+// are followed but not entered, since analyze() doesn't need help with them.
+//
+
+Result GameState::add_book_moves(__inout BookEntryList* entries, const BookEntryList& existing, int plies, int depth,
+                                 int maximum_analysis_ms, __inout UINT64* positions)
+{
+    if (plies == 0 || game_over())
+    {
+        return Result::OK;
+    }
+
+    // Moves to follow; perform_move() and revert_move() change the tree
+    generate_move_list(m_current_node);
+    if (m_current_node->child_count < 0)
+    {
+        return Result::Fail;  // No room in the game tree
+    }
+    const int move_count = m_current_node->child_count;
+    GameMove* moves = new GameMove[move_count];
+    Value* values = new Value[move_count];
+    if (moves == NULL || values == NULL)
+    {
+        delete[] moves;
+        delete[] values;
+        return Result::Fail;
+    }
+    memcpy(moves, children_of(m_current_node).moves, move_count * sizeof(GameMove));
+
+    int symmetry;
+    const PositionHash hash = canonical_hash(&symmetry);
+    int follow_count = move_count;
+    bool ok = true;
+
+    UINT64 known_count, deep_count = 0;
+    const BookEntry* known = existing.find(hash, &known_count);
+    while (deep_count < known_count && known[deep_count].depth >= UINT32(depth)) ++deep_count;
+
+    if (known_count > 0 && deep_count == known_count)
+    {
+        follow_count = 0;
+        for (UINT64 n = 0; n < known_count && follow_count < move_count; ++n)
+        {
+            moves[follow_count++] = transform_move(known[n].move, symmetry, true);
+        }
+    }
+    else if (move_count > 1)
+    {
+        Value best_value = -LIMIT_VALUE;
+        for (int n = 0; n < move_count && ok; ++n)
+        {
+            ok = perform_move(moves[n]).ok();
+            if (!ok) break;
+            GameMove reply = INVALID_MOVE;
+            const bool finished = game_over();
+            values[n] = finished ? game_over_val() : analyze(max(depth - 1, 1), maximum_analysis_ms, &reply);
+            ok = finished || reply != INVALID_MOVE;  // (analyze() fails only if the game tree is full)
+            revert_move();
+            best_value = max(best_value, side_sign() * values[n]);
+        }
+        ++*positions;
+
+        // Keep the moves within BOOK_MARGIN of the best, the closest weighing most
+        follow_count = 0;
+        for (int n = 0; n < move_count && ok; ++n)
+        {
+            const Value shortfall = best_value - side_sign() * values[n];
+            if (shortfall <= BOOK_MARGIN)
+            {
+                BookEntry entry = {hash, transform_move(moves[n], symmetry, false), values[n], UINT32(BOOK_MARGIN - shortfall + 1), UINT32(depth)};
+                ok = entries->add(entry).ok();
+                moves[follow_count++] = moves[n];
+            }
+        }
+    }
+
+    for (int n = 0; n < follow_count && ok; ++n)
+    {
+        ok = perform_move(moves[n]).ok();
+        if (!ok) break;
+        ok = add_book_moves(entries, existing, plies - 1, depth, maximum_analysis_ms, positions).ok();
+        revert_move();
+    }
+
+    delete[] moves;
+    delete[] values;
+    return ok ? Result::OK : Result::Fail;
+}
+
+
+Result GameState::merge_opening_book(const char* file_name, const char* other_file_name)
+{
+    TRACE_VOID_METHOD();
+    ASSERT(move_counter() == 0);
+
+    const PositionHash root_hash = starting_position_key();
+    BookEntryList entries;
+    if (entries.read(file_name, root_hash).failed() || entries.read(other_file_name, root_hash).failed())
+    {
+        output("Failed to read the opening books (or they are for different games).\n");
+        return Result::Fail;
+    }
+
+    entries.combine();
+    if (entries.write(file_name, root_hash).failed())
+    {
+        output("Failed to write \"%s\"; error %u\n", file_name, GetLastError());
+        return Result::Fail;
+    }
+
+    output("Opening book \"%s\" has %I64u entries\n", file_name, entries.count());
+    return Result::OK;
+}
+
+
+//
+// Lazy SMP helper management.  Helpers need a game that can be cloned and a
+// transposition table to share their results through.
+//
+
+int GameState::start_helpers(int target_depth, Value lower_bound, Value upper_bound, const volatile LONG* main_depth,
+                             __out_ecount(MAX_SEARCH_THREADS) SearchHelper** helpers)
+{
+    int helper_count = 0;
+
+    while (m_parallel_search == eLazySmp && m_transposition_table && helper_count < m_search_threads - 1)
+    {
+        GameState* copy = clone_for_search();
+        if (copy == NULL) break;
+
+        SearchHelper* helper = new SearchHelper(copy, helper_count + 1);
+
+        if (FAILED(helper->start(target_depth, lower_bound, upper_bound, main_depth)))
+        {
+            TRACE(WARNING, "Failed to start search helper %d", helper_count + 1);
+            delete helper;
+            break;
+        }
+
+        helpers[helper_count++] = helper;
+    }
+
+    return helper_count;
+}
+
+
+void GameState::stop_helpers(int helper_count, __inout_ecount(helper_count) SearchHelper** helpers)
+{
+    for (int n = 0; n < helper_count; ++n)
+    {
+        delete helpers[n];  // Stops the thread
+    }
+}
+
+
+//
+// Main loop of a Lazy SMP helper thread, running on a clone of the main game.
+// Odd-numbered helpers search one ply deeper than the main thread and even-
+// numbered ones two plies deeper, so that between them they cover the depths
+// the main thread will need next.
+//
+
+void GameState::helper_search(int helper_index, int target_depth, Value lower_bound, Value upper_bound, const volatile LONG* main_depth)
+{
+    generate_move_list(m_current_node);
+    if (m_current_node->child_count < 0) return;  // No room in the game tree (the search has been stopped)
+
+    int lead = 2 - helper_index % 2;
+    int current_depth = int(*main_depth) + lead;
+
+    while (current_depth < target_depth && !search_aborted())
+    {
+        bool position_fully_analyzed;
+        search_root(current_depth, lower_bound, upper_bound, &position_fully_analyzed);
+        if (position_fully_analyzed) break;
+
+        current_depth = max(current_depth + 1, int(*main_depth) + lead);
+    }
+}
+
+
+//
+// Young Brothers Wait support.  The worker pool persists between searches,
+// but is recreated if the number of threads changes.
+//
+
+void GameState::prepare_split_workers()
+{
+    int workers_wanted = (m_parallel_search == eSplitPoints) ? m_search_threads - 1 : 0;
+
+    if (m_split_workers && m_split_workers->worker_count() != workers_wanted)
+    {
+        delete m_split_workers;
+        m_split_workers = NULL;
+    }
+
+    if (m_split_workers == NULL && workers_wanted > 0)
+    {
+        m_split_workers = new SplitWorkerPool;
+        if (FAILED(m_split_workers->initialize(workers_wanted)))
+        {
+            TRACE(WARNING, "Failed to start %d split workers", workers_wanted);
+            delete m_split_workers;
+            m_split_workers = NULL;
+        }
+    }
+}
+
+
+//
+// Whether it's worth making a node a split point: there must be enough depth
+// left to repay the cost of cloning the game, and someone to share with.
+//
+
+FORCEINLINE bool GameState::can_split(const GameNode* node, int depth) const
+{
+    return m_split_workers != NULL && depth >= YBWC_MIN_SPLIT_DEPTH &&
+           node->child_count > 1 && m_split_workers->any_idle();
+}
+
+
+//
+// Searches the children of a node other than the first (which the caller has
+// already searched) in parallel with any idle split workers.  On return the
+// node's child list is re-ordered with the best child first, and its explored
+// depth reflects the children searched.  Returns whether there was a beta
+// cutoff.  If the search was abandoned (see search_aborted()) the results are
+// meaningless.
+//
+
+bool GameState::split(GameNode* node, int depth, Value alpha, Value beta)
+{
+    const ChildList children = children_of(node);
+
+    SplitPoint split_point;
+    InitializeCriticalSection(&split_point.lock);
+    split_point.node = node;
+    split_point.depth = depth;
+    split_point.beta = beta;
+    split_point.parent = m_split_point;
+    split_point.cutoff = 0;
+    split_point.active_workers = 0;
+    split_point.next_child = 1;
+    split_point.best_child = 0;
+    split_point.best_value = side_sign() * children.nodes[0].value;
+    split_point.alpha = max(alpha, split_point.best_value);
+    split_point.explored_depth = node->explored_depth;
+
+    m_split_workers->record_split();
+
+    // Recruit idle workers, each with its own copy of the game in this position
+    SplitWorker* worker;
+    while (split_point.active_workers + 1 < node->child_count - 1 &&
+           (worker = m_split_workers->reserve_worker()) != NULL)
+    {
+        GameState* copy = clone_for_search();
+        if (copy == NULL)
+        {
+            m_split_workers->release_worker(worker);
+            break;
+        }
+
+        InterlockedIncrement(&split_point.active_workers);
+        worker->assign(copy, &split_point);
+    }
+
+    // Search our share of the children, then wait for the workers to finish theirs
+    search_split_point(&split_point);
+    while (split_point.active_workers != 0)
+    {
+        SwitchToThread();
+    }
+
+    DeleteCriticalSection(&split_point.lock);
+
+    // Children finished out of order, so sort the ones we've searched, then make
+    // sure the best one is first (an abandoned child's stale value could be higher)
+    GameMove best_move = children.moves[split_point.best_child];
+    int children_searched = min(split_point.next_child, int(node->child_count));
+    for (int n = 1; n < children_searched; ++n)
+    {
+        adjust_node_position(children, n);
     }
+    VERIFY_TRUE(promote_move(node, best_move));
+
+    node->explored_depth = short(split_point.explored_depth);
+
+    return split_point.cutoff != 0;
 }
 
 
-Result GameState::perform_move(GameMove move)
-{
-    TRACE_VOID_METHOD();
+//
+// Main loop for every thread working on a split point: take the next child
+// that nobody has searched, search it, and record the result.
+//
 
-    // If this is the first move of the game, m_current_node may not have been
-    // populated yet.
-    generate_move_list(m_current_node);
-    ASSERT(m_current_node->child_count > 0);
+void GameState::search_split_point(SplitPoint* split_point)
+{
+    GameNode* node = split_point->node;
+    const ChildList children = children_of(node);
 
-    Result hr = (move == PASSING_MOVE) ? apply_passing_move() : apply_move(move);
+    SplitPoint* previous_split_point = m_split_point;
+    m_split_point = split_point;  // Makes search_aborted() notice cutoffs
 
-    if (hr.ok())
+    for (;;)
     {
-        // In case this is a human move and doesn't match the computer's chosen
-        // optimal move, we move it to the head of the current node's move list.
-        // This way the game tree provides a record of the course of the game,
-        // and stores the alternative moves that were available at each position
-        // along with their estimated values (but not their entire subtrees).
-
-        GameNode* new_current_node = NULL;
+        EnterCriticalSection(&split_point->lock);
+        int n = split_point->next_child++;
+        Value alpha = split_point->alpha;
+        LeaveCriticalSection(&split_point->lock);
 
-        // FIXME: computer may generate B1A1 as a valid move in the list
-        // (to stand in for B1A1, B2A1 and A2A1) and if the user then does
-        // a different variant (e.g. A2A1) this code won't find it in the
-        // list and the ASSERT below will fire.
+        if (n >= node->child_count || search_aborted()) break;
 
-        // FIXME: Could remove the 'equivalent_moves' stuff completely if it
-        // isn't applicable to games other than Ataxx, by representing clone
-        // moves using only the destination cell (not the source cell)
+        int reduction = late_move_reduction(split_point->depth, n, children.moves[n]);
+        Value new_value = search_child(split_point->depth - 1, children.moves[n], &children.nodes[n], alpha, split_point->beta, true, reduction);
 
-        for (int n = 0; n < m_current_node->child_count; ++n)
+        EnterCriticalSection(&split_point->lock);
+        if (!search_aborted())
         {
-            if (equivalent_moves(move, m_current_node->continuations[n].move))
+            if (new_value > split_point->best_value)
             {
-                // Found the continuation that was actually used; place it at
-                // the head of the list (a no-op if n is 0).
-                GameNode::Child path_taken = m_current_node->continuations[n];
-                new_current_node = path_taken.resulting_node;
-
-                // Shift remaining nodes in the list to the right to make room for the new one
-                memmove(m_current_node->continuations + 1, m_current_node->continuations, n * sizeof GameNode::Child);
-
-                m_current_node->continuations[0] = path_taken;
-
-                // Note that this leaves the remainder of the list (beyond
-                // continuations[n]) undisturbed, so this loop can proceed.
+                split_point->best_value = new_value;
+                split_point->best_child = n;
             }
-            else
-            {
-                // Found an alternative continuation; remove its subtrees,
-                // but leave its value and explored depth intact.
-                GameNode* path_not_taken = m_current_node->continuations[n].resulting_node;
+            split_point->alpha = max(split_point->alpha, new_value);
 
-                for (int m = 0; m < m_current_node->continuations[n].resulting_node->child_count; ++m)
-                {
-                    prune_tree(path_not_taken->continuations[m].resulting_node);
-                }
+            // (A reduced search that failed low counts as one of full depth)
+            int child_depth = 1 + children.nodes[n].explored_depth;
+            if (reduction > 0) child_depth = max(child_depth, split_point->depth);
+            split_point->explored_depth = min(split_point->explored_depth, child_depth);
 
-                delete[] path_not_taken->continuations;
-                path_not_taken->continuations = NULL;
-                path_not_taken->child_count = 0;
+            if (new_value >= split_point->beta)
+            {
+                InterlockedExchange(&split_point->cutoff, 1);
             }
         }
-
-        ASSERT(new_current_node != NULL);
-        m_current_node = new_current_node;
+        LeaveCriticalSection(&split_point->lock);
     }
 
-    return hr;
+    m_split_point = previous_split_point;
 }
 
 
-void GameState::revert_move()
+//
+// Searches one child of the current position, returning its value from the
+// point of view of the player to move here.  With 'scout' set, the child is
+// first searched with a zero window just above alpha, which can only show
+// whether it is better than alpha; if it is, it is searched again with the
+// full window to find out by how much (Principal Variation Search).
+//
+// A nonzero 'reduction' makes the scout search that many plies shallower
+// (see late_move_reduction()).  If even the shallow search finds the child
+// better than alpha, it is scouted again at full depth before going on.
+//
+
+FORCEINLINE Value GameState::search_child(int depth, GameMove move, GameNode* child, Value alpha, Value beta, bool scout, int reduction)
 {
-    TRACE_VOID_METHOD();
+    VERIFY(move == PASSING_MOVE ? apply_passing_move() : apply_move(move));
+    #if MINIMAX_STATISTICS
+        ++g_moves_applied;
+    #endif
+
+    Value value;
+    if (scout)
+    {
+        if (reduction > 0)
+        {
+            #if MINIMAX_STATISTICS
+                ++g_late_move_reductions;
+            #endif
+            value = -negamax(depth - reduction, child, -alpha - 1, -alpha);
+
+            if (value <= alpha || search_aborted())
+            {
+                undo_last_move();
+                return value;
+            }
+            #if MINIMAX_STATISTICS
+                ++g_late_move_researches;
+            #endif
+        }
+
+        value = -negamax(depth, child, -alpha - 1, -alpha);
+
+        if (value > alpha && value < beta && !search_aborted())
+        {
+            #if MINIMAX_STATISTICS
+                ++g_pvs_researches;
+            #endif
+            value = -negamax(depth, child, -beta, -alpha);
+        }
+    }
+    else
+    {
+        value = -negamax(depth, child, -beta, -alpha);
+    }
 
     undo_last_move();
-    prune_tree(m_current_node);
-    m_current_node = new GameNode(0);
+    return value;
 }
 
 
 //
-// Wrapper for minimax()
+// Quiescence search: finds the value of the current position (from the point
+// of view of the player to move) by playing out only its tactical moves, until
+// it is quiet.  The player to move may also "stand pat" and take the current
+// position_val() instead, so the result is at least that.  Unlike negamax(),
+// this builds no game tree, since the positions it visits are rarely needed
+// again.
 //
-//  target_depth: target search depth
-//  maximum_analysis_time: ...
-//  ret_move: returns best move found, or NULL if none available
-//  lower_bound: ...
-//  upper_bound: ...
+//  alpha, beta: as for negamax()
+//  depth: number of tactical moves played out so far
 //
 
-Value GameState::analyze(int target_depth, int maximum_analysis_time, __out GameMove* ret_move, Value lower_bound, Value upper_bound)
+Value GameState::quiesce(Value alpha, Value beta, int depth)
 {
-    TRACE_VOID_METHOD();
-
-    if (lower_bound == INVALID_VALUE) lower_bound = min_val();
-    if (upper_bound == INVALID_VALUE) upper_bound = (game_attributes() & eGreedy) ? max_val() : victory_val();
+    #if MINIMAX_STATISTICS
+        ++g_quiescence_nodes;
+    #endif
 
-    ASSERT(ret_move != NULL);
-    *ret_move = INVALID_MOVE;
+    Value best_value = side_sign() * position_val();
 
-    // Populate the move list if necessary
-    generate_move_list(m_current_node);
-    GameNode::Child* children = m_current_node->continuations;
+    if (best_value >= beta)
+    {
+        #if MINIMAX_STATISTICS
+            ++g_quiescence_cutoffs;
+        #endif
+        return best_value;
+    }
 
-    // We can skip analysis and return a move right away in 3 cases:
-    //
-    // 1. We've already explored the game tree to the requested depth.
-    //    (The same result may be produced by the code below, but it
-    //    does no harm to skip it altogether, for clarity.)
-    //
-    // 2. There is only one valid move.
-    //
-    // 3. We can achieve the requested value immediately.
+    if (is_quiet()) return best_value;
 
-    if (m_current_node->explored_depth >= target_depth ||
-        m_current_node->child_count == 1 ||
-        better_or_equal(m_current_node->value, upper_bound))
+    if (depth >= QUIESCENCE_MAX_DEPTH)
     {
-        *ret_move = children[0].move;
-        return m_current_node->value;
+        #if MINIMAX_STATISTICS
+            ++g_quiescence_depth_limits;
+        #endif
+        return best_value;
     }
 
-    m_current_node->value = INVALID_VALUE;  // This may be unnecessary
-    bool already_bragged = false;
+    alpha = max(alpha, best_value);
 
-    DELAY_CHECKPOINT();
+    MoveList tactical_moves;
 
-    // In each iteration up to the requested search depth we call minimax() for
-    // each move in our ordered list, and re-order it to optimize the next pass.
+    #if MINIMAX_STATISTICS
+        const unsigned __int64 allocations = g_thread_heap_allocations;
+        generate_tactical_moves(&tactical_moves);
+        g_move_list_allocations += g_thread_heap_allocations - allocations;
+        ++g_move_lists;
+    #else
+        generate_tactical_moves(&tactical_moves);
+    #endif
 
-    for (int current_depth = 0; current_depth < target_depth; ++current_depth)
+    for (int n = 0; n < tactical_moves.count(); ++n)
     {
-        // Used by some games' evaluation functions
-        g_current_search_depth = max(g_current_search_depth, current_depth);
-
-        #if MINIMAX_TRACE
-            output("\b\b\b\b\b\b\b\b\bMINIMAX: Depth %d move order: ", current_depth + 1);
-            for (int n = 0; n < m_current_node->child_count; ++n)
-            {
-                char move_string[MAX_MOVE_STRING_SIZE];
-                write_move(children[n].move, sizeof move_string, move_string);
-                output("%s (%d) ", move_string, children[n].resulting_node->value);
-            }
-            output("\nMINIMAX: ");
+        if (apply_move(tactical_moves[n]).failed()) continue;
+        #if MINIMAX_STATISTICS
+            ++g_quiescence_moves;
         #endif
 
-        // Used to detect when deeper searches would be redundant
-        bool position_fully_analyzed = true;  // Falsified as needed below
-
-        Value best_value_so_far = lower_bound;
+        Value value = -quiesce(-beta, -alpha, depth + 1);
+        undo_last_move();
 
-        for (int n = 0; n < m_current_node->child_count; ++n)
+        if (value > best_value)
         {
-            MXTRACE(char move_string[MAX_MOVE_STRING_SIZE];
-                    write_move(children[n].move, sizeof move_string, move_string);
-                    output("%s", move_string));
-            VERIFY(children[n].move == PASSING_MOVE ? apply_passing_move() : apply_move(children[n].move));
-            #if MINIMAX_STATISTICS
-                ++g_moves_applied;
-            #endif
+            best_value = value;
+            if (best_value >= beta) break;
+            alpha = max(alpha, best_value);
+        }
+    }
+
+    return best_value;
+}
 
-            // Call minimax with an upside-down target range (floor=upper_bound, ceiling=best_value_so_far)
-            Value new_value = minimax(current_depth, children[n].resulting_node, upper_bound, best_value_so_far);
 
-            undo_last_move();
-            MXTRACE(output(": value %d, %.3f ms                                                 \nMINIMAX: ", new_value, DELAY_MEASURED()));
 
-            // Move this node to the appropriate position in the ordered child list,
-            // and refresh the best value so far from the head of the list.
-            adjust_node_position(children, n);
-            best_value_so_far = children[0].resulting_node->value;
+//
+// Forward pruning of whole positions, before any of their moves are searched:
+//
+// Razoring: if the position's immediate value is so far below alpha that a
+// shallow search is unlikely to make up the difference, a quiescence search
+// is tried instead, and if that fails low by the same margin we give up.
+//
+// Null move: if the position looks good enough to exceed beta, let the
+// opponent move twice in a row, with a reduced search.  If we would still
+// exceed beta after giving up our turn, a real move will almost certainly do
+// so as well.  Games with passing moves pass; for others (and whenever
+// passing isn't allowed) the engine just switches the player to move.  Two
+// null moves in a row would prove nothing, so they aren't allowed.
+//
+// Returns true if the position can be pruned, with its value (an upper or
+// lower bound, also recorded in the node) in 'value'.
+//
 
-            position_fully_analyzed &= (children[n].resulting_node->explored_depth == FULLY_ANALYZED);
+bool GameState::prune_node(int depth, GameNode* node, Value alpha, Value beta, __out Value* value)
+{
+    const int attributes = game_attributes();
+    if (!(attributes & (eNullMovePruning | eRazoring)) || beta <= -VICTORY_VALUE || beta >= VICTORY_VALUE) return false;
 
-            if (better_or_equal(new_value, upper_bound)) break;  // Reached target value
-        }
-        // End of move loop
+    const Value sign = side_sign();
+    const Value static_value = sign * position_val();
 
-        if (!g_profiling && current_depth > 1 && is_victory(best_value_so_far) && !already_bragged)
+    if ((attributes & eRazoring) && depth >= 0 && depth < FORWARD_PRUNING_DEPTHS)
+    {
+        const Value margin = razoring_margins()[depth];
+        if (static_value + margin <= alpha)
         {
-            output("Winning within %d moves.\n", current_depth / 2 + 1);
-            already_bragged = true;
-            #if MAXIMIZE_VICTORY
-                return maximize_victory(ret_move);
-            #endif
+            Value razor_alpha = alpha - margin;
+            Value razor_value = quiesce(razor_alpha, razor_alpha + 1, 0);
+            if (razor_value <= razor_alpha)
+            {
+                #if MINIMAX_STATISTICS
+                    ++g_razoring_prunes;
+                #endif
+                node->explored_depth = short(depth);
+                node->bound = eUpperBound;
+                node->value = sign * razor_value;
+                *value = razor_value;
+                return true;
+            }
         }
+    }
 
-        if (position_fully_analyzed)
+    if ((attributes & eNullMovePruning) && depth >= NULL_MOVE_MIN_DEPTH && static_value >= beta && node != m_null_move_node)
+    {
+        bool passed = apply_passing_move().ok();
+        if (!passed) switch_player_up();
+
+        GameNode* null_move_node = new_node(position_val());
+        if (null_move_node == NULL)  // The arena is full
         {
-            output("Position fully analyzed.\n");
-            break;
+            if (passed) undo_last_move();
+            else switch_player_up();
+            abandon_search();
+            return false;
         }
+        GameNode* previous_null_move_node = m_null_move_node;
+        m_null_move_node = null_move_node;
+
+        Value null_move_value = -negamax(depth - 1 - NULL_MOVE_REDUCTION, null_move_node, -beta, -beta + 1);
+
+        m_null_move_node = previous_null_move_node;  // (Its subtree is left for compact_tree())
+        if (passed) undo_last_move();
+        else switch_player_up();
 
-        float total_seconds = TOTAL_DELAY_MEASURED() / 1000;
-        if (total_seconds > float(maximum_analysis_time))
+        if (null_move_value >= beta && !search_aborted())
         {
             #if MINIMAX_STATISTICS
-                output("Cutting off analysis at depth %d after %f seconds (target = %d)\n\n", current_depth + 1, total_seconds, maximum_analysis_time);
+                ++g_null_move_cutoffs;
             #endif
-            break;
+            // A win found without moving is no proof of a real one
+            if (null_move_value >= VICTORY_VALUE) null_move_value = beta;
+            node->explored_depth = short(depth);
+            node->bound = eLowerBound;
+            node->value = sign * null_move_value;
+            *value = null_move_value;
+            return true;
         }
     }
-    // End of depth loop
-
-    #if MINIMAX_STATISTICS
-        output("Move %d: %I64u nodes evaluated, %I64u moves applied, %I64u minimax calls, %I64u beta cutoffs\n",
-               m_move_counter + 1, g_evaluated_nodes, g_moves_applied, g_minimax_calls, g_beta_cutoffs);
-        g_total_evaluated_nodes += g_evaluated_nodes;
-        g_total_beta_cutoffs += g_beta_cutoffs;
-        g_evaluated_nodes = g_moves_applied = g_minimax_calls = g_beta_cutoffs = 0;
-    #endif
 
-    // Observe that all codepaths above lead to 'children[0].move' containing the
-    // best move found so far and 'children[0].resulting_node->value' its value.
-    *ret_move = children[0].move;
-    return m_current_node->value = children[0].resulting_node->value;
+    return false;
 }
 
 
 //
-// Minimax algorithm with alpha-beta optimization
+// Negamax search with alpha-beta pruning and Principal Variation Search
 //
 //  depth: search depth in plies
 //  node: game state to be analyzed
-//  floor: base value which this search is trying to improve upon
-//  ceiling: abort search if a value equal or better to this is found
-//
-// Returns: a *floor* for the current position's value to the current player
-// (the caller does not need more precision if this floor value is worse for
-// it than the best value it can obtain using a different move).
-//
-// FIXME: clean this up:
-//
-// Alpha-beta pruning seeks to reduce the number of search tree nodes
-// evaluated by the minimax algorithm.  It stops evaluating a move as
-// soon as a possibility has been found that proves the move to be no
-// better than a previously examined move.  Such moves need not be
-// evaluated further.
-//
-// The algorithm maintains two values, alpha and beta, which represent
-// the minimum score that the maximizing player is assured of and the
-// maximum score that the minimizing player is assured of, respectively.
-// Initially alpha is negative infinity and beta is positive infinity.
-// As the recursion progresses the "window" becomes smaller. When beta
-// becomes less than alpha, it means that the current position cannot
-// be the result of best play by both players and hence need not be
-// explored further.
-//
-// alphabeta(node, depth, A, B)
-//     ; B represents previous player's best choice
-//     if depth = 0 or node is terminal
-//         return node's heuristic value
-//     for each child of node
-//         A := max(A, -alphabeta(child, depth-1, -B, -A))  // FIXME: not how we do it below
-//         if B = A
-//             break ; Beta cut-off
-//     return A
-//
-// Initial call: alphabeta(origin, depth, -infinity, +infinity)
-
-Value GameState::minimax(int depth, GameNode* node, Value floor, Value ceiling)
+//  alpha: a value the player to move is already assured of elsewhere; any
+//         result no better than this need only be an upper bound
+//  beta: a value the opponent is already assured of elsewhere, so the
+//        search stops (a beta cutoff) as soon as a result this good is found
+//
+// Values here are always from the point of view of the player to move, so a
+// child's value is just the negation of its own result, searched with the
+// window negated and swapped.  (Nodes store values from player 0's point of
+// view; side_sign() converts them.)
+//
+// Returns: the position's value if it lies strictly between alpha and beta;
+// otherwise an upper bound <= alpha or a lower bound >= beta on it.  The node
+// records the same result, with its bound.
+//
+// With good move ordering the first child is usually the best one, so only
+// it is searched with the full window.  The others are scouted with a zero
+// window (see search_child()), which costs much less than a full search and
+// usually just confirms that they are worse.
+//
+
+Value GameState::negamax(int depth, GameNode* node, Value alpha, Value beta)
 {
     #if MINIMAX_STATISTICS
         ++g_minimax_calls;
     #endif
 
-    // Populate the move list if necessary
+    check_deadline();
+
+    const Value sign = side_sign();
+
+    #if USE_QUIESCENCE_SEARCH
+        // A leaf of a depth 0 search (see below) that hasn't been searched any
+        // deeper: rather than trust its immediate value, play out any tactical
+        // moves.  The result is only kept for ordering the leaves.
+        if (depth < 0 && node->explored_depth < 0 && (game_attributes() & eVolatile))
+        {
+            Value value = quiesce(alpha, beta, 0);
+            node->bound = BYTE(value >= beta ? eLowerBound : value <= alpha ? eUpperBound : eExact);
+            node->value = sign * value;
+            return value;
+        }
+    #endif
+
+    // Return if this search has been abandoned (the caller discards the result),
+    // or if this node has already been analyzed to the requested depth and the
+    // result is precise enough for this window
+    if (search_aborted() ||
+        (depth <= node->explored_depth && result_suffices(node->bound, sign * node->value, alpha, beta)))
+    {
+        return sign * node->value;
+    }
+
+    #if USE_TRANSPOSITION_TABLE
+        // See whether this position has been searched before via a different
+        // move order.  If so we may be able to return its value right away
+        // (even without expanding the node); otherwise we can at least try
+        // the best move found last time first.  Positions that are reflections
+        // or rotations of each other share an entry, whose best move is kept
+        // as it is played in their canonical image (see canonical_hash()).
+        int symmetry = 0;
+        const PositionHash hash = m_transposition_table ? canonical_hash(&symmetry) : 0;
+        TranspositionTable::Entry entry;
+        bool entry_found = hash && m_transposition_table->probe(hash, &entry);
+
+        if (entry_found)
+        {
+            int entry_depth = TranspositionTable::entry_depth(entry);
+            if (entry_depth >= depth && result_suffices(entry.bound, entry.value, alpha, beta))
+            {
+                m_transposition_table->record_cutoff();
+                node->explored_depth = short((entry.bound == eExact) ? entry_depth : depth);
+                node->bound = entry.bound;
+                node->value = sign * entry.value;
+                return entry.value;
+            }
+        }
+    #endif
+
+    #if USE_ENDGAME_SOLVERS
+        if (endgame_solvable(depth))
+        {
+            #if MINIMAX_STATISTICS
+                ++g_endgame_solves;
+            #endif
+            Value value = solve_endgame(alpha, beta);
+            if (search_aborted()) return value;  // (Discarded by the caller)
+
+            node->explored_depth = FULLY_ANALYZED;
+            node->bound = BYTE(value >= beta ? eLowerBound : value <= alpha ? eUpperBound : eExact);
+            node->value = sign * value;
+            #if USE_TRANSPOSITION_TABLE
+                if (hash)
+                {
+                    m_transposition_table->store(hash, value, ValueBound(node->bound), FULLY_ANALYZED, INVALID_MOVE);
+                }
+            #endif
+            return value;
+        }
+    #endif
+
+    #if USE_FORWARD_PRUNING
+        // Only zero-window searches may be cut short; a mistake in a full-window
+        // search would spoil the principal variation
+        Value pruned_value;
+        if (beta - alpha == 1 && prune_node(depth, node, alpha, beta, &pruned_value))
+        {
+            return pruned_value;
+        }
+
+        const Value* futility_margins = (depth >= 0 && depth < FORWARD_PRUNING_DEPTHS && (game_attributes() & eFutilityPruning) &&
+                                         alpha > -VICTORY_VALUE && alpha < VICTORY_VALUE) ? this->futility_margins() : NULL;
+    #endif
+
+    const Value original_alpha = alpha;
+
+    // Populate the move list if necessary.  (If there was no room for it, the
+    // search has been abandoned.)
     generate_move_list(node);
+    if (node->child_count < 0) return sign * node->value;
 
-    // Return if this node has already been analyzed to the requested depth
-    // or has been found to be terminal (explored_depth == FULLY_ANALYZED)
-    if (depth <= node->explored_depth) return node->value;
+    // Return if this node has just been found to be terminal (explored_depth ==
+    // FULLY_ANALYZED), or if expanding it was all the search required.  (In a
+    // volatile game a depth 0 search also has its leaves checked by quiesce().)
+    if (depth <= node->explored_depth && node->bound == eExact &&
+        (depth != 0 || node->explored_depth == FULLY_ANALYZED || !USE_QUIESCENCE_SEARCH || !(game_attributes() & eVolatile)))
+    {
+        return sign * node->value;
+    }
 
     ASSERT(node->child_count != 0);
-    GameNode::Child* children = node->continuations;
-    ASSERT(node->value == children[0].resulting_node->value);
+    const ChildList children = children_of(node);
+
+    #if USE_TRANSPOSITION_TABLE
+        if (entry_found && entry.best_move != INVALID_MOVE &&
+            !promote_move(node, symmetry ? transform_move(entry.best_move, symmetry, true) : entry.best_move))
+        {
+            m_transposition_table->record_collision();
+        }
+    #endif
 
     node->explored_depth = FULLY_ANALYZED;  // Possibly reduced in loop below
+    Value best_value = -LIMIT_VALUE;
 
     for (int n = 0; n < node->child_count; ++n)
     {
         MXTRACE(char move_string[MAX_MOVE_STRING_SIZE];
-                write_move(children[n].move, sizeof move_string, move_string);
+                write_move(children.moves[n], sizeof move_string, move_string);
                 int backspace_count = strlen(move_string) + 1;
                 printf(" %s", move_string));
-        VERIFY(children[n].move == PASSING_MOVE ? apply_passing_move() : apply_move(children[n].move));
-        #if MINIMAX_STATISTICS
-            ++g_moves_applied;
+
+        #if USE_FORWARD_PRUNING
+            // Futility pruning: skip moves whose immediate value is too far below
+            // alpha for a search of this depth to make up the difference (but
+            // treat this node as searched only to this depth, not exhaustively)
+            if (futility_margins && n > 0 &&
+                sign * children.nodes[n].value + futility_margins[depth] <= alpha)
+            {
+                #if MINIMAX_STATISTICS
+                    ++g_futility_prunes;
+                #endif
+                adjust_node_position(children, n);
+                best_value = sign * children.nodes[0].value;
+                node->explored_depth = short(min(int(node->explored_depth), depth));
+                continue;
+            }
         #endif
 
-        Value new_value = minimax(depth - 1, children[n].resulting_node, ceiling, floor);
+        // The next child's own child list is elsewhere in the arena; start
+        // fetching it while this child is searched
+        if (n + 1 < node->child_count && children.nodes[n + 1].child_count > 0)
+        {
+            PreFetchCacheLine(PF_TEMPORAL_LEVEL_1, m_node_arena->pointer(children.nodes[n + 1].children));
+        }
+
+        int reduction = (n > 0) ? late_move_reduction(depth, n, children.moves[n]) : 0;
+        Value new_value = search_child(depth - 1, children.moves[n], &children.nodes[n], alpha, beta, n > 0, reduction);
 
-        undo_last_move();
         MXTRACE(while (backspace_count--) putchar('\b'));
 
+        if (search_aborted())
+        {
+            // Don't store anything derived from an incomplete search, and leave
+            // the node looking unexplored so that it will be searched again
+            node->explored_depth = -1;
+            node->value = children.nodes[0].value;
+            return sign * node->value;
+        }
+
         // Move this node to the appropriate position in the ordered child list,
         // and refresh the best value so far from the head of the list.
         adjust_node_position(children, n);
-        floor = children[0].resulting_node->value;
+        best_value = sign * children.nodes[0].value;
+        alpha = max(alpha, best_value);
 
-        // Maintain the invariant that this node's explored depth = 1 + min(child depths)
-        node->explored_depth = min(node->explored_depth, 1 + children[n].resulting_node->explored_depth);
+        // Maintain the invariant that this node's explored depth = 1 + min(child
+        // depths), except that a reduced search that failed low counts as one of
+        // full depth; otherwise every later search would have to repeat it
+        int child_depth = 1 + children.nodes[n].explored_depth;
+        if (reduction > 0) child_depth = max(child_depth, depth);
+        node->explored_depth = short(min(int(node->explored_depth), child_depth));
 
-        if (better_or_equal(new_value, ceiling))  // Beta cutoff
+        if (new_value >= beta)  // Beta cutoff
         {
             #if MINIMAX_STATISTICS
                 ++g_beta_cutoffs;
             #endif
+            record_cutoff(children.moves[0], depth);  // (The move now at the head of the list)
+            break;
+        }
+
+        // Young Brothers Wait: once the eldest child has been searched, its
+        // siblings may be searched in parallel
+        if (n == 0 && can_split(node, depth))
+        {
+            bool split_cutoff = split(node, depth, alpha, beta);
+
+            if (search_aborted())
+            {
+                node->explored_depth = -1;
+                node->value = children.nodes[0].value;
+                return sign * node->value;
+            }
+
+            best_value = sign * children.nodes[0].value;
+            if (split_cutoff)
+            {
+                #if MINIMAX_STATISTICS
+                    ++g_beta_cutoffs;
+                #endif
+                record_cutoff(children.moves[0], depth);
+            }
             break;
         }
     }
 
-    // If this position is a guaranteed win for either player, we consider it fully analyzed
-    // FIXME: not sure this code is strictly needed
-//    if (is_victory(floor) || is_defeat(floor))
-//    {
-//        node->explored_depth = FULLY_ANALYZED;
-//    }
+    node->bound = BYTE(best_value >= beta ? eLowerBound : best_value <= original_alpha ? eUpperBound : eExact);
+    node->value = sign * best_value;
+
+    #if USE_TRANSPOSITION_TABLE
+        if (hash)
+        {
+            m_transposition_table->store(hash, best_value, ValueBound(node->bound), node->explored_depth,
+                                         symmetry ? transform_move(children.moves[0], symmetry, false) : children.moves[0]);
+        }
+    #endif
 
-    return node->value = floor;
+    return best_value;
 }
 
 
 #if MAXIMIZE_VICTORY
 
-    Value GameState::maximize_victory(__out GameMove* ret_move)
+    Value GameState::maximize_victory(int maximum_analysis_ms, __out GameMove* ret_move)
     {
         ASSERT(ret_move != NULL);
         *ret_move = INVALID_MOVE;
 
-        // Populate the move list if necessary
+        // Populate the move list if necessary (as analyze() does)
         generate_move_list(m_current_node);
-        GameNode::Child* children = m_current_node->continuations;
+        if (m_current_node->child_count < 0)
+        {
+            return INVALID_VALUE;
+        }
+        const ChildList children = children_of(m_current_node);
+
+        // Result of the last complete iteration, restored if one is abandoned
+        GameMove completed_move = children.moves[0];
+        Value completed_value = children.nodes[0].value;
+
+        // Called from analyze(), we share its deadline and stop flag;
+        // otherwise we set up our own, as it does
+        const volatile LONG* previous_stop_flag = m_stop_flag;
+        const UINT64 previous_deadline = m_deadline;
+        if (m_stop_flag == NULL)
+        {
+            m_out_of_time = 0;
+            m_stop_flag = &m_out_of_time;
+            m_deadline = GetPerfCounter() + UINT64(maximum_analysis_ms) * g_TicksPerMs;
+            m_deadline_countdown = DEADLINE_POLL_INTERVAL;
+        }
 
         #define TEST_MAX_DEPTH 100
         for (int current_depth = 0; current_depth < TEST_MAX_DEPTH; ++current_depth)
@@ -517,8 +2499,8 @@ Value GameState::minimax(int depth, GameNode* node, Value floor, Value ceiling)
                 for (int n = 0; n < m_current_node->child_count; ++n)
                 {
                     char move_string[MAX_MOVE_STRING_SIZE];
-                    write_move(children[n].move, sizeof move_string, move_string);
-                    output("%s (%d) ", move_string, children[n].resulting_node->value);
+                    write_move(children.moves[n], sizeof move_string, move_string);
+                    output("%s (%d) ", move_string, children.nodes[n].value);
                 }
                 output("\nMAXIKILL: ");
             #endif
@@ -527,50 +2509,74 @@ Value GameState::minimax(int depth, GameNode* node, Value floor, Value ceiling)
             bool position_fully_analyzed = true;  // Falsified as needed below
 
             Value best_value_so_far = min_val();
+            const Value sign = side_sign();
 
             for (int n = 0; n < m_current_node->child_count; ++n)
             {
                 MXTRACE(char move_string[MAX_MOVE_STRING_SIZE];
-                        write_move(children[n].move, sizeof move_string, move_string);
+                        write_move(children.moves[n], sizeof move_string, move_string);
                         output("%s", move_string));
-                VERIFY(children[n].move == PASSING_MOVE ? apply_passing_move() : apply_move(children[n].move));
-                #if MINIMAX_STATISTICS
-                    ++g_moves_applied;
-                #endif
 
-                Value new_value = minimax(current_depth, children[n].resulting_node, min_val(), best_value_so_far);
+                // Every move is searched with an open-ended window, since we want
+                // to know by how much each one wins
+                Value new_value = search_child(current_depth, children.moves[n], &children.nodes[n], sign * best_value_so_far, LIMIT_VALUE, false);
                 UNREFERENCED_PARAMETER(new_value);
+                if (search_aborted()) break;
 
-                undo_last_move();
-                MXTRACE(output(": value %d                                                  \nMAXIKILL: ", new_value));
+                MXTRACE(output(": value %d                                                  \nMAXIKILL: ", sign * new_value));
 
                 // Move this node to the appropriate position in the ordered child list,
                 // and refresh the best value so far from the head of the list.
                 adjust_node_position(children, n);
-                best_value_so_far = children[0].resulting_node->value;
+                best_value_so_far = children.nodes[0].value;
 
-                position_fully_analyzed &= (children[n].resulting_node->explored_depth == FULLY_ANALYZED);
+                position_fully_analyzed &= (children.nodes[n].explored_depth == FULLY_ANALYZED);
             }
             // End of move loop
 
+            if (search_aborted())
+            {
+                #if MINIMAX_STATISTICS
+                    output("Stopped maximizing victory during depth %d\n", current_depth + 1);
+                #endif
+                break;
+            }
+            completed_move = children.moves[0];
+            completed_value = children.nodes[0].value;
+
             if (position_fully_analyzed)
             {
                 output("Position fully analyzed.\n");
                 break;
             }
+
+            // Don't start another iteration once the time is up
+            if (m_deadline != 0 && GetPerfCounter() >= m_deadline)
+            {
+                break;
+            }
         }
         // End of depth loop
 
+        if (search_aborted())
+        {
+            VERIFY_TRUE(promote_move(m_current_node, completed_move));
+            children.nodes[0].value = completed_value;
+        }
+
+        m_stop_flag = previous_stop_flag;
+        m_deadline = previous_deadline;
+
         #if MINIMAX_STATISTICS
-            output("Move %d: %I64u nodes evaluated, %I64u moves applied, %I64u minimax calls, %I64u beta cutoffs\n",
-                   m_move_counter + 1, g_evaluated_nodes, g_moves_applied, g_minimax_calls, g_beta_cutoffs);
+            output("Move %d: %I64u nodes evaluated, %I64u moves applied, %I64u minimax calls, %I64u beta cutoffs, %I64u re-searches\n",
+                   m_move_counter + 1, g_evaluated_nodes, g_moves_applied, g_minimax_calls, g_beta_cutoffs, g_pvs_researches);
             g_total_evaluated_nodes += g_evaluated_nodes;
             g_total_beta_cutoffs += g_beta_cutoffs;
-            g_evaluated_nodes = g_moves_applied = g_minimax_calls = g_beta_cutoffs = 0;
+            g_evaluated_nodes = g_moves_applied = g_minimax_calls = g_beta_cutoffs = g_pvs_researches = 0;
         #endif
 
-        *ret_move = children[0].move;
-        return m_current_node->value = children[0].resulting_node->value;
+        *ret_move = children.moves[0];
+        return m_current_node->value = children.nodes[0].value;
     }
 
 #endif  // MAXIMIZE_VICTORY
@@ -629,14 +2635,15 @@ void GameState::dump_tree(int depth, GameNode* node, int indentation) const
 
         if (depth > 0)
         {
+            const ChildList children = children_of(node);
             output(". %d moves available:\n", node->child_count);
             for (int n = 0; n < node->child_count; ++n)
             {
                 for (int i = 0; i < indentation + 3; ++i) output(" ");
                 char move_string[MAX_MOVE_STRING_SIZE];
-                write_move(node->continuations[n].move, sizeof move_string, move_string);
+                write_move(children.moves[n], sizeof move_string, move_string);
                 output("%s: ", move_string);
-                dump_tree(depth - 1, node->continuations[n].resulting_node, indentation + 3);
+                dump_tree(depth - 1, &children.nodes[n], indentation + 3);
             }
         }
         else
@@ -656,6 +2663,9 @@ void GameState::output(__in __format_string PCSTR pFormat, ...) const
 
     TRACE(INFO, "%s", message);
 
+    // Pondering searches run silently, while the opponent is thinking
+    if (m_thinker != NULL) return;
+
     printf("%s", message);
 
     if (m_output_buffer != NULL)
@@ -40,6 +40,16 @@ typedef int Value;  // Note: this limits us to two-player games
 
 #define INVALID_VALUE (int(-1) >> 1)  // Maximum positive int; used for uninitialized or ignored values
 
+// How a search result relates to the true value of a position.  Bounds are
+// from the point of view of the player to move in the position.
+enum ValueBound
+{
+    eNoBound,     // No result (e.g. an empty transposition table entry)
+    eExact,       // The result is the position's value at the depth searched
+    eLowerBound,  // The position is worth at least the result (the search failed high)
+    eUpperBound   // The position is worth at most the result (the search failed low)
+};
+
 
 // A type used for both players and cell states, interchangeably.  Preferably
 // it would be an enum, but they are word-sized and we need a byte-sized type.
@@ -52,6 +62,61 @@ typedef int GameMove;
 #define INVALID_MOVE GameMove(0)
 #define PASSING_MOVE GameMove(-1)
 
+// A list of moves, as filled in by get_possible_moves() and
+// generate_tactical_moves().  The moves are stored in the object itself, so
+// lists live on the caller's stack and generating moves never touches the
+// heap.  MAX_POSSIBLE_MOVES must cover the most moves any game can list in
+// one position; each game checks the bound given by its board dimensions.
+class MoveList
+{
+public:
+
+    MoveList() : m_count(0) {}
+
+    void add(GameMove move) {ASSERT(m_count < MAX_POSSIBLE_MOVES); m_moves[m_count++] = move;}
+    void remove(int n) {ASSERT(n >= 0 && n < m_count); m_moves[n] = m_moves[--m_count];}  // The last move fills the gap
+    void truncate(int count) {ASSERT(count >= 0 && count <= m_count); m_count = count;}
+
+    int count() const {return m_count;}
+    GameMove operator[](int n) const {ASSERT(n >= 0 && n < m_count); return m_moves[n];}
+    GameMove& operator[](int n) {ASSERT(n >= 0 && n < m_count); return m_moves[n];}
+
+private:
+
+    int m_count;
+    GameMove m_moves[MAX_POSSIBLE_MOVES];
+
+    // Prevent copying
+    MoveList(const MoveList&);
+    MoveList& operator=(const MoveList&);
+};
+
+// A 64-bit Zobrist hash identifying a game position (including the player to
+// move).  Games that don't support hashing return 0 from position_hash().
+typedef unsigned __int64 PositionHash;
+
+// Fills a block of PositionHash keys with reproducible pseudo-random values
+// derived from 'seed'.  Returns the number of keys generated; intended to be
+// used in static initializers (as with register_game() below).
+int generate_zobrist_keys(__out_bcount(bytes) void* keys, size_t bytes, PositionHash seed);
+
+// Board symmetries, for games whose positions are equivalent to their
+// reflections and rotations (see GameState::canonical_hash()).  Symmetry s
+// maps the cell (x, y) of a board 'width' cells by 'height', counting from 0,
+// by swapping x and y if s & 4 (square boards only), then reversing x if
+// s & 1 and y if s & 2; symmetry 0 leaves the board alone.  transform_cell()
+// applies a symmetry, or undoes it if 'inverse'.
+#define BOARD_SYMMETRIES 8
+void transform_cell(int symmetry, bool inverse, int width, int height, __inout int* x, __inout int* y);
+
+// Helps implement canonical_hash(): returns the least of the hashes of a
+// position's symmetric images, each XORed with the key of the player to move,
+// and sets 'symmetry' to its index.  Only the symmetries whose bits are set
+// in 'symmetries' (which must include bit 0) count, and 'hashes' need only
+// extend to the last of them.
+PositionHash least_symmetric_hash(__in const PositionHash* hashes, unsigned symmetries,
+                                  PositionHash player_key, __out int* symmetry);
+
 // FIXME: static consts are preferred, but I'm not convinced they're as fast
 // (But measure the perf impact of these things; intelligible code matters
 // more than a 1% perf improvement!)
@@ -75,6 +140,26 @@ extern int g_current_search_depth;
     extern unsigned __int64 g_moves_applied;
     extern unsigned __int64 g_evaluated_nodes;
     extern unsigned __int64 g_beta_cutoffs;
+    extern unsigned __int64 g_pvs_researches;
+    extern unsigned __int64 g_mtdf_passes;
+    extern unsigned __int64 g_aspiration_fails_low;
+    extern unsigned __int64 g_aspiration_fails_high;
+    extern unsigned __int64 g_killer_cutoffs;
+    extern unsigned __int64 g_quiescence_nodes;
+    extern unsigned __int64 g_quiescence_moves;
+    extern unsigned __int64 g_quiescence_cutoffs;
+    extern unsigned __int64 g_quiescence_depth_limits;
+    extern unsigned __int64 g_null_move_cutoffs;
+    extern unsigned __int64 g_futility_prunes;
+    extern unsigned __int64 g_razoring_prunes;
+    extern unsigned __int64 g_late_move_reductions;
+    extern unsigned __int64 g_late_move_researches;
+    extern unsigned __int64 g_endgame_solves;
+    extern unsigned __int64 g_endgame_nodes;
+    extern unsigned __int64 g_move_lists;
+    extern unsigned __int64 g_move_list_allocations;
+    extern unsigned __int64 g_tree_bytes_kept;
+    extern unsigned __int64 g_tree_bytes_discarded;
     extern unsigned __int64 g_total_evaluated_nodes;
     extern unsigned __int64 g_total_beta_cutoffs;
 #endif
@@ -96,35 +181,36 @@ extern int g_num_games;
 int register_game(const char* name, GameCreator* );
 
 
-// REMOVE: Inappropriate solution to the memory management overhead problem.
-// Slower than the MSVC library heap manager, and it would be better to make
-// the millions of allocations unnecessary in the first place.
-#if USE_GAMENODE_HEAP
-    #define USING_GAMENODE_HEAP() \
-        FORCEINLINE __bcount(bytes) void* operator new(size_t bytes) \
-        { \
-            ASSERT(VALID_HANDLE(g_gamenode_heap)); \
-            void* pointer = HeapAlloc(g_gamenode_heap, 0, bytes); \
-            VERIFY_PTR(pointer); \
-            ++g_allocations; \
-            return pointer; \
-        } \
-        FORCEINLINE void operator delete(__in void* pointer) \
-        { \
-            ASSERT(VALID_HANDLE(g_gamenode_heap)); \
-            --g_allocations; \
-            VERIFY_TRUE(HeapFree(g_gamenode_heap, 0, pointer)); \
-        }
-#else
-    #define USING_GAMENODE_HEAP()
-#endif
+// Defined in transposition.h
+class TranspositionTable;
+
+// Defined in ordering.h
+class MoveOrdering;
+
+// Defined in smp.h
+class SearchHelper;
+class SplitWorker;
+class SplitWorkerPool;
+
+// Defined in thinker.h
+class Thinker;
+
+// Defined in mcts.h
+class MonteCarloSearch;
+
+// Defined in book.h
+class OpeningBook;
+class BookEntryList;
+
+// Defined in arena.h
+class NodeArena;
 
 
 class GameState
 {
 public:  // Used by frontend.cpp
 
-    virtual ~GameState() {}
+    virtual ~GameState();
 
     // Implemented or overriden by derived classes
     virtual Result set_initial_position(size_t n, __in_bcount(n) const char*) {UNREFERENCED_PARAMETER(n); return Result::Fail;}
@@ -163,38 +249,220 @@ public:  // Used by frontend.cpp
     PlayerCode player_up() const {return m_player_up;}
     void set_player_up(PlayerCode p) {m_player_up = p;}
     void switch_player_up() {m_player_up = !m_player_up;}
-    Value analyze(int target_depth, int max_analysis_time, __out GameMove* ret_move,
+    void new_game();  // reset(), keeping search results that still apply
+    Value analyze(int target_depth, int max_analysis_ms, __out GameMove* ret_move,
                   Value lower_bound =INVALID_VALUE, Value upper_bound =INVALID_VALUE);
     #if MAXIMIZE_VICTORY
-        Value maximize_victory(__out GameMove* ret_move);
+        Value maximize_victory(int max_analysis_ms, __out GameMove* ret_move);
     #endif
     Result perform_move(GameMove);
     void revert_move();
+
+    // fixed_depth_search(): Searches the current position 'depth' plies deep
+    // with plain alpha-beta and no game tree (see searcher.h).  Returns its
+    // value from player 0's point of view, with the best move in 'best_move'
+    // and the number of positions visited in 'nodes'.  Games override this to
+    // run a Searcher bound to their own class; the default reaches their
+    // functions virtually.
+    virtual Value fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes);
+
+    // Pondering: searching on the opponent's time.  start_pondering() starts a
+    // Thinker thread (see thinker.h) that searches this game's own tree until
+    // stop_pondering() is called, so the game must not be used in any other way
+    // in between.  A reply that the search predicted is a "ponder hit": the
+    // next analyze() finds much of its work already done.
+    Result start_pondering(int target_depth);
+    void stop_pondering();
+    int ponder_predictions() const {return m_ponder_predictions;}
+    int ponder_hits() const {return m_ponder_hits;}
+
+    // expected_moves_left(): Returns about how many more moves the player to
+    // move will make before the game ends, for dividing a game's time between
+    // them (see timing.h).  Games that can't tell assume TIME_MOVES_TO_GO.
+    virtual int expected_moves_left() const {return TIME_MOVES_TO_GO;}
+
+    // build_endgame_database(): Computes the game's endgame database, if it
+    // has one, and saves it to disk for later games to use, using up to
+    // 'threads' threads.  Games without one return Result::Fail.
+    virtual Result build_endgame_database(int threads) {UNREFERENCED_PARAMETER(threads); return Result::Fail;}
+
+    // Opening books (see book.h); each of these must be called in the starting
+    // position.  set_opening_book() has analyze() play the book's moves, for as
+    // long as it has the position, instead of searching.
+    // build_opening_book() adds the positions within 'plies' of the start to a
+    // book file (creating it if need be), searching each of their moves with
+    // analyze(): moves valued within BOOK_MARGIN of the best are entered, and
+    // followed.  Positions the book already has to 'depth' aren't searched again.
+    // merge_opening_book() adds another book file's entries to a book file.
+    Result set_opening_book(const char* file_name);
+    Result build_opening_book(const char* file_name, int plies, int depth, int maximum_analysis_ms);
+    Result merge_opening_book(const char* file_name, const char* other_file_name);
+
+    // Checkpoints: the transposition table can be saved to a file and loaded by
+    // a later run, so that a long analysis can be resumed.  resume_search()
+    // must be called in the starting position, which the file records; it
+    // loads the file if it was saved from the same game and start, and has
+    // checkpoint_search() save to it from then on.  (Until resume_search() is
+    // called, checkpoint_search() does nothing.)  Saves are at least
+    // CHECKPOINT_INTERVAL_S seconds apart unless 'now' is set, as it should
+    // be for the last one.
+    Result resume_search(const char* file_name);
+    Result checkpoint_search(bool now =false);
+
     void set_output_buffer(char* buffer, CRITICAL_SECTION* buffer_access_protector)
     {
         m_output_buffer = buffer;
         m_output_buffer_protector = buffer_access_protector;
     }
 
+    // Number of threads used by analyze(), and how they divide the work; see smp.h
+    enum ParallelSearch
+    {
+        eLazySmp,       // Helper threads search the whole tree, sharing results via the transposition table
+        eSplitPoints    // Young Brothers Wait: threads share out the children of nodes within the tree
+    };
+    int search_threads() const {return m_search_threads;}
+    void set_search_threads(int n) {m_search_threads = max(1, min(n, MAX_SEARCH_THREADS));}
+    ParallelSearch parallel_search() const {return m_parallel_search;}
+    void set_parallel_search(ParallelSearch p) {m_parallel_search = p;}
+
+    // How analyze() searches the root position at each depth
+    enum SearchDriver
+    {
+        eFullWindow,    // One Principal Variation Search with the requested bounds
+        eMtdf,          // MTD(f): a series of zero-window searches converging on the value
+        eMonteCarlo     // Monte Carlo Tree Search in place of minimax (see mcts.h); ignores the depth and bounds
+    };
+    SearchDriver search_driver() const {return m_search_driver;}
+    void set_search_driver(SearchDriver d) {m_search_driver = d;}
+
 protected:  // Used by derived classes only
 
-    GameState() : m_initial_node(NULL), m_current_node(NULL), m_output_buffer(NULL), m_output_buffer_protector(NULL) {}
+    GameState() : m_initial_node(NULL), m_current_node(NULL), m_node_arena(NULL), m_spare_node_arena(NULL), m_output_buffer(NULL), m_output_buffer_protector(NULL),
+                  m_transposition_table(NULL), m_move_ordering(NULL), m_search_threads(SEARCH_THREADS), m_parallel_search(eLazySmp), m_search_driver(eFullWindow),
+                  m_stop_flag(NULL), m_out_of_time(0), m_deadline(0), m_deadline_countdown(0),
+                  m_split_workers(NULL), m_split_point(NULL), m_null_move_node(NULL),
+                  m_thinker(NULL), m_predicted_move(INVALID_MOVE), m_ponder_predictions(0), m_ponder_hits(0), m_monte_carlo(NULL),
+                  m_opening_book(NULL), m_building_book(false), m_checkpoint_key(0), m_last_checkpoint(0) {*m_checkpoint_file = 0;}
+    GameState(const GameState&);  // Copies the position only; see clone()
 
     enum GameAttributes  // Aspects of interest to the frontend or the engine
     {
         eNone = 0x0,     // Absence of traits
         eGreedy = 0x1,   // Try to win by a devastating margin
+        eVolatile = 0x2, // Leaf values may be misleading; search tactical moves further (see is_quiet())
+        eNullMovePruning = 0x4,  // Prune positions so good that even passing would be enough
+        eFutilityPruning = 0x8,  // Skip moves near the leaves that look too poor to matter (see futility_margins())
+        eRazoring = 0x10,        // Cut short searches near the leaves that look hopeless (see razoring_margins())
         eAttributeCount
     };
     virtual GameAttributes game_attributes() const {return eNone;}
 
-    virtual GameMove* get_possible_moves() const =0;
+    // aspiration_window(): Returns the half-width of the window analyze() centres
+    // on the previous iteration's value at each depth; it should be about how
+    // much the value typically changes from one depth to the next.  Zero (the
+    // default) searches each depth with the full window.
+    virtual Value aspiration_window() const {return ASPIRATION_WINDOW;}
+
+    // get_possible_moves(): Adds the moves the player to move may be able to
+    // make to 'moves'.  Moves that apply_move() rejects are allowed (they are
+    // skipped), so games may list candidates that are cheap to find.
+    virtual void get_possible_moves(__out MoveList* moves) const =0;
     virtual Result apply_move(GameMove) =0;
     virtual Result apply_passing_move() {return Result::Fail;}  // No passing by default
     virtual void undo_last_move() =0;
     virtual Value position_val() const =0;
     virtual Value game_over_val() const {return position_val();}  // Value of the position if the game has ended (FIXME: explain better)
 
+    // evaluate_moves(): Lists the legal moves in the current position (or just
+    // PASSING_MOVE, if the player to move must pass) in 'moves', with the
+    // position_val() of the position each leads to in 'values'.  Returns how
+    // many there are (0 if the game is over).  generate_move_list() calls it
+    // at every node it expands; games override it, like fixed_depth_search(),
+    // to run a Searcher bound to their own class.
+    virtual int evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values);
+
+    // position_hash(): Returns a Zobrist hash of the current position, which
+    // derived classes should maintain incrementally in apply_move() and
+    // undo_last_move().  Positions with equal hashes must have equal values
+    // and equal move lists.  The default of 0 disables transposition lookups.
+    virtual PositionHash position_hash() const {return 0;}
+
+    // canonical_hash(), transform_move(): Used by games whose positions are
+    // equivalent to some of their reflections or rotations, so that the
+    // transposition table, opening books and endgame tables can share one
+    // entry between them.  canonical_hash() returns the least of the hashes of
+    // the current position's equivalent images (including itself), and sets
+    // 'symmetry' to the one that maps the current position to that image.
+    // transform_move() maps a move in the current position to the same move
+    // in its image under 'symmetry', or back again if 'inverse'.  By default
+    // positions have no equivalents but themselves.
+    virtual PositionHash canonical_hash(__out int* symmetry) const {*symmetry = 0; return position_hash();}
+    virtual GameMove transform_move(GameMove move, int symmetry, bool inverse) const
+    {
+        UNREFERENCED_PARAMETER(symmetry); UNREFERENCED_PARAMETER(inverse); return move;
+    }
+
+    // move_index(): Numbers the game's moves densely from 0 to move_index_count()-1,
+    // for indexing the history heuristic table (see ordering.h); the same
+    // number may serve both players.  Returns -1 for moves without a number
+    // (such as passes).  The default count of 0 disables the history heuristic.
+    virtual int move_index_count() const {return 0;}
+    virtual int move_index(GameMove) const {return -1;}
+
+    // is_quiet(), generate_tactical_moves(): Used by the quiescence search in
+    // games with the eVolatile attribute.  is_quiet() returns whether
+    // position_val() can be trusted in the current position, i.e. whether the
+    // player to move has no moves that would change it drastically (captures,
+    // say).  If it can't, generate_tactical_moves() adds those moves to
+    // 'moves', as get_possible_moves() does.
+    virtual bool is_quiet() const {return true;}
+    virtual void generate_tactical_moves(__out MoveList* moves) const {UNREFERENCED_PARAMETER(moves);}
+
+    // futility_margins(), razoring_margins(): Used by the forward pruning
+    // enabled by eFutilityPruning and eRazoring.  Each returns a table of
+    // FORWARD_PRUNING_DEPTHS values, indexed by the search depth remaining,
+    // giving how far a search of that depth may plausibly raise a position's
+    // value above its immediate value.  Searches that look unable to reach
+    // alpha even with that much help are skipped.
+    virtual const Value* futility_margins() const {return NULL;}
+    virtual const Value* razoring_margins() const {return NULL;}
+
+    // late_move_reductions(): Returns a table of LMR_TABLE_SIZE entries, indexed
+    // by a move's position in its (sorted) move list, giving how many plies
+    // less deeply it is searched; moves beyond the end of the table use the
+    // last entry.  A reduced move that turns out better than alpha is searched
+    // again at full depth.  The default of NULL disables reductions.
+    virtual const BYTE* late_move_reductions() const {return NULL;}
+
+    // solved_position(): Used by games that can look up perfect play from the
+    // current position in a precomputed table.  Returns the best move and the
+    // position's value (from player 0's point of view, as analyze() does), or
+    // false to have analyze() search as usual.
+    virtual bool solved_position(__out GameMove*, __out Value*) const {return false;}
+
+    // endgame_solvable(), solve_endgame(): Used by games that can find the exact
+    // value of positions near the end of the game much faster than a search
+    // of the game tree would.  endgame_solvable() returns whether to solve the
+    // current position with 'depth' plies of search remaining; a position
+    // that analyze() is asked about is offered with FULLY_ANALYZED, and if it
+    // is accepted, analyze() searches its moves to FULLY_ANALYZED-1 after the
+    // first ENDGAME_PRELUDE_DEPTH iterations.
+    // solve_endgame() returns the value, in the terms of game_over_val() but
+    // from the point of view of the player to move, if it lies strictly
+    // between alpha and beta; otherwise any bound on it no greater than alpha
+    // or no less than beta.  Long solves should call solver_interrupted() now
+    // and then, and return at once (with any value) when it returns true.
+    virtual bool endgame_solvable(int) const {return false;}
+    virtual Value solve_endgame(Value, Value) {return 0;}
+    bool solver_interrupted() {check_deadline(); return search_aborted();}
+
+    // clone(): Returns a copy of the game in its current position, without the
+    // game tree, for use by parallel search threads.  Derived classes can
+    // usually implement this with their copy constructor.  The default of NULL
+    // restricts analyze() to a single thread.
+    virtual GameState* clone() const {return NULL;}
+
     FORCEINLINE int move_counter() const {return m_move_counter;}
     FORCEINLINE void advance_move_counter() {++m_move_counter;}
     FORCEINLINE void retreat_move_counter() {--m_move_counter;}
@@ -221,54 +489,178 @@ private:
     char* m_output_buffer;
     CRITICAL_SECTION* m_output_buffer_protector;
 
-    #define FULLY_ANALYZED 1000000  // Assuming no games can be 1e6 moves long
+    #define FULLY_ANALYZED 0x7fff  // The greatest depth a GameNode can record; assuming no games can be this long
 
+    // Nodes and their child lists are allocated from the game's NodeArena (see
+    // new_node() and new_children()), and are never freed individually.  Nodes
+    // are kept small, so that more of the tree fits in the cache: a node finds
+    // its children by a 32-bit arena index rather than a pointer, and its
+    // depth, child count and bound share one 32-bit word.
     struct GameNode
     {
-        Value value;         // Minimum value of this position for the player due to move
-        int explored_depth;  // Depth of the analysis performed on this position so far
-                             // (or FULLY_ANALYZED if already exhaustively searched)
-        int child_count;     // Number of moves available in this position
-
-        // Possible continuations of the game from this position, sorted by their
-        // estimated value to the player to move.
-        struct Child
-        {
-            GameMove move;
-            GameNode* resulting_node;
-            USING_GAMENODE_HEAP();
-        } *continuations;
+        Value value;                // Value of this position (positive favours player 0)
+        UINT32 children;            // Arena index of the child list, if child_count > 0 (see children_of())
+        short explored_depth;       // Depth of the analysis performed on this position so far
+                                    // (or FULLY_ANALYZED if already exhaustively searched)
+        short child_count : 14;     // Number of moves available in this position (-1 until generated)
+        unsigned short bound : 2;   // A ValueBound: whether 'value' is exact or only a bound
+
+        GameNode(Value v) : value(v), children(0), explored_depth(-1), child_count(-1), bound(eExact) {}
+    };
 
-        GameNode(Value v) : value(v), explored_depth(-1), child_count(-1), continuations(NULL) {}
-        ~GameNode() {delete[] continuations;}
+    // Possible continuations of the game from a position, sorted by their
+    // estimated value to the player to move: the child nodes themselves, and
+    // the moves leading to them in a parallel array.  Both are in one block,
+    // the moves after the nodes, so that scanning the children's values or
+    // their moves reads contiguous memory.  Reordering a list moves the nodes
+    // themselves, so a pointer to a child is only good until then.
+    struct ChildList
+    {
+        GameNode* nodes;
+        GameMove* moves;
+    };
 
-        USING_GAMENODE_HEAP();
+    // A node whose remaining children are being searched by several threads
+    // at once (see split())
+    struct SplitPoint
+    {
+        CRITICAL_SECTION lock;  // Protects the fields below it
+        GameNode* node;
+        int depth;
+        Value beta;
+        SplitPoint* parent;     // Split point the owning thread was itself working for, if any
+        volatile LONG cutoff;   // Set on a beta cutoff; abandons searches of the other children
+        volatile LONG active_workers;
+
+        int next_child;         // Index of the next child to be searched
+        int best_child;         // Index of the best child found so far and its value
+        Value best_value;
+        Value alpha;            // Lower edge of the search window, raised as children are searched
+        int explored_depth;     // Node's explored depth, considering the children searched so far
+
+        bool aborted() const
+        {
+            for (const SplitPoint* split = this; split != NULL; split = split->parent)
+                if (split->cutoff) return true;
+            return false;
+        }
     };
 
     GameNode* m_initial_node;  // Top-level node; beginning of the game
     GameNode* m_current_node;  // Points to the current game state
+    NodeArena* m_node_arena;        // Holds the game tree (shared with clones)
+    NodeArena* m_spare_node_arena;  // Empty; the tree is copied here by compact_tree()
+
+    TranspositionTable* m_transposition_table;  // Shares results between transposed positions
+                                                // (and between threads; not owned by clones)
+    MoveOrdering* m_move_ordering;              // Killer moves and history (likewise shared)
+
+    int m_search_threads;               // Threads to use in analyze(), including this one
+    ParallelSearch m_parallel_search;
+    SearchDriver m_search_driver;
+    const volatile LONG* m_stop_flag;   // If set, abandon the search when this becomes nonzero
+    volatile LONG m_out_of_time;        // Stop flag for analyze()'s own deadline
+    UINT64 m_deadline;                  // Performance counter value at which the stop flag is set (0 = none; clones share it)
+    int m_deadline_countdown;           // negamax() calls until the clock is next checked
+    SplitWorkerPool* m_split_workers;   // Threads available for split points (not owned by clones)
+    SplitPoint* m_split_point;          // Split point this thread is currently working for, if any
+    GameNode* m_null_move_node;         // Position reached by the null move being searched, if any
+    friend class SearchHelper;
+    friend class SplitWorker;
+
+    Thinker* m_thinker;                 // Pondering thread, while the opponent is to move
+    GameMove m_predicted_move;          // Opponent's move the last ponder search assumed
+    int m_ponder_predictions;
+    int m_ponder_hits;
+    void ponder(int target_depth, const volatile LONG* stop_flag);
+    friend class Thinker;
+
+    MonteCarloSearch* m_monte_carlo;    // Created by the first eMonteCarlo analysis
+    friend class MonteCarloSearch;
+    friend class MonteCarloWorker;
+
+    template <class Game> friend class Searcher;  // Calls the game's functions directly
+
+    OpeningBook* m_opening_book;        // Consulted by analyze() before searching (not shared with clones)
+    bool m_building_book;               // Set by build_opening_book(), whose analyze() calls needn't maximize wins
+
+    char m_checkpoint_file[MAX_PATH];   // Where checkpoint_search() saves the transposition table (empty if nowhere)
+    PositionHash m_checkpoint_key;      // Starting position of the game it is saved for
+    UINT64 m_last_checkpoint;           // Performance counter value at the last save (or at resume_search())
+
+    // Identifies the game and starting position to opening books and checkpoints
+    PositionHash starting_position_key() const;
+    bool probe_opening_book(__out GameMove* ret_move, __out Value* value);
+    Result add_book_moves(__inout BookEntryList* entries, const BookEntryList& existing, int plies, int depth,
+                          int maximum_analysis_ms, __inout UINT64* positions);
 
     FORCEINLINE Value max_val() const {return m_player_up == 0 ? LIMIT_VALUE : -LIMIT_VALUE;}  // An impossibly high value for the player to move
     FORCEINLINE Value min_val() const {return m_player_up == 0 ? -LIMIT_VALUE : LIMIT_VALUE;}  // An impossibly low value for the player to move
-    FORCEINLINE bool better(Value v1, Value v2) const {return m_player_up == 0 ? (v1 > v2) : (v1 < v2);}
-    FORCEINLINE bool worse(Value v1, Value v2) const {return m_player_up == 1 ? (v1 > v2) : (v1 < v2);}
-    FORCEINLINE bool better_or_equal(Value v1, Value v2) const {return !worse(v1, v2);}
-    FORCEINLINE bool worse_or_equal(Value v1, Value v2) const {return !better(v1, v2);}
+    FORCEINLINE Value side_sign() const {return m_player_up == 0 ? 1 : -1;}  // Converts values to and from the player to move's point of view
     FORCEINLINE bool is_victory(Value v) const {return m_player_up == 0 ? (v >= VICTORY_VALUE) : (v <= -VICTORY_VALUE);}
     FORCEINLINE bool is_defeat(Value v) const {return m_player_up == 1 ? (v >= VICTORY_VALUE) : (v <= -VICTORY_VALUE);}
 
-    FORCEINLINE void adjust_node_position(GameNode::Child* list, int list_length);
+    FORCEINLINE static void move_child(ChildList list, int from, int to);
+    FORCEINLINE void adjust_node_position(ChildList list, int list_length);
     FORCEINLINE void generate_move_list(GameNode* node);
+    FORCEINLINE bool promote_move(GameNode* node, GameMove move);
+    FORCEINLINE void order_new_children(ChildList list, int count);
+    FORCEINLINE void record_cutoff(GameMove move, int depth);
+    FORCEINLINE int late_move_reduction(int depth, int n, GameMove move) const;
 
-    Value minimax(int depth, GameNode* node, Value floor, Value ceiling);
+    FORCEINLINE void check_deadline()
+    {
+        if (m_deadline != 0 && --m_deadline_countdown <= 0)
+        {
+            m_deadline_countdown = DEADLINE_POLL_INTERVAL;
+            if (GetPerfCounter() >= m_deadline) abandon_search();
+        }
+    }
 
-    void prune_tree(GameNode* node)
+    FORCEINLINE bool search_aborted() const
     {
-        for (int n = 0; n < node->child_count; ++n)
-            prune_tree(node->continuations[n].resulting_node);
-        delete node;
+        return (m_stop_flag != NULL && *m_stop_flag != 0) || (m_split_point != NULL && m_split_point->aborted());
     }
 
+    void abandon_search();
+
+    Value search_root(int depth, Value lower_bound, Value upper_bound, __out bool* fully_analyzed);
+    Value search_root_mtdf(int depth, Value lower_bound, Value upper_bound, __out bool* fully_analyzed);
+    Value search_root_aspiration(int depth, Value lower_bound, Value upper_bound, __out bool* fully_analyzed);
+    Value negamax(int depth, GameNode* node, Value alpha, Value beta);
+    FORCEINLINE Value search_child(int depth, GameMove move, GameNode* child, Value alpha, Value beta, bool scout, int reduction = 0);
+    Value quiesce(Value alpha, Value beta, int depth);
+    bool prune_node(int depth, GameNode* node, Value alpha, Value beta, __out Value* value);
+
+    // Whether a stored result with the given bound settles a search with this window
+    FORCEINLINE static bool result_suffices(int bound, Value value, Value alpha, Value beta)
+    {
+        return bound == eExact || (bound == eLowerBound && value >= beta) || (bound == eUpperBound && value <= alpha);
+    }
+
+    // Support for search threads
+    GameState* clone_for_search() const;
+    static void delete_clone(GameState* copy);
+
+    // Lazy SMP support
+    int start_helpers(int target_depth, Value lower_bound, Value upper_bound, const volatile LONG* main_depth,
+                      __out_ecount(MAX_SEARCH_THREADS) SearchHelper** helpers);
+    void stop_helpers(int helper_count, __inout_ecount(helper_count) SearchHelper** helpers);
+    void helper_search(int helper_index, int target_depth, Value lower_bound, Value upper_bound, const volatile LONG* main_depth);
+
+    // Young Brothers Wait support
+    void prepare_split_workers();
+    FORCEINLINE bool can_split(const GameNode* node, int depth) const;
+    bool split(GameNode* node, int depth, Value alpha, Value beta);
+    void search_split_point(SplitPoint* split);
+
+    // Game tree memory management
+    FORCEINLINE GameNode* new_node(Value value);
+    FORCEINLINE GameNode* new_children(int count, __out UINT32* index);
+    FORCEINLINE ChildList children_of(const GameNode* node) const;
+    void copy_children(const NodeArena& from, __inout GameNode* node, __inout GameNode** current_node);
+    void compact_tree();
+
     // For debugging
     public: void dump_tree(int depth =3, GameNode* node =NULL, int indentation =0) const;
 };
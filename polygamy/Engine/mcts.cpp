@@ -0,0 +1,366 @@
+// mcts.cpp
+
+#include "shared.h"  // Precompiled header; obligatory
+#include "mcts.h"    // Our public interface
+#include <math.h>    // For logf(), sqrtf()
+
+
+Result MonteCarloSearch::allocate(int node_count)
+{
+    TRACE_VOID_METHOD();
+
+    delete[] m_nodes;
+    m_nodes = NULL;
+    m_pool_size = 0;
+
+    // At least room for the root and a full move list
+    if (node_count < 0x10000) return Result::Fail;
+
+    m_nodes = new Node[node_count];
+    if (m_nodes == NULL) return Result::Fail;
+    m_pool_size = node_count;
+
+    return Result::OK;
+}
+
+
+void MonteCarloSearch::init_node(UINT32 index, GameMove move, PlayerCode player)
+{
+    Node& node = m_nodes[index];
+    node.move = move;
+    node.first_child = 0;
+    node.visits = 0;
+    node.wins = 0;
+    node.child_count = 0;
+    node.player = BYTE(player);
+    node.state = eUnexpanded;
+}
+
+
+//
+// Adds the children of a node, whose position the game must be in, once this
+// thread has claimed it.  Returns false if another thread has claimed it, or
+// if the pool has no room for its children, in which case it is left a leaf
+// for good (eNoRoom).
+//
+
+bool MonteCarloSearch::expand(GameState* game, UINT32 index)
+{
+    Node& node = m_nodes[index];
+    if (InterlockedCompareExchange(&node.state, eExpanding, eUnexpanded) != eUnexpanded) return false;
+
+    const PlayerCode player = game->player_up();
+    MoveList possible_moves;
+    game->get_possible_moves(&possible_moves);
+    int child_count = 0;
+
+    // Legal moves are gathered at the front of the list
+    for (int n = 0; n < possible_moves.count(); ++n)
+    {
+        if (game->apply_move(possible_moves[n]).ok())
+        {
+            game->undo_last_move();
+            possible_moves[child_count++] = possible_moves[n];
+        }
+    }
+    possible_moves.truncate(child_count);
+
+    if (child_count == 0)
+    {
+        if (game->apply_passing_move().failed())
+        {
+            InterlockedExchange(&node.state, eTerminal);
+            return true;
+        }
+        game->undo_last_move();
+        possible_moves.add(PASSING_MOVE);
+        ++child_count;
+    }
+
+    // Claim room for the children, never taking the pool past its end.  (The
+    // comparison is made against the room left, so it can't overflow.)
+    UINT32 first_child;
+    for (;;)
+    {
+        const LONG used = m_nodes_used;
+        first_child = UINT32(used);
+        if (UINT32(child_count) > m_pool_size - first_child)
+        {
+            InterlockedExchange(&node.state, eNoRoom);
+            return false;
+        }
+        if (InterlockedCompareExchange(&m_nodes_used, used + LONG(child_count), used) == used) break;
+    }
+
+    for (int n = 0; n < child_count; ++n)
+    {
+        init_node(first_child + n, possible_moves[n], player);
+    }
+
+    node.first_child = first_child;
+    node.child_count = WORD(child_count);
+    InterlockedExchange(&node.state, eExpanded);  // (A full barrier: publishes the children)
+
+    return true;
+}
+
+
+//
+// UCT: picks the child maximizing its winning rate plus an allowance for the
+// uncertainty of that rate, which grows slowly with the parent's visits and
+// shrinks with the child's own.  Unvisited children are tried first.
+//
+
+UINT32 MonteCarloSearch::select_child(const Node& node) const
+{
+    ASSERT(node.state == eExpanded && node.child_count > 0);
+
+    const UINT32 end = node.first_child + node.child_count;
+    for (UINT32 index = node.first_child; index < end; ++index)
+    {
+        if (m_nodes[index].visits == 0) return index;
+    }
+
+    const float log_visits = logf(float(node.visits));
+    UINT32 best_index = node.first_child;
+    float best_bound = -1;
+
+    for (UINT32 index = node.first_child; index < end; ++index)
+    {
+        const Node& child = m_nodes[index];
+        const float visits = float(child.visits);
+        const float bound = child.wins / (2 * visits) + float(MCTS_EXPLORATION) * sqrtf(log_visits / visits);
+        if (bound > best_bound)
+        {
+            best_bound = bound;
+            best_index = index;
+        }
+    }
+
+    return best_index;
+}
+
+
+//
+// Plays random moves from the current position until the game ends or
+// MCTS_PLAYOUT_LIMIT moves have been made, then takes them all back.  Returns
+// the result as a score for player 0.
+//
+
+LONG MonteCarloSearch::playout(GameState* game, XorShiftRandom* random)
+{
+    int moves_made = 0;
+    bool game_over = false;
+
+    while (moves_made < MCTS_PLAYOUT_LIMIT)
+    {
+        // Try the possible moves in random order until one turns out legal
+        MoveList possible_moves;
+        game->get_possible_moves(&possible_moves);
+
+        bool moved = false;
+        while (possible_moves.count() > 0)
+        {
+            const int n = int(random->below(UINT32(possible_moves.count())));
+            if (game->apply_move(possible_moves[n]).ok())
+            {
+                moved = true;
+                break;
+            }
+            possible_moves.remove(n);
+        }
+
+        if (!moved && game->apply_passing_move().failed())
+        {
+            game_over = true;
+            break;
+        }
+        ++moves_made;
+    }
+
+    const Value value = game_over ? game->game_over_val() : game->position_val();
+
+    while (moves_made-- > 0)
+    {
+        game->undo_last_move();
+    }
+
+    return score(value);
+}
+
+
+//
+// One iteration of the search, on a game in the root position
+//
+
+void MonteCarloSearch::iterate(GameState* game, XorShiftRandom* random)
+{
+    UINT32 path[MCTS_MAX_TREE_DEPTH + 1];
+    path[0] = 0;
+    InterlockedExchangeAdd(&m_nodes[0].visits, MCTS_VIRTUAL_LOSS);
+
+    // Selection: follow the tree down to a node visited for the first time.
+    // A leaf is only expanded on its second visit, so that the pool isn't
+    // spent on the many nodes that are never visited again.
+    int depth = 0;
+    UINT32 index = 0;
+    while (depth < MCTS_MAX_TREE_DEPTH)
+    {
+        Node& node = m_nodes[index];
+        if (node.state == eUnexpanded) expand(game, index);
+        if (node.state != eExpanded) break;  // Terminal, being expanded elsewhere, or out of room
+
+        index = select_child(node);
+        InterlockedExchangeAdd(&m_nodes[index].visits, MCTS_VIRTUAL_LOSS);
+        const GameMove move = m_nodes[index].move;
+        VERIFY(move == PASSING_MOVE ? game->apply_passing_move() : game->apply_move(move));
+        path[++depth] = index;
+
+        if (m_nodes[index].visits == MCTS_VIRTUAL_LOSS) break;  // First visit
+    }
+
+    // Simulation
+    const LONG result = (m_nodes[index].state == eTerminal) ? score(game->game_over_val()) : playout(game, random);
+
+    for (int n = depth; n > 0; --n)
+    {
+        game->undo_last_move();
+    }
+
+    // Backpropagation, taking back all but one of the virtual losses
+    for (int n = 0; n <= depth; ++n)
+    {
+        Node& node = m_nodes[path[n]];
+        InterlockedExchangeAdd(&node.visits, 1 - MCTS_VIRTUAL_LOSS);
+        InterlockedExchangeAdd(&node.wins, (node.player == 0) ? result : 2 - result);
+    }
+}
+
+
+Value MonteCarloSearch::search(GameState* game, int maximum_analysis_ms, __out GameMove* ret_move)
+{
+    TRACE_VOID_METHOD();
+    ASSERT(m_nodes != NULL && ret_move != NULL);
+
+    const UINT64 start_time = GetPerfCounter();
+    const UINT64 deadline = start_time + UINT64(maximum_analysis_ms) * g_TicksPerMs;
+
+    m_nodes_used = 1;
+    m_stop = 0;
+    init_node(0, INVALID_MOVE, PlayerCode(1 - game->player_up()));
+    VERIFY_TRUE(expand(game, 0));
+    ASSERT(m_nodes[0].state == eExpanded);
+
+    UINT32 iterations = 0;
+    MonteCarloWorker* workers[MAX_SEARCH_THREADS];
+    int worker_count = 0;
+
+    // No choice to make if there is only one move
+    if (m_nodes[0].child_count > 1)
+    {
+        while (worker_count < game->search_threads() - 1)
+        {
+            GameState* copy = game->clone_for_search();
+            if (copy == NULL) break;
+
+            MonteCarloWorker* worker = new MonteCarloWorker(this, copy, m_random.next());
+            if (FAILED(worker->start()))
+            {
+                TRACE(WARNING, "Failed to start Monte Carlo worker %d", worker_count + 1);
+                delete worker;
+                break;
+            }
+            workers[worker_count++] = worker;
+        }
+
+        while (iterations % MCTS_POLL_INTERVAL != 0 || !(game->search_aborted() || GetPerfCounter() >= deadline))
+        {
+            iterate(game, &m_random);
+            ++iterations;
+        }
+    }
+
+    InterlockedExchange(&m_stop, 1);
+    for (int n = 0; n < worker_count; ++n)
+    {
+        workers[n]->stop();
+        iterations += workers[n]->iterations();
+        delete workers[n];
+    }
+
+    // Choose the most visited move: the one the search trusts most
+    const Node& root = m_nodes[0];
+    UINT32 best_index = root.first_child;
+    for (UINT32 index = root.first_child; index < root.first_child + root.child_count; ++index)
+    {
+        if (m_nodes[index].visits > m_nodes[best_index].visits) best_index = index;
+    }
+    const Node& best = m_nodes[best_index];
+    *ret_move = best.move;
+
+    const float winning_rate = best.visits ? best.wins / (2.0f * best.visits) : 0.5f;
+    const Value value = Value(winning_rate * 200 - 100);
+
+    if (!g_profiling && iterations > 0)
+    {
+        const double seconds = double(GetPerfCounter() - start_time) / (g_TicksPerMs * 1000);
+        char move_string[MAX_MOVE_STRING_SIZE];
+        game->write_move(best.move, sizeof move_string, move_string);
+        game->output("Monte Carlo: %u iterations in %.2f seconds (%.0f per second on %d thread%s), %u of %u tree nodes used\n",
+                     iterations, seconds, seconds > 0 ? iterations / seconds : 0.0, worker_count + 1, worker_count ? "s" : "",
+                     UINT32(m_nodes_used), m_pool_size);
+        game->output("Monte Carlo: %s won %.1f%% of %u playouts\n", move_string, winning_rate * 100, best.visits);
+    }
+
+    return game->side_sign() * value;
+}
+
+
+
+//
+// MonteCarloWorker
+//
+
+MonteCarloWorker::~MonteCarloWorker()
+{
+    stop();
+    GameState::delete_clone(m_state);
+}
+
+
+HRESULT MonteCarloWorker::start()
+{
+    TRACE_VOID_METHOD();
+    ASSERT(!m_started);
+
+    HRESULT hr = ThreadBase::Initialize();
+
+    if (SUCCEEDED(hr))
+    {
+        m_started = true;
+        hr = StartThread();
+    }
+
+    return hr;
+}
+
+
+void MonteCarloWorker::stop()
+{
+    if (m_started)
+    {
+        ASSERT(m_search->m_stop);
+        StopThread();
+        m_started = false;
+    }
+}
+
+
+void MonteCarloWorker::ThreadProc()
+{
+    while (!m_search->m_stop)
+    {
+        m_search->iterate(m_state, &m_random);
+        ++m_iterations;
+    }
+}
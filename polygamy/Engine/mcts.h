@@ -0,0 +1,169 @@
+// mcts.h
+
+#ifndef ENGINE_MCTS_H
+#define ENGINE_MCTS_H
+
+#include "game.h"      // For GameState, GameMove
+#include "threader.h"  // For ThreadBase
+
+
+// Longest line of play followed through the tree before a playout starts
+#define MCTS_MAX_TREE_DEPTH 64
+
+// Iterations between looks at the clock and the stop flag
+#define MCTS_POLL_INTERVAL 64
+
+// Visits a thread adds to each node on its way down the tree, as if its
+// playout had already been lost, so that threads descending at the same
+// time spread out over different lines; all but one are taken back once
+// the result is known
+#define MCTS_VIRTUAL_LOSS 3
+
+
+//
+// XorShiftRandom: Marsaglia's 32-bit xorshift generator.  Much faster than
+// rand(), with no state shared between threads, and random enough for
+// choosing playout moves.
+//
+
+class XorShiftRandom
+{
+public:
+
+    XorShiftRandom(UINT32 seed = 2463534242) : m_state(seed ? seed : 2463534242) {}
+
+    UINT32 next()
+    {
+        m_state ^= m_state << 13;
+        m_state ^= m_state >> 17;
+        m_state ^= m_state << 5;
+        return m_state;
+    }
+
+    // Returns a number from 0 to n-1 (scaling rather than dividing, which is
+    // faster and just as uniform for small n)
+    UINT32 below(UINT32 n) {return UINT32((UINT64(next()) * n) >> 32);}
+
+private:
+
+    UINT32 m_state;
+};
+
+
+//
+// MonteCarloSearch: Monte Carlo Tree Search with the UCT selection rule, used
+// by GameState::analyze() in place of minimax when the game's search driver
+// is eMonteCarlo.  Each iteration follows the tree down from the root,
+// choosing at each node the child with the best upper confidence bound on its
+// winning rate; expands the leaf it reaches; plays the game out from there
+// with random moves; and credits the result to every node on the way.  The
+// root move visited most often is chosen.
+//
+// No evaluation function is needed, only the game's move generation (the same
+// get_possible_moves(), apply_move() and undo_last_move() that minimax uses),
+// so this suits games whose position_val() is weak.  Playouts still unfinished
+// after MCTS_PLAYOUT_LIMIT moves are scored by the sign of position_val().
+//
+// Nodes are kept in one preallocated pool, with the children of each node
+// side by side, rather than in the GameNode tree.  The tree is built afresh
+// for each analysis; once the pool is full, the search carries on without
+// expanding any more leaves.
+//
+// With more than one search thread (see GameState::set_search_threads()), the
+// tree is shared: MonteCarloWorker threads, each playing on its own clone()
+// of the game, run iterations alongside the calling thread.  Nothing is
+// locked.  Visit counts and wins are updated with interlocked additions, and
+// a node is expanded by whichever thread claims it first, the others
+// meanwhile treating it as a leaf.  Virtual loss (MCTS_VIRTUAL_LOSS) keeps
+// the threads from all following the same line.
+//
+
+class MonteCarloSearch
+{
+public:
+
+    MonteCarloSearch() : m_nodes(NULL), m_pool_size(0), m_nodes_used(0), m_stop(0), m_random(UINT32(rand()) << 15 ^ UINT32(rand())) {}  // Seeded as srand() was
+    ~MonteCarloSearch() {delete[] m_nodes;}
+
+    Result allocate(int node_count);
+
+    // Searches the game's current position, which mustn't be over, for up to
+    // 'maximum_analysis_ms' or until the game's stop flag is set.  Returns the
+    // chosen move's winning rate as a value from -100 to 100, from player 0's
+    // point of view.
+    Value search(GameState* game, int maximum_analysis_ms, __out GameMove* ret_move);
+
+private:
+
+    // (eNoRoom marks a leaf whose children didn't fit in the pool, which
+    // stays a leaf rather than being tried again on every visit)
+    enum NodeState {eUnexpanded, eExpanding, eExpanded, eTerminal, eNoRoom};
+
+    struct Node
+    {
+        GameMove move;           // Move leading to this position
+        UINT32 first_child;      // Pool index of the first child; the others follow it
+        volatile LONG visits;    // Iterations that have passed through this node, including virtual losses
+        volatile LONG wins;      // Their results for the player who made 'move' (2 per win, 1 per draw)
+        volatile LONG state;     // A NodeState; first_child and child_count are valid once it is eExpanded
+        WORD child_count;
+        BYTE player;             // Player who made 'move'
+    };
+
+    Node* m_nodes;
+    UINT32 m_pool_size;
+    volatile LONG m_nodes_used;  // Never more than m_pool_size
+    volatile LONG m_stop;        // Set when the worker threads should stop
+    XorShiftRandom m_random;
+
+    void init_node(UINT32 index, GameMove move, PlayerCode player);
+    void iterate(GameState* game, XorShiftRandom* random);
+    bool expand(GameState* game, UINT32 index);
+    UINT32 select_child(const Node& node) const;
+    LONG playout(GameState* game, XorShiftRandom* random);
+    friend class MonteCarloWorker;
+
+    // A game result as a score for player 0, in half points
+    static LONG score(Value value) {return value > 0 ? 2 : value < 0 ? 0 : 1;}
+
+    // Prevent copying
+    MonteCarloSearch(const MonteCarloSearch&);
+    MonteCarloSearch& operator=(const MonteCarloSearch&);
+};
+
+
+//
+// MonteCarloWorker: a thread running iterations of a MonteCarloSearch, on its
+// own copy of the game, until the search's stop flag is set.
+//
+
+class MonteCarloWorker : private ThreadBase
+{
+public:
+
+    // Takes ownership of 'state', which must have been produced by clone_for_search()
+    MonteCarloWorker(MonteCarloSearch* search, GameState* state, UINT32 seed)
+      : m_search(search), m_state(state), m_random(seed), m_started(false), m_iterations(0) {}
+    ~MonteCarloWorker();
+
+    HRESULT start();
+    void stop();  // Waits for the thread to exit; the search's stop flag must be set first
+    UINT32 iterations() const {return m_iterations;}
+
+private:
+
+    MonteCarloSearch* m_search;
+    GameState* m_state;
+    XorShiftRandom m_random;
+    bool m_started;
+    UINT32 m_iterations;
+
+    void ThreadProc();
+
+    // Prevent copying
+    MonteCarloWorker(const MonteCarloWorker&);
+    MonteCarloWorker& operator=(const MonteCarloWorker&);
+};
+
+
+#endif // ENGINE_MCTS_H
@@ -0,0 +1,84 @@
+// ordering.cpp
+
+#include "shared.h"    // Precompiled header; obligatory
+#include "ordering.h"  // Our public interface
+
+
+Result MoveOrdering::allocate(int index_count)
+{
+    TRACE_VOID_METHOD();
+
+    delete[] m_history;
+    m_history = NULL;
+    m_index_count = 0;
+
+    if (index_count > 0)
+    {
+        m_history = new int[2 * index_count];
+        if (m_history == NULL) return Result::Fail;
+        m_index_count = index_count;
+    }
+
+    clear();
+
+    return Result::OK;
+}
+
+
+void MoveOrdering::clear()
+{
+    for (int ply = 0; ply < KILLER_PLIES; ++ply)
+        for (int n = 0; n < KILLER_SLOTS; ++n)
+            m_killers[ply][n] = INVALID_MOVE;
+
+    if (m_history)
+    {
+        memset(m_history, 0, 2 * m_index_count * sizeof(int));
+    }
+}
+
+
+//
+// The killers are kept, since plies are numbered from the start of the game
+// and the next search will visit many of the same positions
+//
+
+void MoveOrdering::new_search()
+{
+    age_history();
+}
+
+
+void MoveOrdering::record_cutoff(int ply, PlayerCode player, GameMove move, int index, int depth)
+{
+    GameMove* killers = m_killers[ply % KILLER_PLIES];
+    if (killers[0] != move)
+    {
+        // Push the others down, dropping the oldest (or the move itself, if
+        // it was already a killer)
+        int n = KILLER_SLOTS - 1;
+        while (n > 0 && killers[n] != move) --n;
+        for (n = (n == 0) ? KILLER_SLOTS - 1 : n; n > 0; --n)
+        {
+            killers[n] = killers[n - 1];
+        }
+        killers[0] = move;
+    }
+
+    if (index >= 0 && index < m_index_count)
+    {
+        // Deep cutoffs save much more work than shallow ones
+        int& score = m_history[player * m_index_count + index];
+        score += depth * depth;
+        if (score >= HISTORY_LIMIT) age_history();
+    }
+}
+
+
+void MoveOrdering::age_history()
+{
+    for (int n = 0; n < 2 * m_index_count; ++n)
+    {
+        m_history[n] /= 2;
+    }
+}
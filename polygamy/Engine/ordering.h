@@ -0,0 +1,84 @@
+// ordering.h
+
+#ifndef ENGINE_ORDERING_H
+#define ENGINE_ORDERING_H
+
+#include "game.h"  // For GameMove, PlayerCode
+
+
+// Game plies for which killer moves are kept.  Plies are counted from the
+// start of the game and wrap around, so this must exceed any search depth
+// for killers from different depths of one search never to collide.
+#define KILLER_PLIES 128
+
+// Killer moves remembered per ply
+#define KILLER_SLOTS 2
+
+// History scores are halved when any of them reaches this, so that recent
+// cutoffs keep counting for more than old ones
+#define HISTORY_LIMIT 0x1000000
+
+
+//
+// MoveOrdering: knowledge gathered from beta cutoffs that helps order the
+// moves of positions the search hasn't expanded yet.
+//
+// Killer moves: the last few moves that caused a cutoff at each ply.  A move
+// that refutes one line of play often refutes its siblings as well, so these
+// are tried first wherever they are legal.
+//
+// History heuristic: a score for each move (and player) that grows with the
+// depth of the cutoffs it causes anywhere in the tree.  Games supply a dense
+// numbering of their moves (see GameState::move_index()) to index it.
+//
+// One table is shared by all of a search's threads without locking.  The
+// contents are only hints, and each entry is a single aligned word, so
+// simultaneous updates can at worst lose a little information.
+//
+
+class MoveOrdering
+{
+public:
+
+    MoveOrdering() : m_history(NULL), m_index_count(0) {clear();}
+    ~MoveOrdering() {delete[] m_history;}
+
+    // Sizes the history table for moves numbered 0 .. index_count-1
+    Result allocate(int index_count);
+    void clear();
+
+    // Called at the start of each search so older history counts for less
+    void new_search();
+
+    // Records a move that caused a beta cutoff with 'depth' plies to go
+    void record_cutoff(int ply, PlayerCode player, GameMove move, int index, int depth);
+
+    bool is_killer(int ply, GameMove move) const
+    {
+        const GameMove* killers = m_killers[ply % KILLER_PLIES];
+        for (int n = 0; n < KILLER_SLOTS; ++n)
+            if (killers[n] == move) return true;
+        return false;
+    }
+    const GameMove* killers(int ply) const {return m_killers[ply % KILLER_PLIES];}  // KILLER_SLOTS moves, most recent first
+
+    int history(PlayerCode player, int index) const
+    {
+        return (index >= 0 && index < m_index_count) ? m_history[player * m_index_count + index] : 0;
+    }
+
+private:
+
+    GameMove m_killers[KILLER_PLIES][KILLER_SLOTS];
+    int* m_history;      // Scores for player 0's moves, then player 1's
+    int m_index_count;
+
+    void age_history();
+
+    // Prevent copying
+    MoveOrdering(const MoveOrdering&);
+    MoveOrdering& operator=(const MoveOrdering&);
+};
+
+
+#endif // ENGINE_ORDERING_H
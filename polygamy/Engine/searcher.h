@@ -0,0 +1,155 @@
+// searcher.h
+
+#ifndef ENGINE_SEARCHER_H
+#define ENGINE_SEARCHER_H
+
+#include "game.h"  // For GameState, GameMove, MoveList, Value
+
+
+//
+// Searcher<Game>: a fixed-depth alpha-beta search in which the game's move
+// generation, move making and evaluation functions are bound at compile time,
+// and the move list evaluation at the heart of GameState::generate_move_list().
+//
+// negamax() calls these through GameState's virtual functions at every node,
+// which costs an indirect call each time and stops the compiler inlining the
+// game's code into the search.  Here 'Game' is the concrete game class and its
+// functions are called by their qualified names, which C++ binds statically.
+// They can only be inlined where their definitions are visible, so each game
+// instantiates its Searcher in its own .cpp file, in its overrides of
+// GameState::fixed_depth_search() and GameState::evaluate_moves().
+// Searcher<GameState> runs the same code through the virtual functions
+// instead; it provides GameState's defaults, and the baseline the frontend's
+// -x benchmark measures the games' own searchers against.
+//
+// evaluate_moves() is what analyze() uses: generate_move_list() makes one
+// virtual call to it per node expanded, instead of several per move.
+//
+// The search is plain: it keeps no game tree, transposition table or move
+// ordering, and tries moves in the order get_possible_moves() lists them.
+// Rejected moves, passing and the end of the game are handled as they are by
+// generate_move_list().
+//
+
+template <class Game>
+class Searcher
+{
+public:
+
+    explicit Searcher(Game* game) : m_game(game), m_nodes(0) {}
+
+    // Searches the current position 'depth' plies deep.  Returns its value from
+    // player 0's point of view, with the best move for the player to move in
+    // 'best_move' (INVALID_MOVE if the game is over) and the number of
+    // positions visited in 'nodes'.
+    Value search(int depth, __out GameMove* best_move, __out UINT64* nodes)
+    {
+        m_nodes = 0;
+        *best_move = INVALID_MOVE;
+        const Value value = m_game->side_sign() * negamax(depth, -LIMIT_VALUE, LIMIT_VALUE, best_move);
+        *nodes = m_nodes;
+        return value;
+    }
+
+    // For GameState::evaluate_moves(): lists the legal moves in the current
+    // position, or just PASSING_MOVE if the player to move must pass, with the
+    // values of the positions they lead to.  Returns the count (0 if the game
+    // is over).
+    int evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values)
+    {
+        MoveList possible_moves;
+        get_possible_moves(&possible_moves);
+
+        int count = 0;
+        for (int n = 0; n < possible_moves.count(); ++n)
+        {
+            if (apply_move(possible_moves[n]).failed()) continue;
+            moves[count] = possible_moves[n];
+            values[count++] = position_val();
+            undo_last_move();
+        }
+
+        if (count == 0 && apply_passing_move().ok())
+        {
+            moves[count] = PASSING_MOVE;
+            values[count++] = position_val();
+            undo_last_move();
+        }
+
+        return count;
+    }
+
+private:
+
+    Game* m_game;
+    UINT64 m_nodes;  // Positions visited by the current search
+
+    // Value of the current position from the point of view of the player to
+    // move, as for GameState::negamax(); also sets 'best_move' if it isn't NULL
+    Value negamax(int depth, Value alpha, Value beta, __out_opt GameMove* best_move)
+    {
+        ++m_nodes;
+
+        if (depth <= 0)
+        {
+            return m_game->side_sign() * position_val();
+        }
+
+        MoveList moves;
+        get_possible_moves(&moves);
+
+        Value best_value = -LIMIT_VALUE - 1;
+        for (int n = 0; n < moves.count(); ++n)
+        {
+            if (apply_move(moves[n]).failed()) continue;
+            const Value value = -negamax(depth - 1, -beta, -alpha, NULL);
+            undo_last_move();
+
+            if (value > best_value)
+            {
+                best_value = value;
+                if (best_move) *best_move = moves[n];
+                if (best_value >= beta) return best_value;
+                alpha = max(alpha, best_value);
+            }
+        }
+
+        if (best_value == -LIMIT_VALUE - 1)
+        {
+            // No legal moves: pass if the game allows it, otherwise it's over
+            if (apply_passing_move().failed())
+            {
+                return m_game->side_sign() * game_over_val();
+            }
+            best_value = -negamax(depth - 1, -beta, -alpha, NULL);
+            undo_last_move();
+            if (best_move) *best_move = PASSING_MOVE;
+        }
+
+        return best_value;
+    }
+
+    // The game's functions, called directly (see the specializations for
+    // GameState below, which call them virtually)
+    FORCEINLINE void get_possible_moves(__out MoveList* moves) const {m_game->Game::get_possible_moves(moves);}
+    FORCEINLINE Result apply_move(GameMove move) {return m_game->Game::apply_move(move);}
+    FORCEINLINE Result apply_passing_move() {return m_game->Game::apply_passing_move();}
+    FORCEINLINE void undo_last_move() {m_game->Game::undo_last_move();}
+    FORCEINLINE Value position_val() const {return m_game->Game::position_val();}
+    FORCEINLINE Value game_over_val() const {return m_game->Game::game_over_val();}
+
+    // Prevent copying
+    Searcher(const Searcher&);
+    Searcher& operator=(const Searcher&);
+};
+
+
+template <> FORCEINLINE void Searcher<GameState>::get_possible_moves(__out MoveList* moves) const {m_game->get_possible_moves(moves);}
+template <> FORCEINLINE Result Searcher<GameState>::apply_move(GameMove move) {return m_game->apply_move(move);}
+template <> FORCEINLINE Result Searcher<GameState>::apply_passing_move() {return m_game->apply_passing_move();}
+template <> FORCEINLINE void Searcher<GameState>::undo_last_move() {m_game->undo_last_move();}
+template <> FORCEINLINE Value Searcher<GameState>::position_val() const {return m_game->position_val();}
+template <> FORCEINLINE Value Searcher<GameState>::game_over_val() const {return m_game->game_over_val();}
+
+
+#endif // ENGINE_SEARCHER_H
@@ -0,0 +1,181 @@
+// smp.cpp
+
+#include "shared.h"  // Precompiled header; obligatory
+#include "smp.h"     // Our public interface
+
+
+SearchHelper::~SearchHelper()
+{
+    stop();
+    GameState::delete_clone(m_state);
+}
+
+
+HRESULT SearchHelper::start(int target_depth, Value lower_bound, Value upper_bound, const volatile LONG* main_depth)
+{
+    TRACE_VOID_METHOD();
+    ASSERT(!m_started);
+
+    m_target_depth = target_depth;
+    m_lower_bound = lower_bound;
+    m_upper_bound = upper_bound;
+    m_main_depth = main_depth;
+    m_state->m_stop_flag = &m_stop_flag;
+
+    HRESULT hr = ThreadBase::Initialize();
+
+    if (SUCCEEDED(hr))
+    {
+        m_started = true;
+        hr = StartThread();
+    }
+
+    return hr;
+}
+
+
+//
+// Makes the helper abandon its search and waits for its thread to exit
+//
+
+void SearchHelper::stop()
+{
+    if (m_started)
+    {
+        InterlockedExchange(&m_stop_flag, 1);
+        StopThread();
+    }
+}
+
+
+void SearchHelper::ThreadProc()
+{
+    m_state->helper_search(m_index, m_target_depth, m_lower_bound, m_upper_bound, m_main_depth);
+}
+
+
+
+//
+// SplitWorker
+//
+
+SplitWorker::~SplitWorker()
+{
+    // Stop the thread before our members go away
+    StopThread();
+    ASSERT(m_state == NULL);
+}
+
+
+HRESULT SplitWorker::initialize()
+{
+    TRACE_VOID_METHOD();
+
+    HRESULT hr = ThreadBase::Initialize();
+
+    if (SUCCEEDED(hr))
+    {
+        hr = StartThread();  // Runs ThreadProc, which waits for an assignment
+    }
+
+    return hr;
+}
+
+
+void SplitWorker::assign(GameState* state, GameState::SplitPoint* split_point)
+{
+    ASSERT(m_busy);
+    ASSERT(m_state == NULL);
+
+    m_split_point = split_point;
+    m_state = state;  // Set last; the thread may be looking for it already
+    WakeThread();
+}
+
+
+void SplitWorker::ThreadProc()
+{
+    // Check for an assignment before each sleep, since the wake-up signal for
+    // the first one may have been consumed by ThreadBase's startup code
+    do
+    {
+        if (m_state != NULL)
+        {
+            GameState::SplitPoint* split_point = m_split_point;
+            m_state->search_split_point(split_point);
+
+            GameState::delete_clone(m_state);
+            m_state = NULL;
+            m_split_point = NULL;
+
+            // The split point may cease to exist as soon as this is done
+            InterlockedDecrement(&split_point->active_workers);
+
+            m_pool->release_worker(this);
+        }
+    }
+    while (ThreadSleep(INFINITE));
+}
+
+
+//
+// SplitWorkerPool
+//
+
+SplitWorkerPool::~SplitWorkerPool()
+{
+    for (int n = 0; n < m_worker_count; ++n)
+    {
+        delete m_workers[n];
+    }
+}
+
+
+HRESULT SplitWorkerPool::initialize(int worker_count)
+{
+    TRACE_VOID_METHOD();
+    ASSERT(m_worker_count == 0);
+    ASSERT(worker_count <= MAX_SEARCH_THREADS);
+
+    HRESULT hr = S_OK;
+
+    while (m_worker_count < worker_count && SUCCEEDED(hr))
+    {
+        SplitWorker* worker = new SplitWorker(this);
+        hr = worker->initialize();
+
+        if (SUCCEEDED(hr))
+        {
+            m_workers[m_worker_count++] = worker;
+            InterlockedIncrement(&m_idle_workers);
+        }
+        else
+        {
+            delete worker;
+        }
+    }
+
+    return hr;
+}
+
+
+SplitWorker* SplitWorkerPool::reserve_worker()
+{
+    for (int n = 0; n < m_worker_count && m_idle_workers > 0; ++n)
+    {
+        if (m_workers[n]->try_reserve())
+        {
+            InterlockedDecrement(&m_idle_workers);
+            return m_workers[n];
+        }
+    }
+
+    return NULL;
+}
+
+
+void SplitWorkerPool::release_worker(SplitWorker* worker)
+{
+    InterlockedExchange(&worker->m_busy, 0);
+    InterlockedIncrement(&m_idle_workers);
+}
@@ -0,0 +1,132 @@
+// smp.h
+
+#ifndef ENGINE_SMP_H
+#define ENGINE_SMP_H
+
+#include "game.h"      // For GameState
+#include "threader.h"  // For ThreadBase
+
+
+//
+// SearchHelper: a worker thread for "Lazy SMP" parallel search.  Each helper
+// searches the same root position as the main thread, on its own clone() of
+// the game, and shares its results with the other threads only through the
+// transposition table.  Helpers stay one or two plies ahead of the main
+// thread so that when it reaches a given depth the table already holds many
+// of the results it needs.  The main thread's own search result is always
+// the one returned by GameState::analyze().
+//
+
+class SearchHelper : private ThreadBase
+{
+public:
+
+    // Takes ownership of 'state', which must have been produced by clone()
+    SearchHelper(GameState* state, int index)
+      : m_state(state), m_index(index), m_started(false), m_stop_flag(0) {}
+    ~SearchHelper();
+
+    // 'main_depth' points to the depth currently being searched by the main thread
+    HRESULT start(int target_depth, Value lower_bound, Value upper_bound, const volatile LONG* main_depth);
+    void stop();
+
+private:
+
+    GameState* m_state;
+    int m_index;  // 1 for the first helper, 2 for the second, etc.
+    bool m_started;
+    volatile LONG m_stop_flag;
+
+    // Search parameters
+    int m_target_depth;
+    Value m_lower_bound;
+    Value m_upper_bound;
+    const volatile LONG* m_main_depth;
+
+    void ThreadProc();
+
+    // Prevent copying
+    SearchHelper(const SearchHelper&);
+    SearchHelper& operator=(const SearchHelper&);
+};
+
+
+//
+// SplitWorker: a thread used for "Young Brothers Wait" parallel search.  When
+// a thread searching a node has finished with its first (eldest) child, and
+// enough depth remains, it makes the node a split point: idle workers are
+// each given a clone() of the game in the node's position, and they join the
+// owning thread in searching the node's remaining children.  A beta cutoff
+// found by any of them abandons the searches of the others.  Workers may in
+// turn create split points of their own within the subtrees they search.
+//
+// The workers live in a SplitWorkerPool owned by the main thread's game, and
+// sleep between assignments.
+//
+
+class SplitWorker : private ThreadBase
+{
+public:
+
+    SplitWorker(SplitWorkerPool* pool) : m_pool(pool), m_busy(0), m_state(NULL), m_split_point(NULL) {}
+    ~SplitWorker();
+
+    HRESULT initialize();
+
+    // Reserves the worker if it is idle; returns false if it is busy
+    bool try_reserve() {return InterlockedCompareExchange(&m_busy, 1, 0) == 0;}
+
+    // Starts a reserved worker on a split point.  Takes ownership of 'state',
+    // which must be a copy of the owning thread's game made by clone_for_search().
+    void assign(GameState* state, GameState::SplitPoint* split_point);
+
+private:
+
+    SplitWorkerPool* m_pool;
+    volatile LONG m_busy;
+    GameState* volatile m_state;
+    GameState::SplitPoint* volatile m_split_point;
+
+    void ThreadProc();
+    friend class SplitWorkerPool;
+
+    // Prevent copying
+    SplitWorker(const SplitWorker&);
+    SplitWorker& operator=(const SplitWorker&);
+};
+
+
+class SplitWorkerPool
+{
+public:
+
+    SplitWorkerPool() : m_worker_count(0), m_idle_workers(0), m_splits(0) {}
+    ~SplitWorkerPool();
+
+    HRESULT initialize(int worker_count);
+    int worker_count() const {return m_worker_count;}
+
+    // Returns a reserved idle worker, or NULL if none is available
+    SplitWorker* reserve_worker();
+    bool any_idle() const {return m_idle_workers > 0;}
+    void release_worker(SplitWorker* worker);
+
+    // Number of split points created so far
+    void record_split() {InterlockedIncrement(&m_splits);}
+    LONG splits() const {return m_splits;}
+    void clear_statistics() {InterlockedExchange(&m_splits, 0);}
+
+private:
+
+    SplitWorker* m_workers[MAX_SEARCH_THREADS];
+    int m_worker_count;
+    volatile LONG m_idle_workers;
+    volatile LONG m_splits;
+
+    // Prevent copying
+    SplitWorkerPool(const SplitWorkerPool&);
+    SplitWorkerPool& operator=(const SplitWorkerPool&);
+};
+
+
+#endif // ENGINE_SMP_H
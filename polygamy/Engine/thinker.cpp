@@ -6,9 +6,16 @@
 
 HRESULT Thinker::initialize()
 {
+    TRACE_VOID_METHOD();
+    ASSERT(!m_started);
+
     HRESULT hr = ThreadBase::Initialize();
 
-    StartThread();
+    if (SUCCEEDED(hr))
+    {
+        m_started = true;
+        hr = StartThread();
+    }
 
     return hr;
 }
@@ -16,11 +23,16 @@ HRESULT Thinker::initialize()
 
 void Thinker::terminate()
 {
-    StopThread();
+    if (m_started)
+    {
+        InterlockedExchange(&m_stop_flag, 1);
+        StopThread();
+        m_started = false;
+    }
 }
 
 
 void Thinker::ThreadProc()
 {
-    // FIXME: to do...
+    m_state->ponder(m_target_depth, &m_stop_flag);
 }
@@ -1,17 +1,40 @@
 // thinker.h
 
 #pragma once
-#include "threader.h"
+#include "game.h"      // For GameState
+#include "threader.h"  // For ThreadBase
 
 
+//
+// Thinker: a thread that ponders, i.e. searches on the opponent's time.  It
+// works on the game itself, not on a clone, so that everything it finds is
+// left in the game tree: first it searches the position after the reply the
+// last search predicted, and then, if that search finishes before it is
+// stopped, the opponent's position itself (which covers all the replies).
+// See GameState::start_pondering().
+//
+
 class Thinker : private ThreadBase
 {
 public:
 
+    Thinker(GameState* state, int target_depth)
+      : m_state(state), m_target_depth(target_depth), m_started(false), m_stop_flag(0) {}
+    ~Thinker() {terminate();}
+
     HRESULT initialize();
-    void terminate();
+    void terminate();  // Abandons the search and waits for the thread to exit
 
 private:
 
+    GameState* m_state;
+    int m_target_depth;
+    bool m_started;
+    volatile LONG m_stop_flag;
+
     void ThreadProc();
+
+    // Prevent copying
+    Thinker(const Thinker&);
+    Thinker& operator=(const Thinker&);
 };
@@ -0,0 +1,12 @@
+// timing.cpp
+
+#include "shared.h"  // Precompiled header; obligatory
+#include "timing.h"  // Our public interface
+
+
+int TimeManager::move_budget(int moves_left) const
+{
+    int budget = m_remaining_ms / max(moves_left, 1);
+    budget = min(budget, m_remaining_ms / 2);
+    return max(budget, TIME_MINIMUM_MOVE_MS);
+}
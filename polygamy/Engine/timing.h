@@ -0,0 +1,39 @@
+// timing.h
+
+#ifndef ENGINE_TIMING_H
+#define ENGINE_TIMING_H
+
+
+// Time in milliseconds that a move is always allowed, however little is left
+#define TIME_MINIMUM_MOVE_MS 10
+
+
+//
+// TimeManager: divides one player's time for a whole game between its moves.
+// Each move is given an equal share of the time left, over the moves the game
+// expects the player still to make (see GameState::expected_moves_left()),
+// but never more than half of it.  Time that a move doesn't use (because the
+// search stopped early, or there was only one legal move) is left for the
+// moves after it.
+//
+// analyze() stops within a few milliseconds of its limit, so a budget is
+// only overrun by that much.
+//
+
+class TimeManager
+{
+public:
+
+    TimeManager(int game_ms) : m_remaining_ms(game_ms) {}
+
+    int move_budget(int moves_left) const;  // Milliseconds for the next move
+    void record_move(int elapsed_ms) {m_remaining_ms = max(0, m_remaining_ms - elapsed_ms);}
+    int remaining_ms() const {return m_remaining_ms;}
+
+private:
+
+    int m_remaining_ms;
+};
+
+
+#endif // ENGINE_TIMING_H
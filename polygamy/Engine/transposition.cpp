@@ -0,0 +1,273 @@
+// transposition.cpp
+
+#include "shared.h"         // Precompiled header; obligatory
+#include "transposition.h"  // Our public interface
+
+
+#define TT_FILE_SIGNATURE "POLYTTAB"  // 8 characters, without a terminator
+#define TT_FILE_CHUNK (1 << 30)       // Bytes per ReadFile() or WriteFile() call, which take 32-bit sizes
+
+struct TranspositionFileHeader
+{
+    char signature[8];      // TT_FILE_SIGNATURE
+    UINT32 version;         // TT_FILE_VERSION
+    UINT32 bucket_size;     // sizeof(Bucket), as a check on the layout
+    PositionHash key;       // As passed to save()
+    UINT64 bucket_count;
+    UINT32 age;             // The table's search generation
+    UINT32 reserved;
+};
+
+
+//
+// Allocate the table, discarding any previous contents.  The bucket count is
+// rounded down to a power of 2 so that bucket selection is a simple mask.
+//
+
+Result TranspositionTable::allocate(size_t megabytes)
+{
+    TRACE_VOID_METHOD();
+
+    C_ASSERT(sizeof(Entry) == 16);
+
+    size_t bucket_count = 1;
+    while (bucket_count * 2 * sizeof(Bucket) <= megabytes * (1 << 20))
+    {
+        bucket_count *= 2;
+    }
+
+    delete[] m_buckets;
+    m_buckets = new Bucket[bucket_count];
+    if (m_buckets == NULL)
+    {
+        m_bucket_mask = 0;
+        return Result::Fail;
+    }
+
+    m_bucket_mask = bucket_count - 1;
+    clear();
+
+    return Result::OK;
+}
+
+
+void TranspositionTable::clear()
+{
+    if (m_buckets)
+    {
+        memset(m_buckets, 0, (m_bucket_mask + 1) * sizeof(Bucket));  // Zero is eNoBound
+    }
+    m_age = 0;
+    clear_statistics();
+}
+
+
+bool TranspositionTable::probe(PositionHash hash, __out Entry* entry)
+{
+    ASSERT(m_buckets != NULL);
+    ++m_statistics.probes;
+
+    Bucket& bucket = bucket_for(hash);
+    UINT32 check = check_for(hash);
+
+    for (int n = 0; n < TT_BUCKET_SIZE; ++n)
+    {
+        // Work on a copy, since other threads may be rewriting the entry
+        Entry candidate = bucket.entries[n];
+        if (candidate.bound != eNoBound && (candidate.check ^ entry_data(candidate)) == check)
+        {
+            bucket.entries[n].age = m_age;  // Keep entries that are still useful
+            *entry = candidate;
+            ++m_statistics.hits;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+void TranspositionTable::store(PositionHash hash, Value value, ValueBound bound, int depth, GameMove best_move)
+{
+    ASSERT(m_buckets != NULL);
+    ASSERT(bound != eNoBound);
+    ++m_statistics.stores;
+
+    Bucket& bucket = bucket_for(hash);
+    UINT32 check = check_for(hash);
+    Entry* victim = NULL;
+    int victim_priority = TT_MAX_DEPTH + 1;  // Worse than any real priority
+
+    for (int n = 0; n < TT_BUCKET_SIZE; ++n)
+    {
+        Entry& entry = bucket.entries[n];
+        UINT32 entry_check = entry.check ^ entry_data(entry);
+
+        if (entry.bound != eNoBound && entry_check == check)
+        {
+            // Same position; keep its old best move if the new search didn't produce one
+            if (best_move == INVALID_MOVE)
+            {
+                best_move = entry.best_move;
+            }
+            victim = &entry;
+            break;
+        }
+
+        // Empty slots go first; then the shallowest entry, where each search
+        // generation an entry has survived counts as 8 plies of depth
+        int priority = (entry.bound == eNoBound) ? -TT_MAX_DEPTH : entry.depth - 8 * BYTE(m_age - entry.age);
+        if (priority < victim_priority)
+        {
+            victim = &entry;
+            victim_priority = priority;
+        }
+    }
+
+    ASSERT(victim != NULL);
+
+    if (victim->bound != eNoBound && (victim->check ^ entry_data(*victim)) != check)
+    {
+        ++m_statistics.replacements;
+    }
+
+    Entry new_entry;
+    new_entry.value = value;
+    new_entry.best_move = best_move;
+    new_entry.depth = short(min(depth, TT_MAX_DEPTH));
+    new_entry.bound = BYTE(bound);
+    new_entry.age = m_age;
+    new_entry.check = check ^ entry_data(new_entry);
+    *victim = new_entry;
+}
+
+
+//
+// The file is written under a temporary name and then renamed, so that a
+// checkpoint interrupted part way through leaves the previous one intact.
+//
+
+Result TranspositionTable::save(const char* file_name, PositionHash key) const
+{
+    TRACE_VOID_METHOD();
+    ASSERT(m_buckets != NULL);
+
+    char temporary_name[MAX_PATH];
+    if (FAILED(StringCchPrintfA(temporary_name, countof(temporary_name), "%s.tmp", file_name)))
+    {
+        return Result::Fail;
+    }
+
+    HANDLE file = CreateFileA(temporary_name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return Result::Fail;
+    }
+
+    TranspositionFileHeader header;
+    memcpy(header.signature, TT_FILE_SIGNATURE, sizeof header.signature);
+    header.version = TT_FILE_VERSION;
+    header.bucket_size = sizeof(Bucket);
+    header.key = key;
+    header.bucket_count = m_bucket_mask + 1;
+    header.age = m_age;
+    header.reserved = 0;
+
+    DWORD done = 0;
+    bool ok = WriteFile(file, &header, sizeof header, &done, NULL) && done == sizeof header;
+
+    const char* data = reinterpret_cast<const char*>(m_buckets);
+    for (UINT64 size = UINT64(m_bucket_mask + 1) * sizeof(Bucket); ok && size > 0; )
+    {
+        const DWORD chunk = DWORD(min(size, UINT64(TT_FILE_CHUNK)));
+        ok = WriteFile(file, data, chunk, &done, NULL) && done == chunk;
+        data += chunk;
+        size -= chunk;
+    }
+
+    ok = FlushFileBuffers(file) && ok;
+    VERIFY_TRUE(CloseHandle(file));
+
+    if (ok)
+    {
+        ok = MoveFileExA(temporary_name, file_name, MOVEFILE_REPLACE_EXISTING) != FALSE;
+    }
+    if (!ok)
+    {
+        DeleteFileA(temporary_name);
+    }
+
+    return ok ? Result::OK : Result::Fail;
+}
+
+
+Result TranspositionTable::load(const char* file_name, PositionHash key)
+{
+    TRACE_VOID_METHOD();
+
+    HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return Result::Fail;
+    }
+
+    HANDLE mapping = NULL;
+    const void* view = NULL;
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(file, &size) && UINT64(size.QuadPart) >= sizeof(TranspositionFileHeader))
+    {
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+        {
+            view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+    }
+
+    bool ok = false;
+    if (view)
+    {
+        const TranspositionFileHeader* header = static_cast<const TranspositionFileHeader*>(view);
+        const UINT64 bucket_count = header->bucket_count;
+
+        ok = memcmp(header->signature, TT_FILE_SIGNATURE, sizeof header->signature) == 0 &&
+             header->version == TT_FILE_VERSION &&
+             header->bucket_size == sizeof(Bucket) &&
+             header->key == key &&
+             bucket_count > 0 && (bucket_count & (bucket_count - 1)) == 0 &&
+             UINT64(size.QuadPart) == sizeof(TranspositionFileHeader) + bucket_count * sizeof(Bucket);
+
+        if (ok && bucket_count != m_bucket_mask + 1)
+        {
+            Bucket* buckets = new Bucket[size_t(bucket_count)];
+            ok = (buckets != NULL);
+            if (ok)
+            {
+                delete[] m_buckets;
+                m_buckets = buckets;
+                m_bucket_mask = size_t(bucket_count - 1);
+            }
+        }
+
+        if (ok)
+        {
+            memcpy(m_buckets, header + 1, size_t(bucket_count) * sizeof(Bucket));
+            m_age = BYTE(header->age);
+            clear_statistics();
+        }
+
+        VERIFY_TRUE(UnmapViewOfFile(view));
+    }
+
+    if (!ok)
+    {
+        TRACE(WARNING, "Ignoring unusable search results file %s", file_name);
+    }
+
+    if (mapping)
+    {
+        VERIFY_TRUE(CloseHandle(mapping));
+    }
+    VERIFY_TRUE(CloseHandle(file));
+
+    return ok ? Result::OK : Result::Fail;
+}
@@ -0,0 +1,119 @@
+// transposition.h
+
+#ifndef ENGINE_TRANSPOSITION_H
+#define ENGINE_TRANSPOSITION_H
+
+#include "game.h"  // For Value, ValueBound, GameMove, PositionHash
+
+
+// Largest depth that fits in an entry; deeper results (including the engine's
+// FULLY_ANALYZED marker) are stored as this value.
+#define TT_MAX_DEPTH 0x7fff
+
+// Entries per bucket; 4 entries of 16 bytes fill a typical cache line
+#define TT_BUCKET_SIZE 4
+
+// Format of the files written by TranspositionTable::save()
+#define TT_FILE_VERSION 2
+
+
+//
+// TranspositionTable: a fixed-size, bucketed hash table of search results keyed
+// by PositionHash.  The low bits of a hash select a bucket and the high 32 bits
+// are kept in the entry to tell positions apart within it.
+//
+// Replacement policy: an entry for the same position is always overwritten;
+// otherwise we evict the entry with the lowest depth, counting entries left
+// over from earlier searches (older 'ages') as shallower than they are.
+//
+// The table may be shared by several search threads without locking.  Each
+// entry's check field is XORed with the rest of its contents, so an entry
+// torn by simultaneous writes fails to match any position and is ignored.
+// (The statistics are not synchronized and are only approximate then.)
+//
+// The table can be saved to a file and loaded again by a later run, so that
+// long analyses can be resumed (see GameState::resume_search()).  The file is
+// a header followed by an image of the buckets, which load() maps into memory
+// and copies in one pass.
+//
+
+class TranspositionTable
+{
+public:
+
+    struct Entry
+    {
+        UINT32 check;         // High 32 bits of the position hash, XORed with entry_data()
+        Value value;          // From the point of view of the player to move
+        GameMove best_move;   // Best move found (in the position's canonical image), or INVALID_MOVE
+        short depth;          // Search depth that produced 'value'
+        unsigned char bound;  // A ValueBound (eNoBound for an empty entry)
+        unsigned char age;    // Search generation in which the entry was stored
+    };
+
+    struct Statistics
+    {
+        unsigned __int64 probes;        // Lookups performed
+        unsigned __int64 hits;          // Lookups that found a matching entry
+        unsigned __int64 cutoffs;       // Hits that made searching the position unnecessary
+        unsigned __int64 stores;        // Entries written
+        unsigned __int64 replacements;  // Stores that evicted a different position
+        unsigned __int64 collisions;    // Hits whose best move was illegal (hash collisions)
+    };
+
+    TranspositionTable() : m_buckets(NULL), m_bucket_mask(0), m_age(0) {clear_statistics();}
+    ~TranspositionTable() {delete[] m_buckets;}
+
+    Result allocate(size_t megabytes);
+    void clear();
+    bool allocated() const {return m_buckets != NULL;}
+
+    // 'key' identifies the game and starting position the entries belong to;
+    // load() fails (leaving the table as it was) unless the file was saved
+    // with the same key, and otherwise takes the table's size from the file
+    Result save(const char* file_name, PositionHash key) const;
+    Result load(const char* file_name, PositionHash key);
+
+    // Called at the start of each search so older entries can be recognized
+    void new_search() {++m_age;}
+
+    bool probe(PositionHash hash, __out Entry* entry);
+    void store(PositionHash hash, Value value, ValueBound bound, int depth, GameMove best_move);
+
+    // Converts an entry's depth field back to a search depth
+    static int entry_depth(const Entry& entry) {return entry.depth == TT_MAX_DEPTH ? FULLY_ANALYZED : entry.depth;}
+
+    void record_cutoff() {++m_statistics.cutoffs;}
+    void record_collision() {++m_statistics.collisions;}
+    const Statistics& statistics() const {return m_statistics;}
+    void clear_statistics() {memset(&m_statistics, 0, sizeof m_statistics);}
+
+private:
+
+    struct Bucket
+    {
+        Entry entries[TT_BUCKET_SIZE];
+    };
+
+    Bucket* m_buckets;
+    size_t m_bucket_mask;  // Bucket count - 1 (the count is a power of 2)
+    unsigned char m_age;
+    Statistics m_statistics;
+
+    FORCEINLINE Bucket& bucket_for(PositionHash hash) const {return m_buckets[size_t(hash) & m_bucket_mask];}
+    FORCEINLINE static UINT32 check_for(PositionHash hash) {return UINT32(hash >> 32);}
+
+    // The entry contents folded into its check field; 'age' is left out since
+    // probe() updates it in place
+    FORCEINLINE static UINT32 entry_data(const Entry& entry)
+    {
+        return UINT32(entry.value) ^ UINT32(entry.best_move) ^ (UINT32(USHORT(entry.depth)) | (UINT32(entry.bound) << 16));
+    }
+
+    // Prevent copying
+    TranspositionTable(const TranspositionTable&);
+    TranspositionTable& operator=(const TranspositionTable&);
+};
+
+
+#endif // ENGINE_TRANSPOSITION_H
@@ -2,6 +2,7 @@
 
 #include "shared.h"  // Precompiled header; obligatory
 #include "ataxx.h"   // Our public interface
+#include "searcher.h" // For Searcher
 
 #define RED_SYMBOL " \xf9 "   // Looks right in console window
 #define BLUE_SYMBOL " \x4f "  // Looks right in console window
@@ -19,6 +20,55 @@ static int ataxx_registered =
     );
 
 
+// Zobrist keys used to maintain m_hash_history (blocked cells never change,
+// so they don't need keys)
+
+static struct AtaxxZobristKeys
+{
+    PositionHash cells[2][ATAXX_COLUMNS + 4][ATAXX_ROWS + 4];  // Indexed by [player][x][y]
+    PositionHash red_to_move;
+}
+ataxx_keys;
+
+static int ataxx_keys_generated = generate_zobrist_keys(&ataxx_keys, sizeof ataxx_keys, 0xA7A11002);
+
+// The same keys for each of the board's symmetric images (see canonical_hash()):
+// the key of a cell in image s is the key of the cell symmetry s maps it to.
+// A cell's keys for all the images are kept together, since apply_move()
+// needs them all at once.
+
+static struct AtaxxSymmetricKeys
+{
+    PositionHash cells[2][ATAXX_COLUMNS + 4][ATAXX_ROWS + 4][ATAXX_SYMMETRIES];  // Indexed by [player][x][y][symmetry]
+    PositionHash flips[ATAXX_COLUMNS + 4][ATAXX_ROWS + 4][ATAXX_SYMMETRIES];     // Blue and red keys XORed together
+}
+ataxx_symmetric_keys;
+
+static int generate_ataxx_symmetric_keys()
+{
+    for (int x = 2; x < ATAXX_COLUMNS + 2; ++x)
+    {
+        for (int y = 2; y < ATAXX_ROWS + 2; ++y)
+        {
+            for (int symmetry = 0; symmetry < ATAXX_SYMMETRIES; ++symmetry)
+            {
+                int image_x = x - 2, image_y = y - 2;
+                transform_cell(symmetry, false, ATAXX_COLUMNS, ATAXX_ROWS, &image_x, &image_y);
+
+                PositionHash (&keys)[2][ATAXX_COLUMNS + 4][ATAXX_ROWS + 4][ATAXX_SYMMETRIES] = ataxx_symmetric_keys.cells;
+                keys[eBlue][x][y][symmetry] = ataxx_keys.cells[eBlue][image_x + 2][image_y + 2];
+                keys[eRed][x][y][symmetry] = ataxx_keys.cells[eRed][image_x + 2][image_y + 2];
+                ataxx_symmetric_keys.flips[x][y][symmetry] = keys[eBlue][x][y][symmetry] ^ keys[eRed][x][y][symmetry];
+            }
+        }
+    }
+
+    return ATAXX_SYMMETRIES;
+}
+
+static int ataxx_symmetric_keys_generated = generate_ataxx_symmetric_keys();
+
+
 Result AtaxxGameState::set_initial_position(size_t position_size, __in_bcount(position_size) const char* position)
 {
     static const size_t expected_size = (ATAXX_COLUMNS + 1) * ATAXX_ROWS;  // The +1 allows for newline characters
@@ -45,6 +95,7 @@ void AtaxxGameState::reset()
 
     memset(m_move_history, 0, sizeof m_move_history);
     memset(m_player_cells_history, 0, sizeof m_player_cells_history);
+    memset(m_hash_history, 0, sizeof m_hash_history);
 
     for (int n = 0; n < countof(m_boards); ++n)  // FIXME: Probably don't need to set up EVERY board (same for Othello)
     {
@@ -110,15 +161,47 @@ void AtaxxGameState::reset()
         m_player_cells_history[0][eRed] = 2;
         m_cells_available = ATAXX_COLUMNS * ATAXX_ROWS - 4;
     }
+
+    for (int x = 2; x < ATAXX_COLUMNS + 2; ++x)
+    {
+        for (int y = 2; y < ATAXX_ROWS + 2; ++y)
+        {
+            if (cell(x, y) == eBlue || cell(x, y) == eRed)
+            {
+                for (int symmetry = 0; symmetry < ATAXX_SYMMETRIES; ++symmetry)
+                {
+                    m_hash_history[0][symmetry] ^= ataxx_symmetric_keys.cells[cell(x, y)][x][y][symmetry];
+                }
+            }
+        }
+    }
+
+    // Blocked cells have no keys, so positions are only equivalent under the
+    // symmetries that don't move them
+    m_symmetries = 0;
+    for (int symmetry = 0; symmetry < ATAXX_SYMMETRIES; ++symmetry)
+    {
+        bool blocks_kept = true;
+        for (int x = 2; x < ATAXX_COLUMNS + 2 && blocks_kept; ++x)
+        {
+            for (int y = 2; y < ATAXX_ROWS + 2 && blocks_kept; ++y)
+            {
+                int image_x = x - 2, image_y = y - 2;
+                transform_cell(symmetry, false, ATAXX_COLUMNS, ATAXX_ROWS, &image_x, &image_y);
+                blocks_kept = (cell(x, y) == eBlocked) == (cell(image_x + 2, image_y + 2) == eBlocked);
+            }
+        }
+        if (blocks_kept) m_symmetries |= 1 << symmetry;
+    }
 }
 
 
-GameMove* AtaxxGameState::get_possible_moves() const
-{
-    // Possible moves < cells on board * 24 places each can be approached from (5*5-1)
-    static GameMove move_array[ATAXX_COLUMNS * ATAXX_ROWS * 24];
-    int moves_found = 0;
+// Each empty cell can be reached by up to 16 jump moves and one clone move
+// (the rest being equivalent to it)
+C_ASSERT(ATAXX_COLUMNS * ATAXX_ROWS * 17 <= MAX_POSSIBLE_MOVES);
 
+void AtaxxGameState::get_possible_moves(__out MoveList* moves) const
+{
     if (m_player_cells_history[move_counter()][eBlue] != 0 &&
         m_player_cells_history[move_counter()][eRed] != 0 &&
         m_cells_available != 0)
@@ -127,7 +210,6 @@ GameMove* AtaxxGameState::get_possible_moves() const
             int random_offset = rand();
         #endif
 
-        GameMove* current_move = move_array;
         int cells_left_to_inspect = ATAXX_COLUMNS * ATAXX_ROWS;
 
         while (cells_left_to_inspect--)
@@ -145,7 +227,7 @@ GameMove* AtaxxGameState::get_possible_moves() const
                 // First look for jump moves from any cell two steps away
                 #define CHECK_JUMP_MOVE(i, j) \
                     if (cell(i, j) == player_up()) \
-                        {++moves_found; *current_move++ = encode_move(i, j, x, y);}
+                        moves->add(encode_move(i, j, x, y));
 
                 CHECK_JUMP_MOVE(x-2, y-2);
                 CHECK_JUMP_MOVE(x-2, y-1);
@@ -172,7 +254,7 @@ GameMove* AtaxxGameState::get_possible_moves() const
                 // since all 8 possibilities are equivalent.
                 #define CHECK_CLONE_MOVE(i, j) \
                     if (cell(i, j) == player_up()) \
-                        {++moves_found; *current_move++ = encode_move(i, j, x, y); continue;}
+                        {moves->add(encode_move(i, j, x, y)); continue;}
 
                 CHECK_CLONE_MOVE(x-1, y-1);
                 CHECK_CLONE_MOVE(x-1, y+0);
@@ -187,12 +269,67 @@ GameMove* AtaxxGameState::get_possible_moves() const
             }
         }
     }
+}
+
+
+PositionHash AtaxxGameState::position_hash() const
+{
+    return m_hash_history[move_counter()][0] ^ (player_up() == eRed ? ataxx_keys.red_to_move : 0);
+}
+
+
+PositionHash AtaxxGameState::canonical_hash(__out int* symmetry) const
+{
+    return least_symmetric_hash(m_hash_history[move_counter()], m_symmetries,
+                                player_up() == eRed ? ataxx_keys.red_to_move : 0, symmetry);
+}
+
+
+GameMove AtaxxGameState::transform_move(GameMove move, int symmetry, bool inverse) const
+{
+    if (move == PASSING_MOVE || move == INVALID_MOVE) return move;
+
+    int source_x, source_y, target_x, target_y;
+    decode_move(move, &source_x, &source_y, &target_x, &target_y);
+    const bool clone_move = source_x >= target_x - 1 && source_x <= target_x + 1 &&
+                            source_y >= target_y - 1 && source_y <= target_y + 1;
+
+    source_x -= 2; source_y -= 2; target_x -= 2; target_y -= 2;
+    transform_cell(symmetry, inverse, ATAXX_COLUMNS, ATAXX_ROWS, &source_x, &source_y);
+    transform_cell(symmetry, inverse, ATAXX_COLUMNS, ATAXX_ROWS, &target_x, &target_y);
+    source_x += 2; source_y += 2; target_x += 2; target_y += 2;
+
+    // All clone moves to a cell are equivalent, but get_possible_moves() only
+    // lists the one from the first neighbour it finds; return that one, so
+    // promote_move() can find the move in the current position
+    if (clone_move && inverse)
+    {
+        for (int x = target_x-1; x <= target_x+1; ++x)
+            for (int y = target_y-1; y <= target_y+1; ++y)
+                if (cell(x, y) == player_up()) return encode_move(x, y, target_x, target_y);
+    }
+
+    return encode_move(source_x, source_y, target_x, target_y);
+}
+
+
+GameState* AtaxxGameState::clone() const
+{
+    AtaxxGameState* copy = new AtaxxGameState(*this);
+    copy->m_initial_position = NULL;  // Only used by reset(), which copies never need
+    return copy;
+}
+
+
+Value AtaxxGameState::fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes)
+{
+    return Searcher<AtaxxGameState>(this).search(depth, best_move, nodes);
+}
 
-    GameMove* possible_moves = new GameMove[moves_found + 1];
-    memcpy(possible_moves, move_array, moves_found * sizeof GameMove);
-    possible_moves[moves_found] = INVALID_MOVE;  // Terminate move list for caller convenience
 
-    return possible_moves;
+int AtaxxGameState::evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values)
+{
+    return Searcher<AtaxxGameState>(this).evaluate_moves(moves, values);
 }
 
 
@@ -234,14 +371,15 @@ bool AtaxxGameState::valid_move(GameMove move)
 
     if (move == PASSING_MOVE)
     {
-        GameMove* possible_moves = get_possible_moves();
-        for (GameMove* m = possible_moves; *m; ++m)
+        MoveList possible_moves;
+        get_possible_moves(&possible_moves);
+        for (int n = 0; n < possible_moves.count(); ++n)
         {
-            if (apply_move(*m).ok())
+            if (apply_move(possible_moves[n]).ok())
             {
                 undo_last_move();
                 char move_string[MAX_MOVE_STRING_SIZE];
-                write_move(*m, sizeof move_string, move_string);
+                write_move(possible_moves[n], sizeof move_string, move_string);
                 output("Cannot pass; at least one move is available (%s).\n", move_string);
                 return false;
             }
@@ -293,12 +431,21 @@ Result AtaxxGameState::apply_move(GameMove move)
 
     int player_up_gain = 0;
     int opponent_loss = 0;
+    PositionHash (&hash)[ATAXX_SYMMETRIES] = m_hash_history[move_counter()];  // In each image
+    for (int symmetry = 0; symmetry < ATAXX_SYMMETRIES; ++symmetry)
+    {
+        hash[symmetry] = m_hash_history[move_counter()-1][symmetry] ^ ataxx_symmetric_keys.cells[player_up()][target_x][target_y][symmetry];
+    }
 
     cell(target_x, target_y) = player_up();
     if (source_x == target_x-2 || source_x == target_x+2 ||
         source_y == target_y-2 || source_y == target_y+2)
     {
         cell(source_x, source_y) = eEmpty;
+        for (int symmetry = 0; symmetry < ATAXX_SYMMETRIES; ++symmetry)
+        {
+            hash[symmetry] ^= ataxx_symmetric_keys.cells[player_up()][source_x][source_y][symmetry];
+        }
     }
     else
     {
@@ -315,6 +462,10 @@ Result AtaxxGameState::apply_move(GameMove move)
             if (cell(x, y) == opponent)
             {
                 cell(x, y) = player_up();
+                for (int symmetry = 0; symmetry < ATAXX_SYMMETRIES; ++symmetry)
+                {
+                    hash[symmetry] ^= ataxx_symmetric_keys.flips[x][y][symmetry];
+                }
                 ++player_up_gain;
                 ++opponent_loss;
             }
@@ -352,6 +503,7 @@ Result AtaxxGameState::apply_passing_move()
     m_move_history[move_counter()] = PASSING_MOVE;
     m_player_cells_history[move_counter()+1][eBlue] = m_player_cells_history[move_counter()][eBlue];
     m_player_cells_history[move_counter()+1][eRed] = m_player_cells_history[move_counter()][eRed];
+    memcpy(m_hash_history[move_counter()+1], m_hash_history[move_counter()], sizeof m_hash_history[0]);
     switch_player_up();
     advance_move_counter();
 
@@ -379,6 +531,79 @@ void AtaxxGameState::undo_last_move()
 }
 
 
+//
+// Returns a move to the given cell that captures at least ATAXX_TACTICAL_CAPTURES
+// of the opponent's cells, or INVALID_MOVE if there is none.  A clone move is
+// preferred, since it also keeps the source cell.
+//
+
+GameMove AtaxxGameState::tactical_move(int x, int y) const
+{
+    if (cell(x, y) != eEmpty) return INVALID_MOVE;
+
+    const PlayerCode opponent = (player_up() == eBlue) ? eRed : eBlue;
+    int captures = 0;
+    for (int i = x-1; i <= x+1; ++i)
+        for (int j = y-1; j <= y+1; ++j)
+            captures += (cell(i, j) == opponent);
+
+    if (captures < ATAXX_TACTICAL_CAPTURES) return INVALID_MOVE;
+
+    for (int i = x-1; i <= x+1; ++i)
+        for (int j = y-1; j <= y+1; ++j)
+            if (cell(i, j) == player_up()) return encode_move(i, j, x, y);
+
+    // Jump moves, from the ring two steps away (the double layer of sentinels
+    // keeps us on the board)
+    for (int i = x-2; i <= x+2; ++i)
+        for (int j = y-2; j <= y+2; ++j)
+            if ((i == x-2 || i == x+2 || j == y-2 || j == y+2) && cell(i, j) == player_up())
+                return encode_move(i, j, x, y);
+
+    return INVALID_MOVE;
+}
+
+
+bool AtaxxGameState::is_quiet() const
+{
+    for (int x = 2; x < ATAXX_COLUMNS + 2; ++x)
+        for (int y = 2; y < ATAXX_ROWS + 2; ++y)
+            if (tactical_move(x, y) != INVALID_MOVE) return false;
+
+    return true;
+}
+
+
+void AtaxxGameState::generate_tactical_moves(__out MoveList* moves) const
+{
+    for (int x = 2; x < ATAXX_COLUMNS + 2; ++x)
+    {
+        for (int y = 2; y < ATAXX_ROWS + 2; ++y)
+        {
+            GameMove move = tactical_move(x, y);
+            if (move != INVALID_MOVE) moves->add(move);
+        }
+    }
+}
+
+
+// Forward pruning margins, by search depth remaining.  A single move can gain
+// up to 17 cells of advantage (a clone move capturing 8 cells), but 3 or 4 is
+// more usual.
+static const Value ataxx_futility_margins[FORWARD_PRUNING_DEPTHS] = {4, 8, 12};
+static const Value ataxx_razoring_margins[FORWARD_PRUNING_DEPTHS] = {4, 8, 12};
+
+const Value* AtaxxGameState::futility_margins() const {return ataxx_futility_margins;}
+const Value* AtaxxGameState::razoring_margins() const {return ataxx_razoring_margins;}
+
+
+// Late move reductions, by position in the move list.  Positions commonly
+// have dozens of moves, most of them jumps that only give cells away.
+static const BYTE ataxx_late_move_reductions[LMR_TABLE_SIZE] = {0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2};
+
+const BYTE* AtaxxGameState::late_move_reductions() const {return ataxx_late_move_reductions;}
+
+
 // Simplistic position evaluation, but good enough to trounce most humans
 Value AtaxxGameState::position_val() const
 {
@@ -31,14 +31,16 @@ public:
 
     // GameState method overrides
 
+    virtual GameAttributes game_attributes() const {return GameAttributes(eVolatile | eNullMovePruning | eFutilityPruning | eRazoring);}
     virtual const char* get_player_name(PlayerCode p) const {return p == eBlue ? "Blue" : "Red";}
     virtual Result set_initial_position(size_t n, __in_bcount(n) const char*);
     virtual void reset();
-    virtual GameMove* get_possible_moves() const;
+    virtual void get_possible_moves(__out MoveList*) const;
     virtual Result apply_move(GameMove);
     virtual Result apply_passing_move();
     virtual void undo_last_move();
     virtual bool game_over();
+    virtual int expected_moves_left() const {return m_cells_available;}  // Allowing for jumps, which fill no cell
     virtual void display(size_t size, __out_ecount(size) char*) const;
     virtual void display_score_sheet(bool, size_t size, __out_ecount(size) char*) const;
 
@@ -68,6 +70,18 @@ public:
                ((clone_move_1 && clone_move_2) ||
                 (source_x_1 == source_x_2 && source_y_1 == source_y_2));
     }
+    virtual int move_index_count() const {return ATAXX_COLUMNS * ATAXX_ROWS * 25;}
+    virtual int move_index(GameMove move) const
+    {
+        // Target cell, then source cell relative to it in the surrounding 5x5
+        // square; all (equivalent) clone moves share the centre's number
+        if (move == PASSING_MOVE) return -1;
+        int source_x, source_y, target_x, target_y;
+        decode_move(move, &source_x, &source_y, &target_x, &target_y);
+        int dx = source_x - target_x, dy = source_y - target_y;
+        if (dx >= -1 && dx <= 1 && dy >= -1 && dy <= 1) dx = dy = 0;
+        return ((target_x-2) * ATAXX_ROWS + (target_y-2)) * 25 + (dx+2) * 5 + (dy+2);
+    }
     FORCEINLINE GameMove encode_move(int source_x, int source_y, int target_x, int target_y) const
     {
         return GameMove(target_x | (target_y << 8) | (source_x << 16) | (source_y << 24));
@@ -86,6 +100,18 @@ public:
         int blue_advantage = m_player_cells_history[move_counter()][eBlue] - m_player_cells_history[move_counter()][eRed];
         return blue_advantage + (blue_advantage > 0 ? VICTORY_VALUE : blue_advantage < 0 ? -VICTORY_VALUE : 0);
     }
+    virtual Value aspiration_window() const {return 10;}  // A few captures' worth of cells
+    virtual bool is_quiet() const;
+    virtual void generate_tactical_moves(__out MoveList*) const;
+    virtual const Value* futility_margins() const;
+    virtual const Value* razoring_margins() const;
+    virtual const BYTE* late_move_reductions() const;
+    virtual PositionHash position_hash() const;
+    virtual PositionHash canonical_hash(__out int* symmetry) const;
+    virtual GameMove transform_move(GameMove move, int symmetry, bool inverse) const;
+    virtual GameState* clone() const;
+    virtual Value fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes);
+    virtual int evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values);
 
 private:
 
@@ -95,6 +121,11 @@ private:
     int m_cells_available;
     GameMove m_move_history[ATAXX_MAX_GAME_LENGTH];
     int m_player_cells_history[ATAXX_MAX_GAME_LENGTH][2];
+    // Rotations through 90 degrees need a square board
+    #define ATAXX_SYMMETRIES (ATAXX_COLUMNS == ATAXX_ROWS ? BOARD_SYMMETRIES : 4)
+    PositionHash m_hash_history[ATAXX_MAX_GAME_LENGTH][ATAXX_SYMMETRIES];  // Hashes of the board's symmetric images
+                                                                           // (not including player to move); [0] is the board's own
+    unsigned m_symmetries;  // Bit mask of the symmetries that leave the blocked cells where they are
 
     struct Board
     {
@@ -106,6 +137,8 @@ private:
     FORCEINLINE CellState& cell(int x, int y) {return m_boards[move_counter()].m_cells[x][y];}
     FORCEINLINE CellState cell(int x, int y) const {return m_boards[move_counter()].m_cells[x][y];}
 
+    GameMove tactical_move(int x, int y) const;
+
     AtaxxGameState() : m_initial_position(NULL) {reset();}
 };
 
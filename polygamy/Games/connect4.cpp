@@ -2,6 +2,7 @@
 
 #include "shared.h"         // Precompiled header; obligatory
 #include "connect4.h"       // Our public interface
+#include "searcher.h"       // For Searcher
 
 #define RED_SYMBOL '\xf9'   // Looks right in console window
 #define BLUE_SYMBOL '\x4f'  // Looks right in console window
@@ -19,21 +20,78 @@ static int connect4_registered =
     );
 
 
+// Zobrist keys used to maintain m_hash_history
+
+static struct Connect4ZobristKeys
+{
+    PositionHash cells[2][CONNECT4_COLUMNS][CONNECT4_ROWS];  // Indexed by [player][x][y]
+    PositionHash red_to_move;
+}
+connect4_keys;
+
+static int connect4_keys_generated = generate_zobrist_keys(&connect4_keys, sizeof connect4_keys, 0xC4C41003);
+
+// The same keys for the board and its mirror image (see canonical_hash())
+
+static PositionHash connect4_symmetric_keys[2][CONNECT4_COLUMNS][CONNECT4_ROWS][CONNECT4_SYMMETRIES];  // Indexed by [player][x][y][symmetry]
+
+static int generate_connect4_symmetric_keys()
+{
+    for (int x = 0; x < CONNECT4_COLUMNS; ++x)
+    {
+        for (int y = 0; y < CONNECT4_ROWS; ++y)
+        {
+            for (int symmetry = 0; symmetry < CONNECT4_SYMMETRIES; ++symmetry)
+            {
+                int image_x = x, image_y = y;
+                transform_cell(symmetry, false, CONNECT4_COLUMNS, CONNECT4_ROWS, &image_x, &image_y);
+                connect4_symmetric_keys[eBlue][x][y][symmetry] = connect4_keys.cells[eBlue][image_x][image_y];
+                connect4_symmetric_keys[eRed][x][y][symmetry] = connect4_keys.cells[eRed][image_x][image_y];
+            }
+        }
+    }
+
+    return CONNECT4_SYMMETRIES;
+}
+
+static int connect4_symmetric_keys_generated = generate_connect4_symmetric_keys();
+
+
 void Connect4GameState::reset()
 {
     GameState::reset();
 
     m_winner = -1;
     memset(m_move_history, 0, sizeof m_move_history);
+    memset(m_hash_history, 0, sizeof m_hash_history);  // Empty board
     memset(m_board, eEmpty, sizeof m_board);
 }
 
 
-GameMove* Connect4GameState::get_possible_moves() const
+PositionHash Connect4GameState::position_hash() const
 {
-    GameMove* possible_moves = new GameMove[CONNECT4_COLUMNS + 1];
-    GameMove* current_move = possible_moves;
+    return m_hash_history[move_counter()][0] ^ (player_up() == eRed ? connect4_keys.red_to_move : 0);
+}
 
+
+PositionHash Connect4GameState::canonical_hash(__out int* symmetry) const
+{
+    return least_symmetric_hash(m_hash_history[move_counter()], (1 << CONNECT4_SYMMETRIES) - 1,
+                                player_up() == eRed ? connect4_keys.red_to_move : 0, symmetry);
+}
+
+
+GameMove Connect4GameState::transform_move(GameMove move, int symmetry, bool inverse) const
+{
+    UNREFERENCED_PARAMETER(inverse);  // The mirror image undoes itself
+    return (move == INVALID_MOVE || symmetry == 0) ? move : GameMove(CONNECT4_COLUMNS + 1 - move);
+}
+
+
+C_ASSERT(CONNECT4_COLUMNS <= MAX_POSSIBLE_MOVES);
+
+void Connect4GameState::get_possible_moves(__out MoveList* moves) const
+{
     // There are no legal moves if someone has already won
     if (m_winner == -1)
     {
@@ -45,16 +103,12 @@ GameMove* Connect4GameState::get_possible_moves() const
 
         for (int col = start_col; col < CONNECT4_COLUMNS; ++col)
             if (m_board[col][CONNECT4_ROWS-1] == eEmpty)
-                *current_move++ = GameMove(col+1);
+                moves->add(GameMove(col+1));
 
         for (int col = 0; col < start_col; ++col)
             if (m_board[col][CONNECT4_ROWS-1] == eEmpty)
-                *current_move++ = GameMove(col+1);
+                moves->add(GameMove(col+1));
     }
-
-    *current_move = INVALID_MOVE;  // Terminate move list for caller convenience
-
-    return possible_moves;
 }
 
 
@@ -175,6 +229,11 @@ Result Connect4GameState::apply_move(GameMove move)
 
     m_move_history[move_counter()].x = short(x);
     m_move_history[move_counter()].y = short(y);
+    for (int symmetry = 0; symmetry < CONNECT4_SYMMETRIES; ++symmetry)
+    {
+        m_hash_history[move_counter()+1][symmetry] = m_hash_history[move_counter()][symmetry] ^
+                                                     connect4_symmetric_keys[player_up()][x][y][symmetry];
+    }
     advance_move_counter();
     switch_player_up();
 
@@ -273,3 +332,15 @@ const char* Connect4GameState::get_cell_state_image_name(int state) const
     return state == eBlue ? "Connect4Blue" :
            state == eRed  ? "Connect4Red"  : "Connect4Empty";
 }
+
+
+Value Connect4GameState::fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes)
+{
+    return Searcher<Connect4GameState>(this).search(depth, best_move, nodes);
+}
+
+
+int Connect4GameState::evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values)
+{
+    return Searcher<Connect4GameState>(this).evaluate_moves(moves, values);
+}
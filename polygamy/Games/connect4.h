@@ -29,10 +29,11 @@ public:
     // GameState method overrides
     virtual const char* get_player_name(PlayerCode p) const {return p == eBlue ? "Blue" : "Red";}
     virtual void reset();
-    virtual GameMove* get_possible_moves() const;
+    virtual void get_possible_moves(__out MoveList*) const;
     virtual Result apply_move(GameMove);
     virtual void undo_last_move();
     virtual bool game_over();
+    virtual int expected_moves_left() const {return (CONNECT4_COLUMNS * CONNECT4_ROWS - move_counter() + 1) / 2;}
     virtual void display(size_t size, __out_ecount(size) char*) const;
     virtual void display_score_sheet(bool, size_t size, __out_ecount(size) char*) const;
 
@@ -47,16 +48,28 @@ public:
     virtual GameMove read_move(const char*) const;
     virtual void write_move(GameMove, int size, __in_ecount(size) char*) const;
     virtual bool valid_move(GameMove);
+    virtual int move_index_count() const {return CONNECT4_COLUMNS;}
+    virtual int move_index(GameMove move) const {return move - 1;}  // Column number
 
     // Position value management
     virtual Value position_val() const;
     virtual PlayerCode player_ahead() const {return m_winner;}
+    virtual PositionHash position_hash() const;
+    virtual PositionHash canonical_hash(__out int* symmetry) const;
+    virtual GameMove transform_move(GameMove move, int symmetry, bool inverse) const;
+    virtual GameState* clone() const {return new Connect4GameState(*this);}
+    virtual Value fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes);
+    virtual int evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values);
 
 private:
 
     PlayerCode m_winner;
     CellState m_board[CONNECT4_COLUMNS][CONNECT4_ROWS];
     Cell m_move_history[CONNECT4_COLUMNS * CONNECT4_ROWS];
+    // Gravity rules out all the board's symmetries except the left-right mirror image
+    #define CONNECT4_SYMMETRIES 2
+    PositionHash m_hash_history[CONNECT4_COLUMNS * CONNECT4_ROWS + 1][CONNECT4_SYMMETRIES];  // Hashes of the board and its mirror
+                                                                                             // image (not including player to move)
 
     Connect4GameState() {reset();}
 };
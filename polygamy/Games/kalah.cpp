@@ -2,11 +2,25 @@
 
 #include "shared.h"  // Precompiled header; obligatory
 #include "kalah.h"   // Our public interface
+#include "kalahdb.h" // For KalahDatabase
+#include "searcher.h" // For Searcher
+
+
+// Endgame database shared by all games, mapped by creator()
+static KalahDatabase kalah_database;
 
 
 // Game registration stuff
 
-GameState* KalahGameState::creator() {return new KalahGameState;}
+GameState* KalahGameState::creator()
+{
+    // Map the endgame database, if there is one
+    if (kalah_database.max_seeds() < 0)
+    {
+        kalah_database.open(KALAH_DATABASE_FILE);
+    }
+    return new KalahGameState;
+}
 
 static int kalah_registered =
     register_game
@@ -16,6 +30,19 @@ static int kalah_registered =
     );
 
 
+// Zobrist keys used to maintain m_hash_history
+
+static struct KalahZobristKeys
+{
+    PositionHash seeds[2 * KALAH_PITS + 2][2 * KALAH_PITS * KALAH_SEEDS + 1];  // Indexed by [pit][seed count]
+    PositionHash second_player_to_move;
+    PositionHash forced_pass;
+}
+kalah_keys;
+
+static int kalah_keys_generated = generate_zobrist_keys(&kalah_keys, sizeof kalah_keys, 0x6A1A5005);
+
+
 void KalahGameState::reset()
 {
     GameState::reset();
@@ -28,15 +55,88 @@ void KalahGameState::reset()
     }
 
     memset(m_move_history, 0, sizeof m_move_history);
+    memset(m_hash_history, 0, sizeof m_hash_history);
+    m_hash_history[0] = hash_state(m_states[0]);
     m_forced_pass = false;
 }
 
 
-GameMove* KalahGameState::get_possible_moves() const
+//
+// A sowing move can change any number of pits, so rather than update the hash
+// pit by pit we rehash the whole state in apply_move() (only 14 lookups with
+// the default settings); undo_last_move() then just steps back in the history.
+//
+
+PositionHash KalahGameState::hash_state(const int (&state)[2 * KALAH_PITS + 2])
+{
+    PositionHash hash = 0;
+    for (int n = 0; n < 2 * KALAH_PITS + 2; ++n)
+    {
+        hash ^= kalah_keys.seeds[n][state[n]];
+    }
+    return hash;
+}
+
+
+PositionHash KalahGameState::position_hash() const
+{
+    return m_hash_history[move_counter()] ^
+           (player_up() == 1 ? kalah_keys.second_player_to_move : 0) ^
+           (m_forced_pass ? kalah_keys.forced_pass : 0);
+}
+
+
+Result KalahGameState::build_endgame_database(int threads)
+{
+    kalah_database.close();  // Unmap the file we may be about to rewrite
+    Result result = KalahDatabase::build(KALAH_DATABASE_FILE, KALAH_DATABASE_SEEDS, threads, this);
+    kalah_database.open(KALAH_DATABASE_FILE);
+    return result;
+}
+
+
+bool KalahGameState::endgame_solvable(int) const
 {
-    GameMove* possible_moves = new GameMove[KALAH_PITS+1];
-    GameMove* current_move = possible_moves;
+    // A lookup is cheap enough to be worth it at any depth
+    int seeds = seeds_in_play();
+    return seeds > 0 && seeds <= kalah_database.max_seeds();
+}
+
+
+//
+// Returns the rest of the game's worth to player 0, in seeds, if the endgame
+// database covers the current position; otherwise 0.  This makes
+// position_val() exact wherever it can be.
+//
+
+int KalahGameState::database_value() const
+{
+    int seeds = seeds_in_play();
+    if (seeds == 0 || seeds > kalah_database.max_seeds()) return 0;
+
+    // After a move into its own store, a player's opponent must pass, so
+    // that player is the next to move
+    const PlayerCode mover = m_forced_pass ? !player_up() : player_up();
+    const int* state = m_states[move_counter()];
+    const int* own_pits = state + (mover == 0 ? 0 : KALAH_PITS + 1);
+    const int* opponent_pits = state + (mover == 0 ? KALAH_PITS + 1 : 0);
+
+    int pits[2 * KALAH_PITS];
+    for (int n = 0; n < KALAH_PITS; ++n)
+    {
+        pits[n] = own_pits[n];
+        pits[n + KALAH_PITS] = opponent_pits[n];
+    }
+
+    int value = kalah_database.probe(pits);
+    return mover == 0 ? value : -value;
+}
+
+
+C_ASSERT(KALAH_PITS <= MAX_POSSIBLE_MOVES);
 
+void KalahGameState::get_possible_moves(__out MoveList* moves) const
+{
     if (!m_forced_pass)
     {
         int first_pit = (player_up() == 0) ? 0 : KALAH_PITS+1;
@@ -44,14 +144,10 @@ GameMove* KalahGameState::get_possible_moves() const
         {
             if (m_states[move_counter()][first_pit + n] != 0)
             {
-                *current_move++ = n+1;
+                moves->add(n+1);
             }
         }
     }
-
-    *current_move = INVALID_MOVE;  // Terminate move list for caller convenience
-
-    return possible_moves;
 }
 
 
@@ -180,6 +276,8 @@ Result KalahGameState::apply_move(GameMove move)
         state[2*KALAH_PITS+1] += player_1_total;
     }
 
+    m_hash_history[move_counter()] = hash_state(state);
+
     switch_player_up();
 
     return Result::OK;
@@ -196,6 +294,7 @@ Result KalahGameState::apply_passing_move()
     m_move_history[move_counter()] = PASSING_MOVE;
     advance_move_counter();
     memcpy(m_states[move_counter()], m_states[move_counter()-1], sizeof *m_states);
+    m_hash_history[move_counter()] = m_hash_history[move_counter()-1];
     m_forced_pass = false;
     switch_player_up();
 
@@ -356,4 +455,16 @@ int KalahGameState::get_cell_state(int row, int column) const
         int seeds = m_states[move_counter()][column - 1];
         return seeds <= 20 ? seeds + 1 : 22;
     }
-}
\ No newline at end of file
+}
+
+
+Value KalahGameState::fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes)
+{
+    return Searcher<KalahGameState>(this).search(depth, best_move, nodes);
+}
+
+
+int KalahGameState::evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values)
+{
+    return Searcher<KalahGameState>(this).evaluate_moves(moves, values);
+}
@@ -27,7 +27,7 @@ public:
 
     // GameState method overrides
     virtual void reset();
-    virtual GameMove* get_possible_moves() const;
+    virtual void get_possible_moves(__out MoveList*) const;
     virtual Result apply_move(GameMove);
     virtual Result apply_passing_move();
     virtual void undo_last_move();
@@ -47,14 +47,25 @@ public:
     virtual GameMove read_move(const char*) const;
     virtual void write_move(GameMove, int size, __in_ecount(size) char*) const;
     virtual bool valid_move(GameMove);
+    virtual int move_index_count() const {return KALAH_PITS;}
+    virtual int move_index(GameMove move) const {return move == PASSING_MOVE ? -1 : move - 1;}  // Pit number
 
     // Position value management
     virtual Value position_val() const
     {
         int player0_store = m_states[move_counter()][KALAH_PITS];
         int player1_store = m_states[move_counter()][2 * KALAH_PITS + 1];
-        return player0_store - player1_store;
+        return player0_store - player1_store + database_value();
     }
+    virtual PositionHash position_hash() const;
+    virtual GameState* clone() const {return new KalahGameState(*this);}
+    virtual Value fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes);
+    virtual int evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values);
+
+    // Endgame database (see kalahdb.h)
+    virtual Result build_endgame_database(int threads);
+    virtual bool endgame_solvable(int) const;
+    virtual Value solve_endgame(Value, Value) {return player_up() == 0 ? position_val() : -position_val();}
 
 private:
 
@@ -62,10 +73,16 @@ private:
     #define KALAH_MAX_GAME_LENGTH (5 * KALAH_PITS * KALAH_SEEDS)  // More than enough
     int m_states[KALAH_MAX_GAME_LENGTH][2 * KALAH_PITS + 2];
     GameMove m_move_history[KALAH_MAX_GAME_LENGTH];
+    PositionHash m_hash_history[KALAH_MAX_GAME_LENGTH];  // Hash of the pits and stores only
     bool m_forced_pass;
 
     // Internal methods
     KalahGameState() {reset();}
+    static PositionHash hash_state(const int (&state)[2 * KALAH_PITS + 2]);
+    int seeds_in_play() const {return 2 * KALAH_PITS * KALAH_SEEDS - m_states[move_counter()][KALAH_PITS] - m_states[move_counter()][2 * KALAH_PITS + 1];}
+    int database_value() const;
+
+    friend class KalahDatabase;  // For output()
 };
 
 #endif // GAMES_KALAH_H
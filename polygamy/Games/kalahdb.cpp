@@ -0,0 +1,417 @@
+// kalahdb.cpp
+
+#include "shared.h"   // Precompiled header; obligatory
+#include "kalahdb.h"  // Our public interface
+#include "scheduler.h" // For TaskScheduler
+
+
+#define KALAH_DATABASE_SIGNATURE "KALAHEDB"  // 8 characters, without a terminator
+#define KALAH_ALL_SEEDS (2 * KALAH_PITS * KALAH_SEEDS)
+#define KALAH_DATABASE_SEED_LIMIT (KALAH_ALL_SEEDS < 127 ? KALAH_ALL_SEEDS : 127)  // Values must fit in a signed byte
+#define KALAH_UNKNOWN_VALUE (-128)  // Table entries not yet computed by build()
+#define KALAH_TASK_POSITIONS 0x4000  // build() splits its work into tasks of at most this many positions
+
+
+// Binomial coefficients, indexed by [n][k]
+static UINT64 binomials[KALAH_ALL_SEEDS + 2 * KALAH_PITS + 1][2 * KALAH_PITS + 1];
+
+static int build_binomials()
+{
+    for (int n = 0; n < countof(binomials); ++n)
+    {
+        binomials[n][0] = 1;
+        for (int k = 1; k < countof(binomials[n]); ++k)
+        {
+            binomials[n][k] = (n == 0) ? 0 : binomials[n - 1][k - 1] + binomials[n - 1][k];
+        }
+    }
+    return countof(binomials);
+}
+
+static int binomials_built = build_binomials();
+
+
+//
+// Positions are numbered by laying their seeds out in a row, with a divider
+// between each pit and the next, and taking the colexicographic rank of the
+// set of places the dividers occupy.  This numbers the positions with a given
+// number of seeds densely; those with fewer seeds come first.
+//
+
+UINT64 KalahDatabase::rank(const int* pits)
+{
+    UINT64 index = 0;
+    int place = -1;
+
+    for (int n = 0; n < 2 * KALAH_PITS - 1; ++n)
+    {
+        place += pits[n] + 1;
+        index += binomials[place][n + 1];
+    }
+
+    const int seeds = place - (2 * KALAH_PITS - 2) + pits[2 * KALAH_PITS - 1];
+    return binomials[seeds + 2 * KALAH_PITS - 1][2 * KALAH_PITS] + index;
+}
+
+
+static bool valid_header(const KalahDatabase::Header& header)
+{
+    return memcmp(header.signature, KALAH_DATABASE_SIGNATURE, sizeof header.signature) == 0 &&
+           header.version == KALAH_DATABASE_VERSION &&
+           header.pits == KALAH_PITS &&
+           header.completed_seeds <= KALAH_DATABASE_SEED_LIMIT + 1;
+}
+
+
+Result KalahDatabase::open(const char* file_name)
+{
+    TRACE_VOID_METHOD();
+
+    close();
+
+    m_file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return Result::Fail;  // No database; not an error
+    }
+
+    LARGE_INTEGER size;
+    if (GetFileSizeEx(m_file, &size) && UINT64(size.QuadPart) >= sizeof(Header))
+    {
+        m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (m_mapping)
+        {
+            m_view = MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+        }
+    }
+
+    if (m_view)
+    {
+        const Header* header = static_cast<const Header*>(m_view);
+        if (valid_header(*header) && header->completed_seeds > 0 &&
+            UINT64(size.QuadPart) >= sizeof(Header) + binomials[header->completed_seeds + 2 * KALAH_PITS - 1][2 * KALAH_PITS])
+        {
+            m_values = reinterpret_cast<const signed char*>(header + 1);
+            m_max_seeds = header->completed_seeds - 1;
+            return Result::OK;
+        }
+    }
+
+    TRACE(WARNING, "Ignoring unusable Kalah endgame database %s", file_name);
+    close();
+    return Result::Fail;
+}
+
+
+void KalahDatabase::close()
+{
+    if (m_view)
+    {
+        VERIFY_TRUE(UnmapViewOfFile(m_view));
+    }
+    if (m_mapping)
+    {
+        VERIFY_TRUE(CloseHandle(m_mapping));
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        VERIFY_TRUE(CloseHandle(m_file));
+    }
+
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+    m_view = NULL;
+    m_values = NULL;
+    m_max_seeds = -1;
+}
+
+
+//
+// The builder.  Moves that put no seeds in a store or take none by capture
+// leave the number of seeds in play unchanged, but they always carry seeds
+// closer to the store at the end of their side of the board, so they can
+// never repeat a position.  The positions with each number of seeds can thus
+// be solved in turn, by a memoized search that looks up any move removing
+// seeds from play in the tables already completed, and otherwise recurses.
+// Threads take a share each of the positions with the current number of
+// seeds.  If two of them solve the same one they store the same value, so
+// they need no locking.
+//
+
+// Makes a move from 'pit' for the player whose pits are state[0 .. KALAH_PITS-1],
+// with the rules of KalahGameState::apply_move().  Returns whether that player
+// gets another move.
+static bool sow(int (&state)[2 * KALAH_PITS + 2], int pit)
+{
+    int seeds_remaining = state[pit];
+    int current_pit = pit;
+    state[pit] = 0;
+
+    while (seeds_remaining--)
+    {
+        current_pit = (current_pit + 1) % (2 * KALAH_PITS + 1);  // Skipping the opponent's store
+        ++state[current_pit];
+    }
+
+    if (current_pit < KALAH_PITS && state[current_pit] == 1 && state[2 * KALAH_PITS - current_pit] != 0)
+    {
+        state[KALAH_PITS] += state[2 * KALAH_PITS - current_pit] + 1;
+        state[2 * KALAH_PITS - current_pit] = 0;
+        state[current_pit] = 0;
+    }
+
+    int player_0_total = 0, player_1_total = 0;
+    for (int n = 0; n < KALAH_PITS; ++n)
+    {
+        player_0_total += state[n];
+        player_1_total += state[n + KALAH_PITS + 1];
+    }
+    if (player_0_total == 0 || player_1_total == 0)
+    {
+        for (int n = 0; n < KALAH_PITS; ++n)
+        {
+            state[n] = state[n + KALAH_PITS + 1] = 0;
+        }
+        state[KALAH_PITS] += player_0_total;
+        state[2 * KALAH_PITS + 1] += player_1_total;
+    }
+
+    return current_pit == KALAH_PITS;
+}
+
+
+static int solve_position(volatile signed char* values, const int* pits)
+{
+    volatile signed char& entry = values[KalahDatabase::rank(pits)];
+    if (entry != KALAH_UNKNOWN_VALUE) return entry;
+
+    int own_total = 0, opponent_total = 0;
+    for (int n = 0; n < KALAH_PITS; ++n)
+    {
+        own_total += pits[n];
+        opponent_total += pits[n + KALAH_PITS];
+    }
+
+    // A side with no seeds ends the game (such positions only arise here)
+    int best = own_total - opponent_total;
+
+    if (own_total != 0 && opponent_total != 0)
+    {
+        best = -KALAH_ALL_SEEDS - 1;
+
+        for (int pit = 0; pit < KALAH_PITS; ++pit)
+        {
+            if (pits[pit] == 0) continue;
+
+            int state[2 * KALAH_PITS + 2];
+            for (int n = 0; n < KALAH_PITS; ++n)
+            {
+                state[n] = pits[n];
+                state[n + KALAH_PITS + 1] = pits[n + KALAH_PITS];
+            }
+            state[KALAH_PITS] = state[2 * KALAH_PITS + 1] = 0;
+
+            const bool moves_again = sow(state, pit);
+            int value = state[KALAH_PITS] - state[2 * KALAH_PITS + 1];
+
+            if (state[KALAH_PITS] + state[2 * KALAH_PITS + 1] < own_total + opponent_total)
+            {
+                // Continue from the point of view of whoever moves next
+                int next_pits[2 * KALAH_PITS];
+                for (int n = 0; n < KALAH_PITS; ++n)
+                {
+                    next_pits[n] = state[moves_again ? n : n + KALAH_PITS + 1];
+                    next_pits[n + KALAH_PITS] = state[moves_again ? n + KALAH_PITS + 1 : n];
+                }
+                value += moves_again ? solve_position(values, next_pits) : -solve_position(values, next_pits);
+            }
+
+            best = max(best, value);
+        }
+    }
+
+    entry = static_cast<signed char>(best);
+    return best;
+}
+
+
+// Solves 'count' positions with 'seeds' seeds in play, starting from the one
+// with index 'first' among them
+static void solve_positions(volatile signed char* values, int seeds, UINT64 first, UINT64 count)
+{
+    // Find the first position's dividers (see rank())
+    int dividers[2 * KALAH_PITS - 1];
+    UINT64 remainder = first;
+    for (int n = 2 * KALAH_PITS - 2; n >= 0; --n)
+    {
+        int place = n;
+        while (binomials[place + 1][n + 1] <= remainder) ++place;
+        dividers[n] = place;
+        remainder -= binomials[place][n + 1];
+    }
+
+    while (count--)
+    {
+        int pits[2 * KALAH_PITS];
+        int previous = -1;
+        for (int n = 0; n < 2 * KALAH_PITS - 1; ++n)
+        {
+            pits[n] = dividers[n] - previous - 1;
+            previous = dividers[n];
+        }
+        pits[2 * KALAH_PITS - 1] = seeds + 2 * KALAH_PITS - 2 - previous;
+
+        solve_position(values, pits);
+
+        // Step to the next set of dividers in colexicographic order
+        int n = 0;
+        while (n < 2 * KALAH_PITS - 2 && dividers[n] + 1 == dividers[n + 1]) ++n;
+        ++dividers[n];
+        for (int m = 0; m < n; ++m) dividers[m] = m;
+    }
+}
+
+
+// Solves a range of the positions with a given number of seeds.  A range of
+// more than KALAH_TASK_POSITIONS is split in half, and one half is offered to
+// the other threads, so that threads whose positions solve quickly can steal
+// work from the others instead of waiting for them.
+class KalahDatabaseTask : public SchedulerTask
+{
+public:
+
+    KalahDatabaseTask(signed char* values, int seeds, UINT64 first, UINT64 count)
+      : m_values(values), m_seeds(seeds), m_first(first), m_count(count) {}
+
+private:
+
+    signed char* m_values;
+    int m_seeds;
+    UINT64 m_first, m_count;
+
+    void Execute(TaskContext& context)
+    {
+        if (m_count <= KALAH_TASK_POSITIONS)
+        {
+            solve_positions(m_values, m_seeds, m_first, m_count);
+            return;
+        }
+
+        const UINT64 half = m_count / 2;
+        KalahDatabaseTask first_half(m_values, m_seeds, m_first, half);
+        KalahDatabaseTask second_half(m_values, m_seeds, m_first + half, m_count - half);
+        context.ForkJoin(&second_half, &first_half);
+    }
+};
+
+
+// Reads or writes part of the database file (ReadFile() and WriteFile() take
+// 32-bit sizes)
+static bool transfer(HANDLE file, UINT64 offset, void* data, UINT64 size, bool write)
+{
+    LARGE_INTEGER position;
+    position.QuadPart = LONGLONG(offset);
+    if (!SetFilePointerEx(file, position, NULL, FILE_BEGIN)) return false;
+
+    char* pointer = static_cast<char*>(data);
+    while (size > 0)
+    {
+        DWORD chunk = DWORD(min(size, UINT64(1) << 30)), done = 0;
+        if (!(write ? WriteFile(file, pointer, chunk, &done, NULL) : ReadFile(file, pointer, chunk, &done, NULL)) || done != chunk)
+        {
+            return false;
+        }
+        pointer += chunk;
+        size -= chunk;
+    }
+    return true;
+}
+
+
+Result KalahDatabase::build(const char* file_name, int max_seeds, int threads, const KalahGameState* reporter)
+{
+    TRACE_VOID_METHOD();
+
+    if (max_seeds < 0 || max_seeds > KALAH_DATABASE_SEED_LIMIT)
+    {
+        reporter->output("Can't build a Kalah endgame database for %d seeds (the limit is %d).\n", max_seeds, KALAH_DATABASE_SEED_LIMIT);
+        return Result::Fail;
+    }
+
+    HANDLE file = CreateFileA(file_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        reporter->output("Failed to open \"%s\"; error %u\n", file_name, GetLastError());
+        return Result::Fail;
+    }
+
+    const UINT64 size = binomials[max_seeds + 2 * KALAH_PITS][2 * KALAH_PITS];
+    signed char* values = new signed char[size_t(size)];
+    if (values == NULL)
+    {
+        CloseHandle(file);
+        return Result::Fail;
+    }
+    memset(values, KALAH_UNKNOWN_VALUE, size_t(size));
+
+    // Pick up where any earlier build left off
+    Header header;
+    int completed_seeds = 0;
+    if (transfer(file, 0, &header, sizeof header, false) && valid_header(header))
+    {
+        completed_seeds = min(int(header.completed_seeds), max_seeds + 1);
+        if (!transfer(file, sizeof header, values, binomials[completed_seeds + 2 * KALAH_PITS - 1][2 * KALAH_PITS], false))
+        {
+            completed_seeds = 0;
+        }
+        else if (completed_seeds > 0)
+        {
+            reporter->output("Resuming the Kalah endgame database from %d seeds.\n", completed_seeds);
+        }
+    }
+
+    memcpy(header.signature, KALAH_DATABASE_SIGNATURE, sizeof header.signature);
+    header.version = KALAH_DATABASE_VERSION;
+    header.pits = KALAH_PITS;
+    header.target_seeds = UINT32(max_seeds);
+    header.completed_seeds = UINT32(completed_seeds);
+    bool ok = transfer(file, 0, &header, sizeof header, true);
+
+    // (A scheduler with just this thread can't fail to start)
+    TaskScheduler scheduler;
+    if (FAILED(scheduler.Initialize(max(1, min(threads, MAX_SEARCH_THREADS)))))
+    {
+        reporter->output("Failed to start %d threads; building the Kalah endgame database with one.\n", threads);
+        VERIFY(scheduler.Initialize(1));
+    }
+
+    for (int seeds = completed_seeds; ok && seeds <= max_seeds; ++seeds)
+    {
+        DELAY_CHECKPOINT();
+
+        const UINT64 first = binomials[seeds + 2 * KALAH_PITS - 1][2 * KALAH_PITS];
+        const UINT64 count = binomials[seeds + 2 * KALAH_PITS - 1][2 * KALAH_PITS - 1];
+
+        KalahDatabaseTask all_positions(values, seeds, 0, count);
+        scheduler.Run(&all_positions);
+
+        // Save the new table before recording it as complete, so that an
+        // interrupted build never leaves a bad one
+        header.completed_seeds = UINT32(seeds + 1);
+        ok = transfer(file, sizeof header + first, values + first, count, true) &&
+             transfer(file, 0, &header, sizeof header, true) &&
+             FlushFileBuffers(file);
+
+        reporter->output("Kalah endgame database: %I64u positions with %d seeds solved in %.3f seconds\n", count, seeds, DELAY_MEASURED() / 1000);
+    }
+
+    if (!ok)
+    {
+        reporter->output("Failed to write \"%s\"; error %u\n", file_name, GetLastError());
+    }
+
+    VERIFY_TRUE(CloseHandle(file));
+    delete[] values;
+
+    return ok ? Result::OK : Result::Fail;
+}
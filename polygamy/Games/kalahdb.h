@@ -0,0 +1,77 @@
+// kalahdb.h
+
+#ifndef GAMES_KALAHDB_H
+#define GAMES_KALAHDB_H
+
+#include "kalah.h"  // For KALAH_PITS
+
+
+//
+// KalahDatabase: the exact values of all Kalah positions with up to a given
+// number of seeds left in the pits, computed ahead of time by build() and
+// memory-mapped from disk by open().
+//
+// A position's value doesn't depend on the stores, so positions are just
+// the 2*KALAH_PITS pit counts, seen from the side of the player to move.
+// Each is given a dense index (see rank()): those with fewer seeds in play
+// come first, so a table built for N seeds starts with the tables for every
+// smaller N.  Values are one signed byte each.
+//
+// The file starts with a KalahDatabase::Header.  It records how many seed
+// counts have been completed, so an interrupted build can be resumed, and an
+// incomplete database can still be used for the seed counts it has.
+//
+
+#define KALAH_DATABASE_VERSION 1
+
+class KalahDatabase
+{
+public:
+
+    KalahDatabase() : m_file(INVALID_HANDLE_VALUE), m_mapping(NULL), m_view(NULL), m_values(NULL), m_max_seeds(-1) {}
+    ~KalahDatabase() {close();}
+
+    Result open(const char* file_name);
+    void close();
+
+    // Most seeds in play of any position covered (-1 if there is no database)
+    int max_seeds() const {return m_max_seeds;}
+
+    // Returns how many more seeds the player to move will add to its store
+    // than its opponent from now until the end of the game, with perfect play
+    // on both sides.  'pits' holds that player's pits in sowing order, then
+    // the opponent's, and the seeds in them mustn't exceed max_seeds().
+    int probe(const int* pits) const {return m_values[rank(pits)];}
+
+    // Builds a database file covering positions with up to 'max_seeds' seeds
+    // in play, or resumes building one, using 'threads' threads.  Progress
+    // is reported through 'reporter'.
+    static Result build(const char* file_name, int max_seeds, int threads, const KalahGameState* reporter);
+
+    // Returns the index of a position ('pits' as for probe()) in the table
+    static UINT64 rank(const int* pits);
+
+    struct Header
+    {
+        char signature[8];      // KALAH_DATABASE_SIGNATURE
+        UINT32 version;         // KALAH_DATABASE_VERSION
+        UINT32 pits;            // KALAH_PITS of the game it was built for
+        UINT32 target_seeds;    // Most seeds in play the build is to cover
+        UINT32 completed_seeds; // Seed counts 0 .. completed_seeds-1 are ready for use
+    };
+
+private:
+
+    HANDLE m_file;
+    HANDLE m_mapping;
+    const void* m_view;
+    const signed char* m_values;  // Just past the header
+    int m_max_seeds;
+
+    // Prevent copying
+    KalahDatabase(const KalahDatabase&);
+    KalahDatabase& operator=(const KalahDatabase&);
+};
+
+
+#endif // GAMES_KALAHDB_H
@@ -2,6 +2,7 @@
 
 #include "shared.h"   // Precompiled header; obligatory
 #include "othello.h"  // Our public interface
+#include "searcher.h" // For Searcher
 
 #define BLACK_SYMBOL '\xf9'  // Looks right in console window
 #define WHITE_SYMBOL '\x4f'  // Looks right in console window
@@ -26,6 +27,54 @@ static int othello_registered =
     );
 
 
+// Zobrist keys used to maintain m_hash_history
+
+static struct OthelloZobristKeys
+{
+    PositionHash cells[2][OTH_DIMENSION + 2][OTH_DIMENSION + 2];  // Indexed by [player][x][y]
+    PositionHash white_to_move;
+}
+othello_keys;
+
+static int othello_keys_generated = generate_zobrist_keys(&othello_keys, sizeof othello_keys, 0x07E11001);
+
+// The same keys for each of the board's symmetric images (see canonical_hash()):
+// the key of a cell in image s is the key of the cell symmetry s maps it to.
+// A cell's keys for all the images are kept together, since apply_move()
+// needs them all at once.
+
+static struct OthelloSymmetricKeys
+{
+    PositionHash cells[2][OTH_DIMENSION + 2][OTH_DIMENSION + 2][BOARD_SYMMETRIES];  // Indexed by [player][x][y][symmetry]
+    PositionHash flips[OTH_DIMENSION + 2][OTH_DIMENSION + 2][BOARD_SYMMETRIES];     // Black and white keys XORed together
+}
+othello_symmetric_keys;
+
+static int generate_othello_symmetric_keys()
+{
+    for (int x = 1; x <= OTH_DIMENSION; ++x)
+    {
+        for (int y = 1; y <= OTH_DIMENSION; ++y)
+        {
+            for (int symmetry = 0; symmetry < BOARD_SYMMETRIES; ++symmetry)
+            {
+                int image_x = x - 1, image_y = y - 1;
+                transform_cell(symmetry, false, OTH_DIMENSION, OTH_DIMENSION, &image_x, &image_y);
+
+                PositionHash (&keys)[2][OTH_DIMENSION + 2][OTH_DIMENSION + 2][BOARD_SYMMETRIES] = othello_symmetric_keys.cells;
+                keys[eBlack][x][y][symmetry] = othello_keys.cells[eBlack][image_x + 1][image_y + 1];
+                keys[eWhite][x][y][symmetry] = othello_keys.cells[eWhite][image_x + 1][image_y + 1];
+                othello_symmetric_keys.flips[x][y][symmetry] = keys[eBlack][x][y][symmetry] ^ keys[eWhite][x][y][symmetry];
+            }
+        }
+    }
+
+    return BOARD_SYMMETRIES;
+}
+
+static int othello_symmetric_keys_generated = generate_othello_symmetric_keys();
+
+
 Result OthelloGameState::set_initial_position(size_t position_size, __in_bcount(position_size) const char* position)
 {
     static const size_t expected_size = (OTH_DIMENSION * OTH_DIMENSION + 10) * sizeof CellState;
@@ -52,6 +101,7 @@ void OthelloGameState::reset()
     memset(m_move_history, 0, sizeof m_move_history);
     memset(m_value_history, 0, sizeof m_value_history);
     memset(m_player_cells_history, 0, sizeof m_player_cells_history);
+    memset(m_hash_history, 0, sizeof m_hash_history);
 
     #if OTH_GAME_STATE_LIST
         for (int n = 0; n < countof(m_boards); ++n)
@@ -100,19 +150,34 @@ void OthelloGameState::reset()
         m_player_cells_history[0][eBlack] = 2;
         m_player_cells_history[0][eWhite] = 2;
     }
+
+    for (int x = 1; x <= OTH_DIMENSION; ++x)
+    {
+        for (int y = 1; y <= OTH_DIMENSION; ++y)
+        {
+            if (cell(x, y) != eEmpty)
+            {
+                for (int symmetry = 0; symmetry < BOARD_SYMMETRIES; ++symmetry)
+                {
+                    m_hash_history[0][symmetry] ^= othello_symmetric_keys.cells[cell(x, y)][x][y][symmetry];
+                }
+            }
+        }
+    }
 }
 
 
-GameMove* OthelloGameState::get_possible_moves() const
+// Every empty cell is listed, and a position set up by set_initial_position()
+// may have them all empty
+C_ASSERT(OTH_DIMENSION * OTH_DIMENSION <= MAX_POSSIBLE_MOVES);
+
+void OthelloGameState::get_possible_moves(__out MoveList* moves) const
 {
     #if RANDOMIZE
         int random_offset = rand();
     #endif
 
-    GameMove move_array[OTH_DIMENSION * OTH_DIMENSION - 4];
-    GameMove* current_move = move_array;
     int cells_left_to_inspect = OTH_DIMENSION * OTH_DIMENSION;
-    int moves_found = 0;
 
     while (cells_left_to_inspect--)
     {
@@ -126,16 +191,54 @@ GameMove* OthelloGameState::get_possible_moves() const
 
         if (cell(x, y) == eEmpty)
         {
-            ++moves_found;
-            *current_move++ = GameMove(x | (y << 16));  // Equivalent to Cell(x, y) but faster
+            moves->add(GameMove(x | (y << 16)));  // Equivalent to Cell(x, y) but faster
         }
     }
+}
+
+
+PositionHash OthelloGameState::position_hash() const
+{
+    return m_hash_history[move_counter()][0] ^ (player_up() == eWhite ? othello_keys.white_to_move : 0);
+}
+
+
+PositionHash OthelloGameState::canonical_hash(__out int* symmetry) const
+{
+    // Othello's rules don't change under any of the square's symmetries
+    return least_symmetric_hash(m_hash_history[move_counter()], (1 << BOARD_SYMMETRIES) - 1,
+                                player_up() == eWhite ? othello_keys.white_to_move : 0, symmetry);
+}
+
+
+GameMove OthelloGameState::transform_move(GameMove move, int symmetry, bool inverse) const
+{
+    if (move == PASSING_MOVE || move == INVALID_MOVE) return move;
+
+    int x = Cell(move).x - 1, y = Cell(move).y - 1;
+    transform_cell(symmetry, inverse, OTH_DIMENSION, OTH_DIMENSION, &x, &y);
+    return Cell(x + 1, y + 1);
+}
+
+
+GameState* OthelloGameState::clone() const
+{
+    OthelloGameState* copy = new OthelloGameState(*this);
+    copy->m_initial_position = NULL;  // Only used by reset(), which copies never need
+    copy->m_solver_table = NULL;      // Each copy builds up its own
+    return copy;
+}
 
-    GameMove* possible_moves = new GameMove[moves_found + 1];
-    memcpy(possible_moves, move_array, moves_found * sizeof GameMove);
-    possible_moves[moves_found] = INVALID_MOVE;  // Terminate move list for caller convenience
 
-    return possible_moves;
+Value OthelloGameState::fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes)
+{
+    return Searcher<OthelloGameState>(this).search(depth, best_move, nodes);
+}
+
+
+int OthelloGameState::evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values)
+{
+    return Searcher<OthelloGameState>(this).evaluate_moves(moves, values);
 }
 
 
@@ -187,14 +290,15 @@ bool OthelloGameState::valid_move(GameMove move)
     {
         ASSERT(move_counter() == 0 || m_move_history[move_counter()-1] != PASSING_MOVE);
 
-        GameMove* possible_moves = get_possible_moves();
-        for (GameMove* m = possible_moves; *m; ++m)
+        MoveList possible_moves;
+        get_possible_moves(&possible_moves);
+        for (int n = 0; n < possible_moves.count(); ++n)
         {
-            if (apply_move(*m).ok())
+            if (apply_move(possible_moves[n]).ok())
             {
                 undo_last_move();
                 char move_string[MAX_MOVE_STRING_SIZE];
-                write_move(*m, sizeof move_string, move_string);
+                write_move(possible_moves[n], sizeof move_string, move_string);
                 output("Cannot pass; at least one move is available (%s).\n", move_string);
                 return false;
             }
@@ -218,6 +322,12 @@ Result OthelloGameState::apply_move(GameMove move)
     const PlayerCode opponent = (player_up() == eWhite) ? eBlack : eWhite;
     bool valid_move = false;
     int flipped_count = 0;
+    PositionHash hash_change[BOARD_SYMMETRIES] = {0};  // Accumulate the Zobrist keys of the cells that change, in each image
+
+    // Flipping a piece replaces the opponent's key for its cell with ours
+    #define FLIP_HASH(tx, ty) \
+        for (int symmetry = 0; symmetry < BOARD_SYMMETRIES; ++symmetry) \
+            hash_change[symmetry] ^= othello_symmetric_keys.flips[tx][ty][symmetry]
 
     #if OTH_GAME_STATE_LIST
 
@@ -251,6 +361,7 @@ Result OthelloGameState::apply_move(GameMove move)
                         {                                                   \
                             tx -= dx; ty -= dy;                             \
                             next_board[tx][ty] = player_up();               \
+                            FLIP_HASH(tx, ty);                              \
                         }                                                   \
                     }                                                       \
                     break;                                                  \
@@ -279,6 +390,7 @@ Result OthelloGameState::apply_move(GameMove move)
                 {                                                           \
                     tx -= dx; ty -= dy;                                     \
                     m_board[tx][ty] = player_up();                          \
+                    FLIP_HASH(tx, ty);                                      \
                     undo.flipped_pieces[flipped_count].x = short(tx);       \
                     undo.flipped_pieces[flipped_count].y = short(ty);       \
                     ++flipped_count;                                        \
@@ -318,6 +430,11 @@ Result OthelloGameState::apply_move(GameMove move)
 
         m_player_cells_history[move_counter()][player_up()] = m_player_cells_history[move_counter()-1][player_up()] + flipped_count + 1;
         m_player_cells_history[move_counter()][opponent] = m_player_cells_history[move_counter()-1][opponent] - flipped_count;
+        for (int symmetry = 0; symmetry < BOARD_SYMMETRIES; ++symmetry)
+        {
+            m_hash_history[move_counter()][symmetry] = m_hash_history[move_counter()-1][symmetry] ^ hash_change[symmetry] ^
+                                                       othello_symmetric_keys.cells[player_up()][x][y][symmetry];
+        }
 
         switch_player_up();
         --m_cells_available;
@@ -359,6 +476,7 @@ Result OthelloGameState::apply_passing_move()
     m_move_history[move_counter()] = PASSING_MOVE;
     m_player_cells_history[move_counter()+1][eBlack] = m_player_cells_history[move_counter()][eBlack];
     m_player_cells_history[move_counter()+1][eWhite] = m_player_cells_history[move_counter()][eWhite];
+    memcpy(m_hash_history[move_counter()+1], m_hash_history[move_counter()], sizeof m_hash_history[0]);
     switch_player_up();
     advance_move_counter();
 
@@ -402,6 +520,502 @@ Result OthelloGameState::set_value_function(int n)
 }
 
 
+//
+// Corner moves are the only ones treated as tactical, since a corner is worth
+// more to position_val() than anything else it measures
+//
+
+bool OthelloGameState::can_take_corner(int x, int y) const
+{
+    if (cell(x, y) != eEmpty) return false;
+
+    const PlayerCode opponent = (player_up() == eWhite) ? eBlack : eWhite;
+    const int dx = (x == 1) ? 1 : -1;
+    const int dy = (y == 1) ? 1 : -1;
+
+    // Only three directions lead onto the board from a corner
+    #define CAN_FLIP(step_x, step_y)                                            \
+    {                                                                           \
+        int flipped = 0, tx = x + step_x, ty = y + step_y;                      \
+        while (cell(tx, ty) == opponent) {++flipped; tx += step_x, ty += step_y;} \
+        if (flipped && cell(tx, ty) == player_up()) return true;                \
+    }
+
+    CAN_FLIP(dx, 0);
+    CAN_FLIP(0, dy);
+    CAN_FLIP(dx, dy);
+
+    return false;
+}
+
+
+bool OthelloGameState::is_quiet() const
+{
+    return !can_take_corner(1, 1) && !can_take_corner(1, OTH_DIMENSION) &&
+           !can_take_corner(OTH_DIMENSION, 1) && !can_take_corner(OTH_DIMENSION, OTH_DIMENSION);
+}
+
+
+void OthelloGameState::generate_tactical_moves(__out MoveList* moves) const
+{
+    if (can_take_corner(1, 1)) moves->add(Cell(1, 1));
+    if (can_take_corner(1, OTH_DIMENSION)) moves->add(Cell(1, OTH_DIMENSION));
+    if (can_take_corner(OTH_DIMENSION, 1)) moves->add(Cell(OTH_DIMENSION, 1));
+    if (can_take_corner(OTH_DIMENSION, OTH_DIMENSION)) moves->add(Cell(OTH_DIMENSION, OTH_DIMENSION));
+}
+
+
+// Late move reductions, by position in the move list.  Positions seldom have
+// more than a dozen moves, and the first few hold the best one far more often
+// than not.
+static const BYTE othello_late_move_reductions[LMR_TABLE_SIZE] = {0, 0, 0, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2};
+
+const BYTE* OthelloGameState::late_move_reductions() const {return othello_late_move_reductions;}
+
+
+//
+// Exact endgame solver.  Once few enough cells are empty, positions are solved
+// to the end of the game by a dedicated alpha-beta search that needs no game
+// tree and allocates nothing as it goes.  The position is copied into a pair of 64-bit
+// masks (one per player, bit 8*(x-1) + (y-1) standing for cell (x, y)), and
+// moves are made and taken back on those, which is much faster than working
+// on m_board: all of a player's moves are found at once by shifting whole
+// masks.  Results are final disc differences, as in game_over_val().
+//
+// Move ordering matters most near the root, where the subtrees are large:
+//  - With more than OTH_SOLVER_SORT_EMPTIES empty cells, moves leaving the
+//    opponent the fewest replies are tried first ("fastest first"), since
+//    they lead to the smallest subtrees, and usually to the best results too.
+//  - Otherwise, moves into quadrants with an odd number of empty cells are
+//    tried first (parity): having the last move in a region tends to win it.
+//    Within each group, corners come first and the cells next to the corners
+//    last.
+// The last two empty cells are special-cased, as they account for most of
+// the nodes.  Positions with many empty cells are looked up in a hash table
+// (see SolverEntry), which also supplies the best move found earlier to try
+// first; the table survives from one solve to the next.
+//
+// The masks only fit the standard board, so other sizes are left to the
+// generic search.
+//
+
+#if OTH_DIMENSION == 8
+
+#define SOLVER_CORNERS      0x8100000000000081ULL
+#define SOLVER_X_SQUARES    0x0042000000004200ULL  // Diagonal neighbours of the corners
+#define SOLVER_C_SQUARES    0x4281000000008142ULL  // Edge neighbours of the corners
+#define SOLVER_EDGES        0xFF818181818181FFULL
+#define SOLVER_NOT_EDGE_COLUMNS 0x7E7E7E7E7E7E7E7EULL  // Stops shifts along rows wrapping round
+
+// Cells in order of how good they tend to be to play
+static const UINT64 solver_cell_groups[] =
+{
+    SOLVER_CORNERS,
+    SOLVER_EDGES & ~SOLVER_CORNERS & ~SOLVER_C_SQUARES,
+    ~SOLVER_EDGES & ~SOLVER_X_SQUARES,
+    SOLVER_C_SQUARES,
+    SOLVER_X_SQUARES
+};
+
+// Quadrants, and the cells in each combination of them (indexed by the
+// parity mask passed to OthelloGameState::solve())
+static const UINT64 solver_quadrants[4] = {0x000000000F0F0F0FULL, 0x00000000F0F0F0F0ULL, 0x0F0F0F0F00000000ULL, 0xF0F0F0F000000000ULL};
+static UINT64 solver_quadrant_sets[16];
+
+static int build_solver_tables()
+{
+    for (int parity = 0; parity < 16; ++parity)
+        for (int n = 0; n < 4; ++n)
+            if (parity & (1 << n)) solver_quadrant_sets[parity] |= solver_quadrants[n];
+    return 16;
+}
+
+static int solver_tables_built = build_solver_tables();
+
+static FORCEINLINE unsigned solver_quadrant_bit(UINT64 cell)
+{
+    return 1u << (((cell & 0xFFFFFFFF00000000ULL) ? 2 : 0) + ((cell & 0xF0F0F0F0F0F0F0F0ULL) ? 1 : 0));
+}
+
+static FORCEINLINE int solver_count(UINT64 cells)
+{
+    cells -= (cells >> 1) & 0x5555555555555555ULL;
+    cells = (cells & 0x3333333333333333ULL) + ((cells >> 2) & 0x3333333333333333ULL);
+    cells = (cells + (cells >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return int((cells * 0x0101010101010101ULL) >> 56);
+}
+
+
+// Returns the cells where 'player' (whose discs are 'own') can move
+static FORCEINLINE UINT64 solver_moves(UINT64 own, UINT64 opponent)
+{
+    const UINT64 inner = opponent & SOLVER_NOT_EDGE_COLUMNS;
+    UINT64 moves = 0, run;
+
+    // Follow runs of opposing discs (at most six long) from each of our own
+    // discs in each direction, and note the cells just beyond them
+    #define SOLVER_MOVES(SHIFT, n, opponents)   \
+        run = opponents & (own SHIFT n);        \
+        run |= opponents & (run SHIFT n);       \
+        run |= opponents & (run SHIFT n);       \
+        run |= opponents & (run SHIFT n);       \
+        run |= opponents & (run SHIFT n);       \
+        run |= opponents & (run SHIFT n);       \
+        moves |= run SHIFT n;
+
+    SOLVER_MOVES(<<, 1, inner);
+    SOLVER_MOVES(>>, 1, inner);
+    SOLVER_MOVES(<<, 8, opponent);
+    SOLVER_MOVES(>>, 8, opponent);
+    SOLVER_MOVES(<<, 7, inner);
+    SOLVER_MOVES(>>, 7, inner);
+    SOLVER_MOVES(<<, 9, inner);
+    SOLVER_MOVES(>>, 9, inner);
+
+    return moves & ~(own | opponent);
+}
+
+
+// Returns the discs a move at 'cell' by the owner of 'own' would flip
+static FORCEINLINE UINT64 solver_flips(UINT64 cell, UINT64 own, UINT64 opponent)
+{
+    const UINT64 inner = opponent & SOLVER_NOT_EDGE_COLUMNS;
+    UINT64 flips = 0, run, next;
+
+    #define SOLVER_FLIPS(SHIFT, n, opponents)                                   \
+        run = 0;                                                                \
+        for (next = cell SHIFT n; next & opponents; next = next SHIFT n) run |= next; \
+        if (next & own) flips |= run;
+
+    SOLVER_FLIPS(<<, 1, inner);
+    SOLVER_FLIPS(>>, 1, inner);
+    SOLVER_FLIPS(<<, 8, opponent);
+    SOLVER_FLIPS(>>, 8, opponent);
+    SOLVER_FLIPS(<<, 7, inner);
+    SOLVER_FLIPS(>>, 7, inner);
+    SOLVER_FLIPS(<<, 9, inner);
+    SOLVER_FLIPS(>>, 9, inner);
+
+    return flips;
+}
+
+
+// The board's symmetries, as transform_cell() defines them, applied to a
+// bitboard (whose bit (x-1)*8 + (y-1) is cell (x, y)).  The reflections
+// reverse the order of the bytes or of the bits within each byte, and the
+// transposition swaps bits across the diagonal in three rounds of delta swaps.
+static FORCEINLINE UINT64 solver_reverse_bytes(UINT64 cells)
+{
+    cells = ((cells >> 8) & 0x00FF00FF00FF00FFULL) | ((cells & 0x00FF00FF00FF00FFULL) << 8);
+    cells = ((cells >> 16) & 0x0000FFFF0000FFFFULL) | ((cells & 0x0000FFFF0000FFFFULL) << 16);
+    return (cells >> 32) | (cells << 32);
+}
+
+static FORCEINLINE UINT64 solver_reverse_bits(UINT64 cells)
+{
+    cells = ((cells >> 1) & 0x5555555555555555ULL) | ((cells & 0x5555555555555555ULL) << 1);
+    cells = ((cells >> 2) & 0x3333333333333333ULL) | ((cells & 0x3333333333333333ULL) << 2);
+    return ((cells >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((cells & 0x0F0F0F0F0F0F0F0FULL) << 4);
+}
+
+static FORCEINLINE UINT64 solver_transpose(UINT64 cells)
+{
+    UINT64 swapped;
+    swapped = 0x0F0F0F0F00000000ULL & (cells ^ (cells << 28)); cells ^= swapped ^ (swapped >> 28);
+    swapped = 0x3333000033330000ULL & (cells ^ (cells << 14)); cells ^= swapped ^ (swapped >> 14);
+    swapped = 0x5500550055005500ULL & (cells ^ (cells << 7));  cells ^= swapped ^ (swapped >> 7);
+    return cells;
+}
+
+static FORCEINLINE UINT64 solver_image(UINT64 cells, int symmetry, bool inverse)
+{
+    if ((symmetry & 4) && !inverse) cells = solver_transpose(cells);
+    if (symmetry & 1) cells = solver_reverse_bytes(cells);
+    if (symmetry & 2) cells = solver_reverse_bits(cells);
+    if ((symmetry & 4) && inverse) cells = solver_transpose(cells);
+    return cells;
+}
+
+// Replaces a position by its canonical image (the one with the least pair of
+// bitboards), returning the symmetry that maps it there
+static int solver_canonical_image(__inout UINT64* own, __inout UINT64* opponent)
+{
+    const UINT64 images[2][2] = {{*own, *opponent}, {solver_transpose(*own), solver_transpose(*opponent)}};
+    int symmetry = 0;
+
+    for (int n = 1; n < BOARD_SYMMETRIES; ++n)
+    {
+        // The transposition comes first, so the images share it
+        UINT64 image_own = images[n >> 2][0], image_opponent = images[n >> 2][1];
+        if (n & 1) {image_own = solver_reverse_bytes(image_own); image_opponent = solver_reverse_bytes(image_opponent);}
+        if (n & 2) {image_own = solver_reverse_bits(image_own); image_opponent = solver_reverse_bits(image_opponent);}
+
+        if (image_own < *own || (image_own == *own && image_opponent < *opponent))
+        {
+            *own = image_own;
+            *opponent = image_opponent;
+            symmetry = n;
+        }
+    }
+
+    return symmetry;
+}
+
+
+// Converts the edges of a search window from position values to disc
+// differences, such that a disc difference is no greater than the lower edge
+// (or no less than the upper one) exactly when its value as returned by
+// game_over_val() is
+static int disc_lower_bound(Value alpha)
+{
+    return alpha >= VICTORY_VALUE ? alpha - VICTORY_VALUE : alpha >= 0 ? 0 : alpha > -VICTORY_VALUE ? -1 : min(alpha + VICTORY_VALUE, -1);
+}
+
+static int disc_upper_bound(Value beta)
+{
+    return beta <= -VICTORY_VALUE ? beta + VICTORY_VALUE : beta <= 0 ? 0 : beta < VICTORY_VALUE ? 1 : max(beta - VICTORY_VALUE, 1);
+}
+
+
+bool OthelloGameState::endgame_solvable(int depth) const
+{
+    // Only worthwhile where a search would reach the end of the game anyway
+    return m_cells_available <= OTH_ENDGAME_EMPTIES && m_cells_available <= depth;
+}
+
+
+Value OthelloGameState::solve_endgame(Value alpha, Value beta)
+{
+    UINT64 discs[2] = {0, 0};
+    unsigned parity = 0;
+
+    for (int x = 1; x <= OTH_DIMENSION; ++x)
+    {
+        for (int y = 1; y <= OTH_DIMENSION; ++y)
+        {
+            const UINT64 cell_mask = 1ULL << ((x - 1) * 8 + (y - 1));
+            if (cell(x, y) == eEmpty) parity ^= solver_quadrant_bit(cell_mask);
+            else discs[cell(x, y)] |= cell_mask;
+        }
+    }
+
+    const PlayerCode player = player_up();
+    const int lead = m_player_cells_history[move_counter()][player] - m_player_cells_history[move_counter()][player ^ 1];
+    const bool passed = move_counter() > 0 && m_move_history[move_counter() - 1] == PASSING_MOVE;
+
+    if (m_solver_table == NULL)
+    {
+        // Solve without the table if it can't be had
+        m_solver_table = new SolverEntry[OTH_SOLVER_HASH_ENTRIES];
+        if (m_solver_table) memset(m_solver_table, 0, OTH_SOLVER_HASH_ENTRIES * sizeof(SolverEntry));
+    }
+
+    m_solver_countdown = DEADLINE_POLL_INTERVAL;
+    m_solver_stopped = false;
+
+    const int result = solve(disc_lower_bound(alpha), disc_upper_bound(beta), discs[player], discs[player ^ 1],
+                             lead, m_cells_available, parity, passed);
+
+    return result + (result > 0 ? VICTORY_VALUE : result < 0 ? -VICTORY_VALUE : 0);
+}
+
+
+//
+// The solver proper.  Returns the final disc difference for the player to
+// move (whose discs are 'own', and whose lead is now 'lead') if it lies
+// strictly between alpha and beta; otherwise a bound no greater than alpha or
+// no less than beta.  'parity' has a bit set for each quadrant with an odd
+// number of empty cells, and 'passed' says whether the opponent has just
+// passed.
+//
+
+int OthelloGameState::solve(int alpha, int beta, UINT64 own, UINT64 opponent, int lead, int empties, unsigned parity, bool passed)
+{
+    #if MINIMAX_STATISTICS
+        ++g_endgame_nodes;
+    #endif
+
+    if (--m_solver_countdown <= 0)
+    {
+        m_solver_countdown = DEADLINE_POLL_INTERVAL;
+        m_solver_stopped = solver_interrupted();
+    }
+    if (m_solver_stopped) return alpha;
+
+    if (empties == 2) return solve_last_2(alpha, beta, own, opponent, lead, passed);
+
+    const UINT64 moves = solver_moves(own, opponent);
+    if (moves == 0)
+    {
+        // Pass, unless the opponent has just done so, which ends the game
+        return passed ? lead : -solve(-beta, -alpha, opponent, own, -lead, empties, parity, true);
+    }
+
+    SolverEntry* entry = NULL;
+    UINT64 hash_move = 0;
+    UINT64 image_own = own, image_opponent = opponent;  // The entry's canonical image of the position
+    int symmetry = 0;
+    const int original_alpha = alpha;
+
+    if (empties >= OTH_SOLVER_HASH_EMPTIES && m_solver_table)
+    {
+        symmetry = solver_canonical_image(&image_own, &image_opponent);
+        const UINT64 mixed = image_own * 0x9E3779B97F4A7C15ULL ^ image_opponent * 0xC2B2AE3D27D4EB4FULL;
+        entry = &m_solver_table[(mixed ^ (mixed >> 32)) & (OTH_SOLVER_HASH_ENTRIES - 1)];
+
+        if (entry->own == image_own && entry->opponent == image_opponent)
+        {
+            if (entry->lower >= beta) return entry->lower;
+            if (entry->upper <= alpha || entry->lower == entry->upper) return entry->upper;
+            alpha = max(alpha, int(entry->lower));
+            beta = min(beta, int(entry->upper));
+            hash_move = solver_image(entry->best_move, symmetry, true);
+        }
+    }
+
+    UINT64 ordered_moves[OTH_DIMENSION * OTH_DIMENSION];
+    int move_count = 0;
+
+    if (hash_move)
+    {
+        ordered_moves[move_count++] = hash_move;
+    }
+
+    if (empties > OTH_SOLVER_SORT_EMPTIES)
+    {
+        // Fastest first, with parity breaking ties
+        int keys[OTH_DIMENSION * OTH_DIMENSION];
+        keys[0] = -1;
+        for (UINT64 remaining = moves & ~hash_move; remaining; )
+        {
+            const UINT64 move = remaining & (0 - remaining);
+            remaining ^= move;
+
+            // Corner replies count double
+            const UINT64 flips = solver_flips(move, own, opponent);
+            const UINT64 replies = solver_moves(opponent ^ flips, own | flips | move);
+            const int key = 2 * (solver_count(replies) + solver_count(replies & SOLVER_CORNERS)) + !(parity & solver_quadrant_bit(move));
+
+            int n = move_count++;
+            for (; n > 0 && keys[n - 1] > key; --n)
+            {
+                ordered_moves[n] = ordered_moves[n - 1];
+                keys[n] = keys[n - 1];
+            }
+            ordered_moves[n] = move;
+            keys[n] = key;
+        }
+    }
+    else
+    {
+        // Odd quadrants first, then by kind of cell
+        const UINT64 odd_quadrants = solver_quadrant_sets[parity];
+        for (int odd = 1; odd >= 0; --odd)
+        {
+            const UINT64 candidates = moves & ~hash_move & (odd ? odd_quadrants : ~odd_quadrants);
+            for (int group = 0; group < countof(solver_cell_groups); ++group)
+            {
+                for (UINT64 remaining = candidates & solver_cell_groups[group]; remaining; )
+                {
+                    const UINT64 move = remaining & (0 - remaining);
+                    remaining ^= move;
+                    ordered_moves[move_count++] = move;
+                }
+            }
+        }
+    }
+
+    int best = -OTH_DIMENSION * OTH_DIMENSION - 1;
+    UINT64 best_move = 0;
+
+    for (int n = 0; n < move_count; ++n)
+    {
+        const UINT64 move = ordered_moves[n];
+        const UINT64 flips = solver_flips(move, own, opponent);
+        const int value = -solve(-beta, -alpha, opponent ^ flips, own | flips | move, -(lead + 2 * solver_count(flips) + 1),
+                                 empties - 1, parity ^ solver_quadrant_bit(move), false);
+
+        if (value > best)
+        {
+            best = value;
+            best_move = move;
+            if (value > alpha)
+            {
+                alpha = value;
+                if (value >= beta) break;
+            }
+        }
+    }
+
+    if (entry && !m_solver_stopped)
+    {
+        if (entry->own != image_own || entry->opponent != image_opponent)
+        {
+            entry->own = image_own;
+            entry->opponent = image_opponent;
+            entry->lower = -OTH_DIMENSION * OTH_DIMENSION;
+            entry->upper = OTH_DIMENSION * OTH_DIMENSION;
+        }
+        if (best < beta) entry->upper = short(best);
+        if (best > original_alpha) entry->lower = short(best);
+        entry->best_move = solver_image(best_move, symmetry, false);
+    }
+
+    return best;
+}
+
+
+int OthelloGameState::solve_last_2(int alpha, int beta, UINT64 own, UINT64 opponent, int lead, bool passed)
+{
+    const UINT64 empty = ~(own | opponent);
+    const UINT64 first = empty & (0 - empty);
+    const UINT64 second = empty ^ first;
+    int best = -OTH_DIMENSION * OTH_DIMENSION - 1;
+
+    UINT64 flips = solver_flips(first, own, opponent);
+    if (flips)
+    {
+        best = -solve_last_1(second, opponent ^ flips, own | flips | first, -(lead + 2 * solver_count(flips) + 1));
+    }
+
+    if (best < beta)
+    {
+        flips = solver_flips(second, own, opponent);
+        if (flips)
+        {
+            best = max(best, -solve_last_1(first, opponent ^ flips, own | flips | second, -(lead + 2 * solver_count(flips) + 1)));
+        }
+    }
+
+    if (best < -OTH_DIMENSION * OTH_DIMENSION)
+    {
+        return passed ? lead : -solve_last_2(-beta, -alpha, opponent, own, -lead, true);
+    }
+
+    return best;
+}
+
+
+int OthelloGameState::solve_last_1(UINT64 cell, UINT64 own, UINT64 opponent, int lead)
+{
+    int flipped = solver_count(solver_flips(cell, own, opponent));
+    if (flipped) return lead + 2 * flipped + 1;
+
+    // The opponent gets the last move, if it can use it
+    flipped = solver_count(solver_flips(cell, opponent, own));
+    if (flipped) return lead - 2 * flipped - 1;
+
+    return lead;
+}
+
+#else // OTH_DIMENSION != 8
+
+bool OthelloGameState::endgame_solvable(int) const {return false;}
+Value OthelloGameState::solve_endgame(Value, Value) {return 0;}
+
+#endif // OTH_DIMENSION
+
+
 Value OthelloGameState::position_val() const
 {
     // NOTE: Could easily expand this code to return game_over_val() if it detects
@@ -515,11 +1129,12 @@ Value OthelloGameState::position_val() const
 bool OthelloGameState::game_over()
 {
     // See if there are any possible moves for the current player
-    GameMove* possible_moves = get_possible_moves();
+    MoveList possible_moves;
+    get_possible_moves(&possible_moves);
 
-    for (GameMove* move = possible_moves; *move; ++move)
+    for (int n = 0; n < possible_moves.count(); ++n)
     {
-        if (apply_move(*move).ok())
+        if (apply_move(possible_moves[n]).ok())
         {
             undo_last_move();
             return false;  // There is a move; game has not ended
@@ -25,19 +25,20 @@ public:
     // Factory function and destructor
 
     static GameState* creator();
-    virtual ~OthelloGameState() {delete[] m_initial_position;}
+    virtual ~OthelloGameState() {delete[] m_initial_position; delete[] m_solver_table;}
 
     // GameState method overrides
 
-    virtual GameAttributes game_attributes() const {return eGreedy;}
+    virtual GameAttributes game_attributes() const {return GameAttributes(eGreedy | eVolatile);}
     virtual const char* get_player_name(PlayerCode p) const {return p == eBlack ? "Black" : "White";}
     virtual Result set_initial_position(size_t n, __in_bcount(n) const char*);
     virtual void reset();
-    virtual GameMove* get_possible_moves() const;
+    virtual void get_possible_moves(__out MoveList*) const;
     virtual Result apply_move(GameMove);
     virtual Result apply_passing_move();
     virtual void undo_last_move();
     virtual bool game_over();
+    virtual int expected_moves_left() const {return (m_cells_available + 1) / 2;}
     virtual void display(size_t size, __out_ecount(size) char*) const;
     virtual void display_score_sheet(bool, size_t size, __out_ecount(size) char*) const;
 
@@ -53,6 +54,8 @@ public:
     virtual GameMove read_move(const char*) const;
     virtual void write_move(GameMove, int size, __in_ecount(size) char*) const;
     virtual bool valid_move(GameMove);
+    virtual int move_index_count() const {return OTH_DIMENSION * OTH_DIMENSION;}
+    virtual int move_index(GameMove move) const {Cell c(move); return move == PASSING_MOVE ? -1 : (c.x-1) * OTH_DIMENSION + (c.y-1);}
 
     // Position value management
 
@@ -64,6 +67,18 @@ public:
         return black_advantage + (black_advantage > 0 ? VICTORY_VALUE : black_advantage < 0 ? -VICTORY_VALUE : 0);
     }
     virtual PlayerCode player_ahead() const;
+    virtual Value aspiration_window() const {return 50;}  // Five moves' worth of mobility
+    virtual bool is_quiet() const;
+    virtual void generate_tactical_moves(__out MoveList*) const;
+    virtual const BYTE* late_move_reductions() const;
+    virtual bool endgame_solvable(int depth) const;
+    virtual Value solve_endgame(Value alpha, Value beta);
+    virtual PositionHash position_hash() const;
+    virtual PositionHash canonical_hash(__out int* symmetry) const;
+    virtual GameMove transform_move(GameMove move, int symmetry, bool inverse) const;
+    virtual GameState* clone() const;
+    virtual Value fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes);
+    virtual int evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values);
 
 private:
 
@@ -101,10 +116,26 @@ private:
     Cell m_move_history[OTH_MAX_GAME_LENGTH];
     mutable Value m_value_history[OTH_MAX_GAME_LENGTH];
     int m_player_cells_history[OTH_MAX_GAME_LENGTH][2];
+    PositionHash m_hash_history[OTH_MAX_GAME_LENGTH][BOARD_SYMMETRIES];  // Hashes of the board's symmetric images
+                                                                         // (not including player to move); [0] is the board's own
+
+    // Endgame solver results, kept for positions with at least
+    // OTH_SOLVER_HASH_EMPTIES empty cells.  Entries record the whole position,
+    // so there are no false matches, and bounds on its final disc difference,
+    // which stay true whatever window they were found with.  A position's
+    // reflections and rotations share the entry of its canonical image: the
+    // one whose discs make the least pair of bitboards.
+    struct SolverEntry
+    {
+        UINT64 own, opponent;  // Discs of the player to move, and of the other player
+        UINT64 best_move;      // Cell of the best move found (as played in this image), or 0
+        short lower, upper;    // Bounds on the final disc difference for the player to move
+    };
+    SolverEntry* m_solver_table;  // OTH_SOLVER_HASH_ENTRIES of them, allocated by the first solve
 
     // Internal methods
 
-    OthelloGameState() : m_initial_position(NULL) {reset();}
+    OthelloGameState() : m_initial_position(NULL), m_solver_table(NULL) {reset();}
 
     #if OTH_GAME_STATE_LIST
         FORCEINLINE CellState& cell(int x, int y) {return m_boards[move_counter()].m_cells[x][y];}
@@ -113,6 +144,20 @@ private:
         FORCEINLINE CellState& cell(int x, int y) {return m_board[x][y];}
         FORCEINLINE CellState cell(int x, int y) const {return m_board[x][y];}
     #endif
+
+    bool can_take_corner(int x, int y) const;
+
+    #if OTH_DIMENSION == 8
+
+        // Endgame solver (see othello.cpp)
+        int m_solver_countdown;  // Nodes until solver_interrupted() is next called
+        bool m_solver_stopped;
+
+        int solve(int alpha, int beta, UINT64 own, UINT64 opponent, int lead, int empties, unsigned parity, bool passed);
+        int solve_last_2(int alpha, int beta, UINT64 own, UINT64 opponent, int lead, bool passed);
+        static int solve_last_1(UINT64 cell, UINT64 own, UINT64 opponent, int lead);
+
+    #endif
 };
 
 #endif // GAMES_OTHELLO_H
@@ -2,6 +2,7 @@
 
 #include "shared.h"     // Precompiled header; obligatory
 #include "tictactoe.h"  // Our public interface
+#include "searcher.h"   // For Searcher
 
 
 // Game registration stuff
@@ -16,21 +17,83 @@ static int tictactoe_registered =
     );
 
 
+// Zobrist keys used to maintain m_hash_history
+
+static struct TicTacToeZobristKeys
+{
+    PositionHash cells[2][TTT_DIMENSION][TTT_DIMENSION];  // Indexed by [player][x][y]
+    PositionHash noughts_to_move;
+}
+tictactoe_keys;
+
+static int tictactoe_keys_generated = generate_zobrist_keys(&tictactoe_keys, sizeof tictactoe_keys, 0x7770E004);
+
+// The same keys for each of the board's symmetric images (see canonical_hash()):
+// the key of a cell in image s is the key of the cell symmetry s maps it to
+
+static PositionHash tictactoe_symmetric_keys[2][TTT_DIMENSION][TTT_DIMENSION][BOARD_SYMMETRIES];  // Indexed by [player][x][y][symmetry]
+
+static int generate_tictactoe_symmetric_keys()
+{
+    for (int x = 0; x < TTT_DIMENSION; ++x)
+    {
+        for (int y = 0; y < TTT_DIMENSION; ++y)
+        {
+            for (int symmetry = 0; symmetry < BOARD_SYMMETRIES; ++symmetry)
+            {
+                int image_x = x, image_y = y;
+                transform_cell(symmetry, false, TTT_DIMENSION, TTT_DIMENSION, &image_x, &image_y);
+                tictactoe_symmetric_keys[eCross][x][y][symmetry] = tictactoe_keys.cells[eCross][image_x][image_y];
+                tictactoe_symmetric_keys[eNought][x][y][symmetry] = tictactoe_keys.cells[eNought][image_x][image_y];
+            }
+        }
+    }
+
+    return BOARD_SYMMETRIES;
+}
+
+static int tictactoe_symmetric_keys_generated = generate_tictactoe_symmetric_keys();
+
+
 void TicTacToeGameState::reset()
 {
     GameState::reset();
 
     memset(m_cells, eEmpty, sizeof m_cells);
     memset(m_value_history, 0, sizeof m_value_history);
+    memset(m_hash_history, 0, sizeof m_hash_history);  // Empty board
 }
 
 
-GameMove* TicTacToeGameState::get_possible_moves() const
+PositionHash TicTacToeGameState::position_hash() const
 {
-    GameMove* possible_moves = new GameMove[TTT_DIMENSION * TTT_DIMENSION + 1];
-    GameMove* current_move = possible_moves;
+    return m_hash_history[move_counter()][0] ^ (player_up() == eNought ? tictactoe_keys.noughts_to_move : 0);
+}
+
 
-    // Only return any moves if the game isn't over
+PositionHash TicTacToeGameState::canonical_hash(__out int* symmetry) const
+{
+    // Lines stay lines under all of the square's symmetries
+    return least_symmetric_hash(m_hash_history[move_counter()], (1 << BOARD_SYMMETRIES) - 1,
+                                player_up() == eNought ? tictactoe_keys.noughts_to_move : 0, symmetry);
+}
+
+
+GameMove TicTacToeGameState::transform_move(GameMove move, int symmetry, bool inverse) const
+{
+    if (move == INVALID_MOVE) return move;
+
+    int x = Cell(move).x - 1, y = Cell(move).y - 1;
+    transform_cell(symmetry, inverse, TTT_DIMENSION, TTT_DIMENSION, &x, &y);
+    return Cell(x + 1, y + 1);
+}
+
+
+C_ASSERT(TTT_DIMENSION * TTT_DIMENSION <= MAX_POSSIBLE_MOVES);
+
+void TicTacToeGameState::get_possible_moves(__out MoveList* moves) const
+{
+    // Only list any moves if the game isn't over
     if (position_val() == 0)
     {
         int cells_left_to_inspect = TTT_DIMENSION * TTT_DIMENSION;
@@ -40,14 +103,10 @@ GameMove* TicTacToeGameState::get_possible_moves() const
             int y = cells_left_to_inspect % TTT_DIMENSION;
             if (m_cells[move_counter()][x][y] == eEmpty)
             {
-                *current_move++ = Cell(x+1, y+1);
+                moves->add(Cell(x+1, y+1));
             }
         }
     }
-
-    *current_move = INVALID_MOVE;  // Terminate move list for caller convenience
-
-    return possible_moves;
 }
 
 
@@ -91,6 +150,11 @@ Result TicTacToeGameState::apply_move(GameMove move)
     CellState (&cells)[TTT_DIMENSION][TTT_DIMENSION] = m_cells[move_counter()];
     memcpy(cells, m_cells[move_counter()-1], sizeof cells);
     cells[x][y] = player_up();
+    for (int symmetry = 0; symmetry < BOARD_SYMMETRIES; ++symmetry)
+    {
+        m_hash_history[move_counter()][symmetry] = m_hash_history[move_counter()-1][symmetry] ^
+                                                   tictactoe_symmetric_keys[player_up()][x][y][symmetry];
+    }
 
     // Check for victory
     bool row = true, col = true;
@@ -150,6 +214,112 @@ void TicTacToeGameState::undo_last_move()
 }
 
 
+#if TTT_DIMENSION == 3
+
+//
+// Perfect play table.  The standard game has only 3^9 = 19683 board
+// states, so it is solved outright before main() runs, and analyze() then
+// just looks up the answer (see solved_position()).  Each board is indexed
+// by reading it as a base-3 number: cell (x, y) is digit 3*x + y (counting
+// from 0), and its digit is its CellState.
+//
+// Scores are from the point of view of the player to move: a win with n
+// cells still empty after the winning move scores n + 1, so quicker wins
+// score more, a loss scores the negation, and a draw scores 0.
+//
+
+#define TTT_POSITIONS 19683  // 3^(TTT_DIMENSION*TTT_DIMENSION)
+#define TTT_UNSOLVED (-2)    // best_cell of positions not reached while solving
+
+static struct TicTacToeSolution
+{
+    signed char score;
+    signed char best_cell;  // 3*x + y of the best move, or -1 if the game is over
+}
+tictactoe_solutions[TTT_POSITIONS];
+
+static int tictactoe_powers_of_3[TTT_DIMENSION * TTT_DIMENSION] = {1, 3, 9, 27, 81, 243, 729, 2187, 6561};
+
+
+// Returns whether 'player', having just taken 'cell', has completed a line
+static bool completes_line(const CellState (&cells)[TTT_DIMENSION * TTT_DIMENSION], int cell, CellState player)
+{
+    const int x = cell / 3, y = cell % 3;
+    return (cells[3*x] == player && cells[3*x + 1] == player && cells[3*x + 2] == player) ||
+           (cells[y] == player && cells[3 + y] == player && cells[6 + y] == player) ||
+           (x == y && cells[0] == player && cells[4] == player && cells[8] == player) ||
+           (x + y == 2 && cells[2] == player && cells[4] == player && cells[6] == player);
+}
+
+
+static int solve_tictactoe(CellState (&cells)[TTT_DIMENSION * TTT_DIMENSION], int index, CellState player, int empty_cells)
+{
+    TicTacToeSolution& solution = tictactoe_solutions[index];
+    if (solution.best_cell != TTT_UNSOLVED) return solution.score;
+
+    solution.score = 0;  // A draw if the board is full
+    solution.best_cell = -1;
+
+    for (int cell = 0; cell < TTT_DIMENSION * TTT_DIMENSION; ++cell)
+    {
+        if (cells[cell] != eEmpty) continue;
+
+        cells[cell] = player;
+        const int child_index = index + (player - eEmpty) * tictactoe_powers_of_3[cell];
+        const int score = completes_line(cells, cell, player) ? empty_cells
+                        : -solve_tictactoe(cells, child_index, CellState(!player), empty_cells - 1);
+        cells[cell] = eEmpty;
+
+        if (solution.best_cell == -1 || score > solution.score)
+        {
+            solution.score = static_cast<signed char>(score);
+            solution.best_cell = static_cast<signed char>(cell);
+        }
+    }
+
+    return solution.score;
+}
+
+
+static int build_tictactoe_solutions()
+{
+    for (int index = 0; index < TTT_POSITIONS; ++index)
+    {
+        tictactoe_solutions[index].best_cell = TTT_UNSOLVED;
+    }
+
+    CellState cells[TTT_DIMENSION * TTT_DIMENSION];
+    for (int cell = 0; cell < TTT_DIMENSION * TTT_DIMENSION; ++cell)
+    {
+        cells[cell] = eEmpty;
+    }
+
+    // The empty board has every digit 2
+    return solve_tictactoe(cells, TTT_POSITIONS - 1, eCross, TTT_DIMENSION * TTT_DIMENSION);
+}
+
+static int tictactoe_solutions_built = build_tictactoe_solutions();
+
+
+bool TicTacToeGameState::solved_position(__out GameMove* best_move, __out Value* value) const
+{
+    int index = 0;
+    for (int cell = TTT_DIMENSION * TTT_DIMENSION - 1; cell >= 0; --cell)
+    {
+        index = index * 3 + m_cells[move_counter()][cell / 3][cell % 3];
+    }
+
+    const TicTacToeSolution& solution = tictactoe_solutions[index];
+    if (solution.best_cell < 0) return false;  // The game is over
+
+    *best_move = Cell(solution.best_cell / 3 + 1, solution.best_cell % 3 + 1);
+    *value = (solution.score > 0) ? victory_val() : (solution.score < 0) ? defeat_val() : 0;
+    return true;
+}
+
+#endif // TTT_DIMENSION == 3
+
+
 void TicTacToeGameState::display(size_t output_size, __out_ecount(output_size) char* output) const
 {
     for (int i = 0; i < TTT_DIMENSION; ++i)
@@ -199,3 +369,15 @@ const char* TicTacToeGameState::get_cell_state_image_name(int state) const
     return state == eCross  ? "TicTacToeCross"  :
            state == eNought ? "TicTacToeNought" : "TicTacToeEmpty";
 }
+
+
+Value TicTacToeGameState::fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes)
+{
+    return Searcher<TicTacToeGameState>(this).search(depth, best_move, nodes);
+}
+
+
+int TicTacToeGameState::evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values)
+{
+    return Searcher<TicTacToeGameState>(this).evaluate_moves(moves, values);
+}
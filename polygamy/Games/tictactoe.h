@@ -26,10 +26,11 @@ public:
     // GameState method overrides
     virtual const char* get_player_name(PlayerCode p) const {return p == eCross ? "Crosses" : "Noughts";}
     virtual void reset();
-    virtual GameMove* get_possible_moves() const;
+    virtual void get_possible_moves(__out MoveList*) const;
     virtual Result apply_move(GameMove);
     virtual void undo_last_move();
     virtual bool game_over() {return position_val() != 0 || move_counter() >= TTT_DIMENSION*TTT_DIMENSION;}
+    virtual int expected_moves_left() const {return (TTT_DIMENSION*TTT_DIMENSION - move_counter() + 1) / 2;}
     virtual void display(size_t size, __out_ecount(size) char*) const;
     virtual void display_score_sheet(bool, size_t size, __out_ecount(size) char*) const;
 
@@ -44,9 +45,20 @@ public:
     virtual GameMove read_move(const char*) const;
     virtual void write_move(GameMove, int size, __in_ecount(size) char*) const;
     virtual bool valid_move(GameMove);
+    virtual int move_index_count() const {return TTT_DIMENSION * TTT_DIMENSION;}
+    virtual int move_index(GameMove move) const {Cell c(move); return (c.x-1) * TTT_DIMENSION + (c.y-1);}
 
     // Position value management
     virtual Value position_val() const {return m_value_history[move_counter()];}
+    virtual PositionHash position_hash() const;
+    virtual PositionHash canonical_hash(__out int* symmetry) const;
+    virtual GameMove transform_move(GameMove move, int symmetry, bool inverse) const;
+    virtual GameState* clone() const {return new TicTacToeGameState(*this);}
+    virtual Value fixed_depth_search(int depth, __out GameMove* best_move, __out UINT64* nodes);
+    virtual int evaluate_moves(__out_ecount(MAX_POSSIBLE_MOVES) GameMove* moves, __out_ecount(MAX_POSSIBLE_MOVES) Value* values);
+    #if TTT_DIMENSION == 3
+        virtual bool solved_position(__out GameMove*, __out Value*) const;
+    #endif
 
 private:
 
@@ -54,6 +66,8 @@ private:
     #define TTT_MAX_GAME_LENGTH (TTT_DIMENSION*TTT_DIMENSION + 1)
     CellState m_cells[TTT_MAX_GAME_LENGTH][TTT_DIMENSION][TTT_DIMENSION];
     Value m_value_history[TTT_MAX_GAME_LENGTH];
+    PositionHash m_hash_history[TTT_MAX_GAME_LENGTH][BOARD_SYMMETRIES];  // Hashes of the board's symmetric images
+                                                                         // (not including player to move); [0] is the board's own
 
     // Internal methods
     TicTacToeGameState() {reset();}
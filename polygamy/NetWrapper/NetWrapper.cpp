@@ -52,10 +52,10 @@ String^ ManagedGameState::GetOutputText()
     return output_string;
 }
 
-Value ManagedGameState::AnalyzePosition(int target_depth, int max_analysis_time, GameMove% ret_move)
+Value ManagedGameState::AnalyzePosition(int target_depth, int max_analysis_seconds, GameMove% ret_move)
 {
     GameMove move;
-    Value val = m_pGameState->analyze(target_depth, max_analysis_time, &move);
+    Value val = m_pGameState->analyze(target_depth, max_analysis_seconds * 1000, &move);  // (analyze() takes milliseconds)
     ret_move = move;
     return val;
 }
@@ -44,10 +44,10 @@ namespace NetWrapper
             String^ GetCellStateImageName(int state) {return gcnew String(m_pGameState->get_cell_state_image_name(state));}
             int GetCellState(int row, int column) {return m_pGameState->get_cell_state(row, column);}
             bool IsGameOver() {return m_pGameState->game_over();}
-            void ResetGame() {m_pGameState->reset();}
+            void ResetGame() {m_pGameState->new_game();}
             String^ GetPlayerToMove() {return gcnew String(m_pGameState->get_player_name(m_pGameState->player_up()));}
             String^ GetPlayerAhead() {return gcnew String(m_pGameState->get_player_name(m_pGameState->player_ahead()));}
-            Value AnalyzePosition(int target_depth, int max_analysis_time, GameMove% ret_move);
+            Value AnalyzePosition(int target_depth, int max_analysis_seconds, GameMove% ret_move);
             bool PerformMove(GameMove move) {return m_pGameState->perform_move(move).ok();}
             void RevertMove() {m_pGameState->revert_move();}
             String^ GetOutputText();
@@ -40,24 +40,54 @@
 
 // Global configuration (overrules per-module defaults)
 #define RANDOMIZE 0                 // Use nondeterministic computer move sequences
-#define USE_GAMENODE_HEAP 0         // Use HeapAlloc() for game nodes rather than new()
-
-// Tidy this up if it is ever enabled:
-#if USE_GAMENODE_HEAP
-    extern HANDLE g_gamenode_heap;
-    extern unsigned __int64 g_allocations;
-#endif
+#define NODE_ARENA_BLOCK_KB 1024    // Game tree nodes are allocated in blocks of this size (see Engine/arena.h)
+#define MAX_POSSIBLE_MOVES 1024     // Capacity of a MoveList: the most moves any game can list in one position (see Engine/game.h)
 
 // Minimax algorithm tuning
 #define DEFAULT_MAXIMUM_DEPTH 10    // Default maximum search depth if unspecified by user
-#define DEFAULT_ANALYSIS_TIME 5     // Default position analysis time if unspecified by user
+#define DEFAULT_ANALYSIS_TIME 5     // Default position analysis time in seconds if unspecified by user
+#define DEADLINE_POLL_INTERVAL 1024 // negamax() calls between looks at the clock during timed searches
+#define STABLE_MOVE_ITERATIONS 4    // Stop early once this many deeper iterations have chosen the same move (see analyze())
+#define TIME_MOVES_TO_GO 30         // Moves a player is assumed to have left, in games that can't estimate it
 #define MINIMAX_STATISTICS 0        // Display number of nodes examined, beta cutoffs, etc.
 #define MINIMAX_TRACE 0             // Display minimax algorithm progress on-screen
+#define USE_TRANSPOSITION_TABLE 1   // Share search results between transposed positions
+#define TRANSPOSITION_TABLE_MB 32   // Transposition table size in megabytes (rounded down to a power of 2)
+#define CHECKPOINT_INTERVAL_S 60    // Minimum seconds between saves of the transposition table to a checkpoint file
+#define USE_KILLERS_AND_HISTORY 1   // Order new move lists using the moves that caused recent beta cutoffs
+#define SEARCH_THREADS 1            // Default number of threads used by analyze() (see Engine/smp.h)
+#define MAX_SEARCH_THREADS 64       // Upper limit on the number of search threads
+#define YBWC_MIN_SPLIT_DEPTH 4      // Don't share out nodes with less search depth remaining than this
+#define MTDF_MAX_PASSES 32          // Fall back to a full-window search if MTD(f) takes more passes than this
+#define USE_QUIESCENCE_SEARCH 1     // Play out tactical moves from leaf positions that aren't quiet (eVolatile games only)
+#define QUIESCENCE_MAX_DEPTH 6      // Maximum number of tactical moves played out from a leaf
+#define USE_FORWARD_PRUNING 1       // Allow null-move pruning, futility pruning and razoring in games that ask for them
+#define NULL_MOVE_REDUCTION 2       // Null-move searches are this much shallower than a normal move's would be
+#define NULL_MOVE_MIN_DEPTH 3       // Don't try null moves with less search depth remaining than this
+#define FORWARD_PRUNING_DEPTHS 3    // Futility pruning and razoring apply with less search depth remaining than this
+#define USE_LATE_MOVE_REDUCTIONS 1  // Search moves late in the move list less deeply, in games that supply reduction tables
+#define LMR_MIN_DEPTH 3             // Don't reduce moves with less search depth remaining than this
+#define LMR_TABLE_SIZE 16           // Entries in a late move reduction table (later moves share the last one)
+#define ASPIRATION_WINDOW 0         // Default aspiration window half-width (0 = full window; games can override)
+#define USE_ENDGAME_SOLVERS 1       // Hand positions near the end of the game to the game's own exact solver, if it has one
+#define ENDGAME_PRELUDE_DEPTH 2     // Iterations searched normally before a solvable position is solved
+
+// Monte Carlo Tree Search tuning (see Engine/mcts.h)
+#define MCTS_POOL_NODES 0x100000    // Nodes in the search tree's pool (24 bytes each)
+#define MCTS_EXPLORATION 1.4        // UCT exploration constant; higher values spend more playouts on less promising moves
+#define MCTS_PLAYOUT_LIMIT 200      // Playouts still going after this many moves are scored by position_val()
+
+// Opening book tuning (see Engine/book.h)
+#define BOOK_MARGIN 10              // The book builder enters the moves valued within this much of each position's best move
 
 // Othello-specific constants
 #define OTH_DIMENSION 8             // Default board size
 #define OTH_GAME_STATE_LIST 0       // Slightly faster (does all work on a single board)
 #define OTH_DISPLAY_EVALUATION 0    // Show position evaluation details
+#define OTH_ENDGAME_EMPTIES 20      // Solve positions exactly with this many empty cells or fewer
+#define OTH_SOLVER_SORT_EMPTIES 5   // The endgame solver orders moves by the opponent's mobility with more empty cells than this
+#define OTH_SOLVER_HASH_EMPTIES 10  // The endgame solver keeps results for positions with at least this many empty cells
+#define OTH_SOLVER_HASH_ENTRIES 0x10000 // Entries in the endgame solver's hash table (a power of 2; 32 bytes each)
 
 // Tic-tac-toe-specific constants
 #define TTT_DIMENSION 3             // Default board size
@@ -69,9 +99,12 @@
 // Ataxx-specific constants
 #define ATAXX_COLUMNS 7             // Default board width
 #define ATAXX_ROWS 7                // Default board height
+#define ATAXX_TACTICAL_CAPTURES 4   // Moves capturing this many cells are played out by the quiescence search
 
 // Kalah-specific constants
 #define KALAH_PITS 6                // Numbers of pits (houses) per side
 #define KALAH_SEEDS 4               // Number of seeds initially in each pit
+#define KALAH_DATABASE_SEEDS 16     // The endgame database built by the -e option covers positions with this many seeds in play or fewer
+#define KALAH_DATABASE_FILE "Kalah.edb" // Endgame database file, memory-mapped when present
 
 #endif // SHARED_H
@@ -0,0 +1,641 @@
+/***************************************************************************
+*
+* File:     scheduler.h
+* Content:  A work-stealing task scheduler built on ThreadBase.
+*
+***************************************************************************/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include "threader.h"   // For ThreadBase
+#include "grab-bag.h"   // For GetPerformanceCounter, g_qpcTicksPerMs, etc.
+
+
+// Most threads a TaskScheduler can run, including the one that calls Run()
+#define SCHEDULER_MAX_WORKERS 64
+
+// Capacity of each worker's task deque (a power of 2).  A task forked when
+// the deque is full is simply executed at once by the forking thread.
+#define SCHEDULER_DEQUE_SIZE 1024
+
+// Rounds of failed attempts to find work before an idle worker goes to sleep
+#define SCHEDULER_SPIN_ROUNDS 64
+
+// Longest time in ms that a sleeping worker waits before looking for work
+// again, in case it missed being woken
+#define SCHEDULER_IDLE_SLEEP 10
+
+
+class TaskContext;
+class TaskScheduler;
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TaskGroup: A cancellation group.  Every SchedulerTask may belong to a group,
+// and groups may be nested; cancelling a group cancels all the tasks in it and
+// in the groups nested inside it.  Tasks that have not started when their group
+// is cancelled are never executed; tasks that are already running should poll
+// SchedulerTask::IsCancelled and return early.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskGroup
+{
+    TaskGroup* m_pParent;
+    volatile LONG m_nCancelled;
+
+public:
+
+    TaskGroup(TaskGroup* pParent =NULL) : m_pParent(pParent), m_nCancelled(0) {}
+
+    void Cancel() {InterlockedExchange(&m_nCancelled, 1);}
+    void Reset() {InterlockedExchange(&m_nCancelled, 0);}
+
+    BOOL IsCancelled() const
+    {
+        for (const TaskGroup* pGroup = this; pGroup; pGroup = pGroup->m_pParent)
+        {
+            if (pGroup->m_nCancelled)
+            {
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SchedulerTask: A unit of work.  Derive from it and implement Execute, then
+// hand the object to TaskScheduler::Run or TaskContext::Fork.  The object is
+// its own fork/join handle: it must stay alive until IsDone returns TRUE,
+// which TaskContext::Join guarantees.  A task may be reused after Reset.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class SchedulerTask
+{
+    friend class TaskContext;
+
+    volatile LONG m_nDone;
+    TaskGroup* m_pGroup;
+
+protected:
+
+    // Runs the task.  'context' is the worker running it, through which the
+    // task can fork and join subtasks of its own.
+    virtual void Execute(TaskContext& context) =0;
+
+public:
+
+    SchedulerTask(TaskGroup* pGroup =NULL) : m_nDone(0), m_pGroup(pGroup) {}
+    virtual ~SchedulerTask() {}
+
+    BOOL IsDone() const {return MAKEBOOL(m_nDone);}
+    BOOL IsCancelled() const {return m_pGroup && m_pGroup->IsCancelled();}
+    TaskGroup* Group() const {return m_pGroup;}
+
+    void Reset(TaskGroup* pGroup =NULL)
+    {
+        ASSERT(m_nDone);  // Never reset a task that may still be queued
+        m_pGroup = pGroup;
+        InterlockedExchange(&m_nDone, 0);
+    }
+
+private:
+
+    // Prevent copying
+    SchedulerTask(const SchedulerTask&);
+    SchedulerTask& operator=(const SchedulerTask&);
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TaskDeque: A fixed-size Chase-Lev work-stealing deque of task pointers.  Its
+// owner pushes and pops tasks at the bottom end without locking; any other
+// thread may steal tasks from the top end.  Only a pop that competes with
+// thieves for the last remaining task needs an interlocked operation.
+//
+// The top and bottom indices only ever increase (apart from the owner's brief
+// decrement in Pop) and are allowed to wrap around; all comparisons between
+// them are made on their difference, which stays small.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskDeque
+{
+    volatile LONG m_nTop;     // Next task to steal
+    volatile LONG m_nBottom;  // Next free slot
+    SchedulerTask* volatile m_apTasks[SCHEDULER_DEQUE_SIZE];
+
+    static LONG Distance(LONG nFrom, LONG nTo) {return LONG(ULONG(nTo) - ULONG(nFrom));}
+    static LONG Next(LONG n) {return LONG(ULONG(n) + 1);}
+    static UINT32 Slot(LONG n) {return UINT32(n) & (SCHEDULER_DEQUE_SIZE - 1);}
+
+public:
+
+    TaskDeque() : m_nTop(0), m_nBottom(0)
+    {
+        C_ASSERT(SINGLE_FLAG_SET(SCHEDULER_DEQUE_SIZE));
+    }
+
+    // Number of tasks queued; only a hint when read by other threads
+    LONG Size() const {return Max(Distance(m_nTop, m_nBottom), LONG(0));}
+
+    // Owner only.  Returns FALSE if the deque is full.
+    BOOL Push(SchedulerTask* pTask)
+    {
+        LONG nBottom = m_nBottom;
+        if (Distance(m_nTop, nBottom) >= SCHEDULER_DEQUE_SIZE)
+        {
+            return FALSE;
+        }
+        m_apTasks[Slot(nBottom)] = pTask;
+        InterlockedExchange(&m_nBottom, Next(nBottom));  // Publishes the task to thieves
+        return TRUE;
+    }
+
+    // Owner only.  Takes the most recently pushed task, or returns NULL.
+    SchedulerTask* Pop()
+    {
+        LONG nBottom = LONG(ULONG(m_nBottom) - 1);
+        InterlockedExchange(&m_nBottom, nBottom);  // Must be visible before we read m_nTop
+        LONG nTop = m_nTop;
+        LONG nRemaining = Distance(nTop, nBottom);
+
+        if (nRemaining < 0)  // Empty
+        {
+            m_nBottom = nTop;
+            return NULL;
+        }
+
+        SchedulerTask* pTask = m_apTasks[Slot(nBottom)];
+        if (nRemaining == 0)
+        {
+            // Last task: race any thieves for it by claiming it from the top
+            if (InterlockedCompareExchange(&m_nTop, Next(nTop), nTop) != nTop)
+            {
+                pTask = NULL;
+            }
+            m_nBottom = Next(nTop);
+        }
+        return pTask;
+    }
+
+    // Any thread.  Takes the oldest task, or returns NULL if the deque is
+    // empty or another thread took the task first.
+    SchedulerTask* Steal()
+    {
+        LONG nTop = m_nTop;
+        MemoryBarrier();  // Read m_nTop before m_nBottom
+        LONG nBottom = m_nBottom;
+
+        if (Distance(nTop, nBottom) <= 0)
+        {
+            return NULL;
+        }
+
+        SchedulerTask* pTask = m_apTasks[Slot(nTop)];
+        if (InterlockedCompareExchange(&m_nTop, Next(nTop), nTop) != nTop)
+        {
+            return NULL;
+        }
+        return pTask;
+    }
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// SchedulerStatistics: Counters kept by each worker.  They are only updated by
+// the worker itself, so reading them while the scheduler is busy gives values
+// that may be slightly out of date.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+struct SchedulerStatistics
+{
+    UINT64 uTasksExecuted;   // Tasks run to completion by this worker
+    UINT64 uTasksCancelled;  // Tasks skipped because their group was cancelled
+    UINT64 uTasksInlined;    // Forks run immediately because the deque was full
+    UINT64 uSteals;          // Tasks taken from other workers' deques
+    UINT64 uIdleTicks;       // Performance counter ticks spent looking for work
+
+    double IdleMilliseconds() const {return double(uIdleTicks) / double(g_qpcTicksPerMs);}
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TaskContext: One worker of a TaskScheduler, with its own task deque.  Worker
+// 0 is whichever thread calls TaskScheduler::Run; the others each own a thread
+// created by TaskScheduler::Initialize.  Tasks receive the context of the
+// worker executing them, and use it to fork and join subtasks.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskContext : private ThreadBase
+{
+    friend class TaskScheduler;
+
+    TaskScheduler* m_pScheduler;
+    int m_nIndex;
+    UINT32 m_uRandom;              // Xorshift state used to choose steal victims
+    volatile LONG m_nSleeping;     // Set while the worker thread is (about to be) asleep
+    BOOL m_bStarted;               // Whether we own a thread (worker 0 doesn't)
+    SchedulerStatistics m_stats;
+    TaskDeque m_deque;
+
+    TaskContext(TaskScheduler* pScheduler, int nIndex)
+      : m_pScheduler(pScheduler), m_nIndex(nIndex), m_uRandom(2463534242u + nIndex), m_nSleeping(0), m_bStarted(FALSE)
+    {
+        ClearStatistics();
+    }
+
+    HRESULT Start()
+    {
+        HRESULT hr = ThreadBase::Initialize();
+        if (SUCCEEDED(hr))
+        {
+            hr = StartThread();
+        }
+        m_bStarted = SUCCEEDED(hr);
+        return hr;
+    }
+
+    void Stop()
+    {
+        if (m_bStarted)
+        {
+            StopThread();
+            m_bStarted = FALSE;
+        }
+    }
+
+    void ClearStatistics() {memset(&m_stats, 0, sizeof m_stats);}
+
+    void RunTask(SchedulerTask* pTask)
+    {
+        ASSERT(!pTask->m_nDone);
+        if (pTask->IsCancelled())
+        {
+            ++m_stats.uTasksCancelled;
+        }
+        else
+        {
+            pTask->Execute(*this);
+            ++m_stats.uTasksExecuted;
+        }
+        InterlockedExchange(&pTask->m_nDone, 1);
+    }
+
+    UINT32 NextRandom()
+    {
+        m_uRandom ^= m_uRandom << 13;
+        m_uRandom ^= m_uRandom >> 17;
+        m_uRandom ^= m_uRandom << 5;
+        return m_uRandom;
+    }
+
+    inline SchedulerTask* FindWork();
+    void ThreadProc();
+
+public:
+
+    int Index() const {return m_nIndex;}
+    TaskScheduler& Scheduler() const {return *m_pScheduler;}
+
+    // Queues a task to be run by this worker or stolen by another.  Tasks
+    // forked from inside a task must be joined before that task returns.
+    inline void Fork(SchedulerTask* pTask);
+
+    // Returns once the task has finished, running other tasks meanwhile.
+    void Join(SchedulerTask* pTask)
+    {
+        UINT64 uIdleSince = 0;
+        while (!pTask->IsDone())
+        {
+            SchedulerTask* pWork = FindWork();
+            if (pWork)
+            {
+                if (uIdleSince)
+                {
+                    m_stats.uIdleTicks += GetPerformanceCounter() - uIdleSince;
+                    uIdleSince = 0;
+                }
+                RunTask(pWork);
+            }
+            else
+            {
+                if (!uIdleSince)
+                {
+                    uIdleSince = GetPerformanceCounter();
+                }
+                SwitchToThread();
+            }
+        }
+        if (uIdleSince)
+        {
+            m_stats.uIdleTicks += GetPerformanceCounter() - uIdleSince;
+        }
+    }
+
+    // Convenience for the common two-way split: runs pSecond here while
+    // pFirst is offered to other workers, then waits for both.
+    void ForkJoin(SchedulerTask* pFirst, SchedulerTask* pSecond)
+    {
+        Fork(pFirst);
+        RunTask(pSecond);
+        Join(pFirst);
+    }
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TaskScheduler: A pool of worker threads that share out SchedulerTasks by
+// work stealing.  Each worker runs the tasks it forks itself in LIFO order,
+// which keeps a depth-first traversal cache-friendly; idle workers steal the
+// oldest (typically largest) tasks from other workers.  Idle threads spin
+// briefly and then sleep until new work is forked.
+//
+// Usage: call Initialize once, then Run with a root task from one thread at a
+// time.  The root task runs on the calling thread and forks subtasks as it
+// wishes; Run returns when the root task returns.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+class TaskScheduler
+{
+    friend class TaskContext;
+
+    TaskContext* m_apContexts[SCHEDULER_MAX_WORKERS];
+    int m_nWorkers;
+    volatile LONG m_nSleepers;  // Worker threads that are (about to be) asleep
+    volatile LONG m_nRunning;   // Set during Run
+
+    // Wakes a sleeping worker, if there is one, to look for new work
+    void WakeIdleWorker(int nExcept)
+    {
+        if (m_nSleepers > 0)
+        {
+            for (int n = 1; n < m_nWorkers; ++n)
+            {
+                if (n != nExcept && InterlockedCompareExchange(&m_apContexts[n]->m_nSleeping, 0, 1) == 1)
+                {
+                    m_apContexts[n]->WakeThread();
+                    break;
+                }
+            }
+        }
+    }
+
+    // Returns TRUE if any worker has tasks queued
+    BOOL AnyQueuedWork() const
+    {
+        for (int n = 0; n < m_nWorkers; ++n)
+        {
+            if (m_apContexts[n]->m_deque.Size() > 0)
+            {
+                return TRUE;
+            }
+        }
+        return FALSE;
+    }
+
+    void Shutdown()
+    {
+        // Stop every thread before deleting any context, as they steal from each other
+        for (int n = 0; n < m_nWorkers; ++n)
+        {
+            m_apContexts[n]->Stop();
+        }
+        for (int n = 0; n < m_nWorkers; ++n)
+        {
+            delete m_apContexts[n];
+            m_apContexts[n] = NULL;
+        }
+        m_nWorkers = 0;
+    }
+
+public:
+
+    TaskScheduler() : m_nWorkers(0), m_nSleepers(0), m_nRunning(0)
+    {
+        memset(m_apContexts, 0, sizeof m_apContexts);
+    }
+
+    ~TaskScheduler()
+    {
+        ASSERT(!m_nRunning);
+        Shutdown();
+    }
+
+    // Creates the worker threads.  nThreads counts the thread that will call
+    // Run, so 1 gives a scheduler that runs everything on that thread; 0
+    // means one thread per processor.  May be called again to resize the pool
+    // when the scheduler is not running.
+    HRESULT Initialize(int nThreads =0)
+    {
+        TRACE_VOID_METHOD();
+        ASSERT(!m_nRunning);
+
+        if (nThreads <= 0)
+        {
+            SYSTEM_INFO info;
+            GetSystemInfo(&info);
+            nThreads = int(info.dwNumberOfProcessors);
+        }
+        nThreads = Max(1, Min(nThreads, SCHEDULER_MAX_WORKERS));
+
+        Shutdown();
+
+        HRESULT hr = S_OK;
+        for (int n = 0; n < nThreads && SUCCEEDED(hr); ++n)
+        {
+            m_apContexts[n] = new TaskContext(this, n);
+            hr = HRFROMP(m_apContexts[n]);
+            if (SUCCEEDED(hr))
+            {
+                ++m_nWorkers;
+                if (n > 0)
+                {
+                    hr = m_apContexts[n]->Start();
+                }
+            }
+        }
+
+        if (FAILED(hr))
+        {
+            TRACE(ERROR, "Failed to create scheduler worker %d: hr=0x%lX", m_nWorkers, hr);
+            Shutdown();
+        }
+        return hr;
+    }
+
+    int WorkerCount() const {return m_nWorkers;}
+
+    // Runs pRoot on the calling thread, sharing the tasks it forks with the
+    // worker threads, and returns when it is done.
+    void Run(SchedulerTask* pRoot)
+    {
+        ASSERT(m_nWorkers > 0);
+        VERIFY_ZERO(InterlockedExchange(&m_nRunning, 1));  // One caller at a time
+
+        TaskContext* pContext = m_apContexts[0];
+        pContext->RunTask(pRoot);
+        ASSERT(pContext->m_deque.Size() == 0);  // Every fork must have been joined
+
+        InterlockedExchange(&m_nRunning, 0);
+    }
+
+    const SchedulerStatistics& Statistics(int nWorker) const
+    {
+        ASSERT(nWorker >= 0 && nWorker < m_nWorkers);
+        return m_apContexts[nWorker]->m_stats;
+    }
+
+    // Sums the statistics of all the workers
+    SchedulerStatistics TotalStatistics() const
+    {
+        SchedulerStatistics total;
+        memset(&total, 0, sizeof total);
+        for (int n = 0; n < m_nWorkers; ++n)
+        {
+            const SchedulerStatistics& stats = m_apContexts[n]->m_stats;
+            total.uTasksExecuted += stats.uTasksExecuted;
+            total.uTasksCancelled += stats.uTasksCancelled;
+            total.uTasksInlined += stats.uTasksInlined;
+            total.uSteals += stats.uSteals;
+            total.uIdleTicks += stats.uIdleTicks;
+        }
+        return total;
+    }
+
+    // Only meaningful when the scheduler is not running
+    void ClearStatistics()
+    {
+        for (int n = 0; n < m_nWorkers; ++n)
+        {
+            m_apContexts[n]->ClearStatistics();
+        }
+    }
+
+private:
+
+    // Prevent copying
+    TaskScheduler(const TaskScheduler&);
+    TaskScheduler& operator=(const TaskScheduler&);
+};
+
+
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// TaskContext methods that need the full TaskScheduler definition
+//
+///////////////////////////////////////////////////////////////////////////////
+
+inline void TaskContext::Fork(SchedulerTask* pTask)
+{
+    ASSERT(!pTask->m_nDone);
+    if (m_deque.Push(pTask))
+    {
+        m_pScheduler->WakeIdleWorker(m_nIndex);
+    }
+    else
+    {
+        ++m_stats.uTasksInlined;
+        RunTask(pTask);
+    }
+}
+
+
+// Pops a task from our own deque, or else tries once to steal from each of
+// the other workers, starting with a random one.
+
+inline SchedulerTask* TaskContext::FindWork()
+{
+    SchedulerTask* pTask = m_deque.Pop();
+    if (pTask == NULL)
+    {
+        int nWorkers = m_pScheduler->m_nWorkers;
+        int nVictim = int(NextRandom() % UINT32(nWorkers));
+        for (int n = 0; n < nWorkers && pTask == NULL; ++n, nVictim = (nVictim + 1) % nWorkers)
+        {
+            if (nVictim != m_nIndex)
+            {
+                pTask = m_pScheduler->m_apContexts[nVictim]->m_deque.Steal();
+            }
+        }
+        if (pTask)
+        {
+            ++m_stats.uSteals;
+        }
+    }
+    return pTask;
+}
+
+
+// Worker thread procedure: run tasks while there are any, spin a little when
+// there are none, then sleep until woken by a fork or stopped.
+
+inline void TaskContext::ThreadProc()
+{
+    UINT64 uIdleSince = GetPerformanceCounter();
+
+    do
+    {
+        int nFailures = 0;
+        while (nFailures < SCHEDULER_SPIN_ROUNDS && !IsThreadStopping())
+        {
+            SchedulerTask* pTask = FindWork();
+            if (pTask)
+            {
+                m_stats.uIdleTicks += GetPerformanceCounter() - uIdleSince;
+                RunTask(pTask);
+                uIdleSince = GetPerformanceCounter();
+                nFailures = 0;
+            }
+            else
+            {
+                ++nFailures;
+                SwitchToThread();
+            }
+        }
+
+        // Announce that we are going to sleep, then check once more for work
+        // forked before the announcement was visible
+        InterlockedIncrement(&m_pScheduler->m_nSleepers);
+        InterlockedExchange(&m_nSleeping, 1);
+        if (m_pScheduler->AnyQueuedWork())
+        {
+            InterlockedExchange(&m_nSleeping, 0);
+            InterlockedDecrement(&m_pScheduler->m_nSleepers);
+            continue;  // Straight to the loop condition, without sleeping
+        }
+        BOOL bContinue = ThreadSleep(SCHEDULER_IDLE_SLEEP);
+        InterlockedExchange(&m_nSleeping, 0);
+        InterlockedDecrement(&m_pScheduler->m_nSleepers);
+        if (!bContinue)
+        {
+            break;
+        }
+    }
+    while (!IsThreadStopping());
+
+    m_stats.uIdleTicks += GetPerformanceCounter() - uIdleSince;
+}
+
+
+#endif // SCHEDULER_H